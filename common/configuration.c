@@ -36,14 +36,32 @@ G_DEFINE_TYPE (Configuration, config, G_TYPE_OBJECT);
 
 static Configuration *configuration_instance = NULL;
 
+Configuration *
+config_new (void)
+{
+    return g_object_new (CONFIGURATION_TYPE, NULL);
+}
+
 Configuration *
 config_get_instance (void)
 {
     if (!configuration_instance)
-        configuration_instance = g_object_new (CONFIGURATION_TYPE, NULL);
+        configuration_instance = config_new ();
     return configuration_instance;
 }
 
+void
+config_set_instance (Configuration *config)
+{
+    g_return_if_fail (config != NULL);
+
+    /* Users hold no reference to the instance, so this takes effect the next time they look up a value */
+    g_object_ref (config);
+    if (configuration_instance)
+        g_object_unref (configuration_instance);
+    configuration_instance = config;
+}
+
 gboolean
 config_load_from_file (Configuration *config, const gchar *path, GList **messages, GError **error)
 {
@@ -154,7 +172,7 @@ compare_strings (gconstpointer a, gconstpointer b)
 }
 
 static void
-load_config_directory (const gchar *path, GList **messages)
+load_config_directory (Configuration *config, const gchar *path, GList **messages)
 {
     GDir *dir;
     GList *files = NULL, *link;
@@ -185,7 +203,7 @@ load_config_directory (const gchar *path, GList **messages)
         {
             if (messages)
                 *messages = g_list_append (*messages, g_strdup_printf ("Loading configuration from %s", conf_path));
-            config_load_from_file (config_get_instance (), conf_path, messages, &error);
+            config_load_from_file (config, conf_path, messages, &error);
             if (error && !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
                 g_printerr ("Failed to load configuration from %s: %s\n", filename, error->message);
             g_clear_error (&error);
@@ -198,7 +216,7 @@ load_config_directory (const gchar *path, GList **messages)
 }
 
 static void
-load_config_directories (const gchar * const *dirs, GList **messages)
+load_config_directories (Configuration *config, const gchar * const *dirs, GList **messages)
 {
     gint i;
 
@@ -208,7 +226,7 @@ load_config_directories (const gchar * const *dirs, GList **messages)
         gchar *full_dir = g_build_filename (dirs[i], "lightdm", "lightdm.conf.d", NULL);
         if (messages)
             *messages = g_list_append (*messages, g_strdup_printf ("Loading configuration dirs from %s", full_dir));
-        load_config_directory (full_dir, messages);
+        load_config_directory (config, full_dir, messages);
         g_free (full_dir);
     }
 }
@@ -222,8 +240,8 @@ config_load_from_standard_locations (Configuration *config, const gchar *config_
 
     g_return_val_if_fail (config->priv->dir == NULL, FALSE);
 
-    load_config_directories (g_get_system_data_dirs (), messages);
-    load_config_directories (g_get_system_config_dirs (), messages);
+    load_config_directories (config, g_get_system_data_dirs (), messages);
+    load_config_directories (config, g_get_system_config_dirs (), messages);
 
     if (config_path)
     {
@@ -238,7 +256,7 @@ config_load_from_standard_locations (Configuration *config, const gchar *config_
     }
 
     if (config_d_dir)
-        load_config_directory (config_d_dir, messages);
+        load_config_directory (config, config_d_dir, messages);
 
     if (messages)
         *messages = g_list_append (*messages, g_strdup_printf ("Loading configuration from %s", path));
@@ -306,6 +324,49 @@ config_get_source (Configuration *config, const gchar *section, const gchar *key
     return source;
 }
 
+static void
+add_changes (GPtrArray *changes, GKeyFile *a, GKeyFile *b, gboolean compare_values)
+{
+    gchar **groups;
+    int i;
+
+    groups = g_key_file_get_groups (a, NULL);
+    for (i = 0; groups[i]; i++)
+    {
+        gchar **keys;
+        int j;
+
+        keys = g_key_file_get_keys (a, groups[i], NULL, NULL);
+        for (j = 0; keys && keys[j]; j++)
+        {
+            gchar *value_a, *value_b;
+
+            value_a = g_key_file_get_value (a, groups[i], keys[j], NULL);
+            value_b = g_key_file_get_value (b, groups[i], keys[j], NULL);
+            if (value_b == NULL || (compare_values && strcmp (value_a, value_b) != 0))
+                g_ptr_array_add (changes, g_strdup_printf ("[%s] %s", groups[i], keys[j]));
+            g_free (value_a);
+            g_free (value_b);
+        }
+        g_strfreev (keys);
+    }
+    g_strfreev (groups);
+}
+
+gchar **
+config_get_changes (Configuration *config, Configuration *other)
+{
+    GPtrArray *changes;
+
+    changes = g_ptr_array_new ();
+    /* Keys changed or removed, then keys added */
+    add_changes (changes, config->priv->key_file, other->priv->key_file, TRUE);
+    add_changes (changes, other->priv->key_file, config->priv->key_file, FALSE);
+    g_ptr_array_add (changes, NULL);
+
+    return (gchar **) g_ptr_array_free (changes, FALSE);
+}
+
 void
 config_set_string (Configuration *config, const gchar *section, const gchar *key, const gchar *value)
 {
@@ -397,6 +458,10 @@ config_init (Configuration *config)
     g_hash_table_insert (config->priv->lightdm_keys, "greeters-directory", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->lightdm_keys, "backup-logs", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->lightdm_keys, "dbus-service", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->lightdm_keys, "session-child-pool-size", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->lightdm_keys, "trace-buffer-size", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->lightdm_keys, "async-logging", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->lightdm_keys, "async-logging-buffer-size", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->lightdm_keys, "logind-load-seats", GINT_TO_POINTER (KEY_DEPRECATED));
 
     g_hash_table_insert (config->priv->seat_keys, "type", GINT_TO_POINTER (KEY_SUPPORTED));
@@ -425,6 +490,7 @@ config_init (Configuration *config)
     g_hash_table_insert (config->priv->seat_keys, "user-session", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "allow-user-switching", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "allow-guest", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "spare-greeter", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "guest-session", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "session-wrapper", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "greeter-wrapper", GINT_TO_POINTER (KEY_SUPPORTED));
@@ -434,10 +500,17 @@ config_init (Configuration *config)
     g_hash_table_insert (config->priv->seat_keys, "greeter-setup-script", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "session-setup-script", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "session-cleanup-script", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "display-setup-script-timeout", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "display-stopped-script-timeout", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "greeter-setup-script-timeout", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "session-setup-script-timeout", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "session-cleanup-script-timeout", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "script-kill-policy", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "autologin-guest", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "autologin-user", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "autologin-user-timeout", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "autologin-in-background", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->seat_keys, "autologin-pipelined", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "autologin-session", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "exit-on-failure", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->seat_keys, "xdg-seat", GINT_TO_POINTER (KEY_DEPRECATED));
@@ -447,6 +520,12 @@ config_init (Configuration *config)
     g_hash_table_insert (config->priv->xdmcp_keys, "listen-address", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->xdmcp_keys, "key", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->xdmcp_keys, "hostname", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->xdmcp_keys, "log-packets", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->xdmcp_keys, "capacity", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->xdmcp_keys, "report-load", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->xdmcp_keys, "max-pending-sessions", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->xdmcp_keys, "request-rate-limit", GINT_TO_POINTER (KEY_SUPPORTED));
+    g_hash_table_insert (config->priv->xdmcp_keys, "keep-alive-timeout", GINT_TO_POINTER (KEY_SUPPORTED));
 
     g_hash_table_insert (config->priv->vnc_keys, "enabled", GINT_TO_POINTER (KEY_SUPPORTED));
     g_hash_table_insert (config->priv->vnc_keys, "command", GINT_TO_POINTER (KEY_SUPPORTED));
@@ -34,8 +34,12 @@ typedef struct
 
 GType config_get_type (void);
 
+Configuration *config_new (void);
+
 Configuration *config_get_instance (void);
 
+void config_set_instance (Configuration *config);
+
 gboolean config_load_from_file (Configuration *config, const gchar *path, GList **messages, GError **error);
 
 gboolean config_load_from_standard_locations (Configuration *config, const gchar *config_path, GList **messages);
@@ -68,6 +72,8 @@ void config_set_boolean (Configuration *config, const gchar *section, const gcha
 
 gboolean config_get_boolean (Configuration *config, const gchar *section, const gchar *key);
 
+gchar **config_get_changes (Configuration *config, Configuration *other);
+
 G_END_DECLS
 
 #endif /* CONFIGURATION_H_ */
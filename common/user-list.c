@@ -18,6 +18,7 @@
 #include <sys/utsname.h>
 #include <pwd.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
 #include "dmrc.h"
 #include "user-list.h"
@@ -60,6 +61,7 @@ enum
 {
     CHANGED,
     GET_LOGGED_IN,
+    LOAD_IMAGE,
     LAST_USER_SIGNAL
 };
 static guint user_signals[LAST_USER_SIGNAL] = { 0 };
@@ -72,6 +74,7 @@ typedef struct
     /* D-Bus signals for accounts service events */
     guint user_added_signal;
     guint user_removed_signal;
+    guint user_changed_signal;
 
     /* D-Bus signals for display manager events */
     guint session_added_signal;
@@ -80,16 +83,104 @@ typedef struct
     /* File monitor for password file */
     GFileMonitor *passwd_monitor;
 
+    /* Last loaded entries from the password file */
+    GHashTable *passwd_entries;
+
+    /* Users waiting for their image to be looked up */
+    GQueue *image_queue;
+
+    /* Number of image lookups in progress */
+    guint n_image_lookups;
+
+    /* Home directory modification times when no image was found */
+    GHashTable *missing_images;
+
     /* TRUE if have scanned users */
     gboolean have_users;
 
-    /* List of users */
-    GList *users;
+    /* Load of the users from the accounts service in progress */
+    struct AccountsLoad *load;
+
+    /* Tasks waiting for the users to load */
+    GList *load_tasks;
+
+    /* TRUE if the initial user list has been loaded */
+    gboolean loaded;
+
+    /* Users, sorted by display name */
+    GPtrArray *users;
+
+    /* List view of the users, built on demand */
+    GList *users_list;
+
+    /* Previous list views, kept until callers are back in the main loop */
+    GSList *old_users_lists;
+    guint free_old_users_lists_source;
+
+    /* Users indexed by name, Accounts service path and UID */
+    GHashTable *users_by_name;
+    GHashTable *users_by_path;
+    GHashTable *users_by_uid;
 
     /* List of sessions */
     GList *sessions;
 } CommonUserListPrivate;
 
+typedef struct
+{
+    gchar *name;
+    uid_t uid;
+    gid_t gid;
+    gchar *gecos;
+    gchar *dir;
+    gchar *shell;
+
+    /* Hash of the above fields to quickly detect changes */
+    guint hash;
+} PasswdEntry;
+
+typedef struct
+{
+    /* Home directory to look in */
+    gchar *home_directory;
+
+    /* Modification time of the home directory when last found to have no image or -1 */
+    gint64 missing_mtime;
+
+    /* Modification time of the home directory when checked or -1 */
+    gint64 mtime;
+
+    /* Image found */
+    gchar *image;
+} ImageLookup;
+
+typedef struct AccountsLoad
+{
+    CommonUserList *user_list;
+
+    /* TRUE if loading without blocking */
+    gboolean async;
+
+    /* Accounts service paths of users still to request */
+    GQueue *paths;
+
+    /* Number of requests in progress */
+    guint n_requests;
+
+    /* Users loaded, added to the list once they all have */
+    GList *users;
+
+    /* Paths of users deleted while loading */
+    GHashTable *deleted_paths;
+} AccountsLoad;
+
+typedef struct
+{
+    AccountsLoad *load;
+    CommonUserList *user_list;
+    CommonUser *user;
+} AccountsRequest;
+
 typedef struct
 {
     /* TRUE if have loaded the DMRC file */
@@ -101,9 +192,6 @@ typedef struct
     /* Accounts service path */
     gchar *path;
 
-    /* Update signal from accounts service */
-    guint changed_signal;
-
     /* Username */
     gchar *name;
 
@@ -119,6 +207,12 @@ typedef struct
     /* Image for user */
     gchar *image;
 
+    /* TRUE if have started looking for an image in the home directory */
+    gboolean loaded_image;
+
+    /* Collation key for the display name, used for sorting */
+    gchar *collate_key;
+
     /* Background image for users */
     gchar *background;
 
@@ -165,6 +259,12 @@ G_DEFINE_TYPE (CommonSession, common_session, G_TYPE_OBJECT);
 #define PASSWD_FILE      "/etc/passwd"
 #define USER_CONFIG_FILE "/etc/lightdm/users.conf"
 
+/* Maximum number of home directories to check for images at once */
+#define MAX_IMAGE_LOOKUPS 4
+
+/* Maximum number of accounts service requests to have in progress when loading users */
+#define MAX_ACCOUNTS_REQUESTS 32
+
 static CommonUserList *singleton = NULL;
 
 /**
@@ -188,18 +288,64 @@ common_user_list_cleanup (void)
     g_clear_object (&singleton);
 }
 
+static void
+index_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+    if (user_priv->name)
+        g_hash_table_insert (priv->users_by_name, g_strdup (user_priv->name), user);
+    if (user_priv->path)
+        g_hash_table_insert (priv->users_by_path, g_strdup (user_priv->path), user);
+    g_hash_table_insert (priv->users_by_uid, GUINT_TO_POINTER ((guint) user_priv->uid), user);
+}
+
+static gboolean
+is_user_cb (gpointer key, gpointer value, gpointer user)
+{
+    return value == user;
+}
+
+static void
+remove_from_index (GHashTable *index, gconstpointer key, CommonUser *user)
+{
+    /* Fall back to a full scan if the key has changed since the user was indexed */
+    if (g_hash_table_lookup (index, key) == user)
+        g_hash_table_remove (index, key);
+    else
+        g_hash_table_foreach_remove (index, is_user_cb, user);
+}
+
+static void
+unindex_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+    if (user_priv->name)
+        remove_from_index (priv->users_by_name, user_priv->name, user);
+    if (user_priv->path)
+        remove_from_index (priv->users_by_path, user_priv->path, user);
+    if (g_hash_table_lookup (priv->users_by_uid, GUINT_TO_POINTER ((guint) user_priv->uid)) == user)
+        g_hash_table_remove (priv->users_by_uid, GUINT_TO_POINTER ((guint) user_priv->uid));
+    else
+        g_hash_table_foreach_remove (priv->users_by_uid, is_user_cb, user);
+}
+
 static CommonUser *
 get_user_by_name (CommonUserList *user_list, const gchar *username)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
-    GList *link;
-  
-    for (link = priv->users; link; link = link->next)
-    {
-        CommonUser *user = link->data;
-        if (g_strcmp0 (common_user_get_name (user), username) == 0)
-            return user;
-    }
+    CommonUser *user;
+
+    if (!username)
+        return NULL;
+
+    /* Check the name still matches in case the user was renamed */
+    user = g_hash_table_lookup (priv->users_by_name, username);
+    if (user && g_strcmp0 (common_user_get_name (user), username) == 0)
+        return user;
 
     return NULL;
 }
@@ -208,45 +354,148 @@ static CommonUser *
 get_user_by_path (CommonUserList *user_list, const gchar *path)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
-    GList *link;
+
+    if (!path)
+        return NULL;
+
+    return g_hash_table_lookup (priv->users_by_path, path);
+}
+
+static CommonUser *
+get_user_by_uid (CommonUserList *user_list, uid_t uid)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUser *user;
+
+    /* Check the UID still matches in case the user was changed */
+    user = g_hash_table_lookup (priv->users_by_uid, GUINT_TO_POINTER ((guint) uid));
+    if (user && GET_USER_PRIVATE (user)->uid == uid)
+        return user;
+
+    return NULL;
+}
   
-    for (link = priv->users; link; link = link->next)
+static const gchar *
+get_collate_key (CommonUser *user)
+{
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+
+    if (!priv->collate_key)
     {
-        CommonUser *user = link->data;
-        if (g_strcmp0 (GET_USER_PRIVATE (user)->path, path) == 0)
-            return user;
+        const gchar *display_name = common_user_get_display_name (user);
+        priv->collate_key = g_utf8_collate_key (display_name ? display_name : "", -1);
     }
 
-    return NULL;
+    return priv->collate_key;
 }
-  
+
 static gint
 compare_user (gconstpointer a, gconstpointer b)
 {
     CommonUser *user_a = (CommonUser *) a, *user_b = (CommonUser *) b;
-    return g_strcmp0 (common_user_get_display_name (user_a), common_user_get_display_name (user_b));
+    return strcmp (get_collate_key (user_a), get_collate_key (user_b));
+}
+
+static gint
+compare_user_array (gconstpointer a, gconstpointer b)
+{
+    return compare_user (*((CommonUser **) a), *((CommonUser **) b));
 }
 
 static gboolean
-update_passwd_user (CommonUser *user, const gchar *real_name, const gchar *home_directory, const gchar *shell, const gchar *image)
+free_old_users_lists_cb (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    g_slist_free_full (priv->old_users_lists, (GDestroyNotify) g_list_free);
+    priv->old_users_lists = NULL;
+    priv->free_old_users_lists_source = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+users_changed (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    if (!priv->users_list)
+        return;
+
+    /* Callers don't own the list, so it has to stay valid until they return to the main loop */
+    priv->old_users_lists = g_slist_prepend (priv->old_users_lists, priv->users_list);
+    priv->users_list = NULL;
+    if (!priv->free_old_users_lists_source)
+        priv->free_old_users_lists_source = g_idle_add ((GSourceFunc) free_old_users_lists_cb, user_list);
+}
+
+static void
+insert_user_sorted (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    guint low = 0, high = priv->users->len;
+
+    while (low < high)
+    {
+        guint mid = (low + high) / 2;
+        if (compare_user (g_ptr_array_index (priv->users, mid), user) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    g_ptr_array_insert (priv->users, low, user);
+    users_changed (user_list);
+}
+
+/* Move a user whose display name has changed back into order */
+static void
+resort_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    guint i;
+
+    for (i = 0; i < priv->users->len && g_ptr_array_index (priv->users, i) != user; i++);
+    if (i == priv->users->len)
+        return;
+
+    if ((i > 0 && compare_user (g_ptr_array_index (priv->users, i - 1), user) > 0) ||
+        (i + 1 < priv->users->len && compare_user (user, g_ptr_array_index (priv->users, i + 1)) > 0))
+    {
+        g_ptr_array_remove_index (priv->users, i);
+        insert_user_sorted (user_list, user);
+    }
+}
+
+static gboolean
+update_passwd_user (CommonUser *user, const gchar *real_name, const gchar *home_directory, const gchar *shell)
 {
     CommonUserPrivate *priv = GET_USER_PRIVATE (user);
 
+    /* Check for a new image next time it is requested */
+    if (!priv->image)
+        priv->loaded_image = FALSE;
+
     /* Skip if already set to this */
     if (g_strcmp0 (common_user_get_real_name (user), real_name) == 0 &&
         g_strcmp0 (common_user_get_home_directory (user), home_directory) == 0 &&
-        g_strcmp0 (common_user_get_shell (user), shell) == 0 &&
-        g_strcmp0 (common_user_get_image (user), image) == 0)
+        g_strcmp0 (common_user_get_shell (user), shell) == 0)
         return FALSE;
 
+    /* Image is in the home directory, so look it up again if that moves */
+    if (g_strcmp0 (common_user_get_home_directory (user), home_directory) != 0)
+    {
+        g_free (priv->image);
+        priv->image = NULL;
+        priv->loaded_image = FALSE;
+    }
+
     g_free (priv->real_name);
     priv->real_name = g_strdup (real_name);
+    g_clear_pointer (&priv->collate_key, g_free);
     g_free (priv->home_directory);
     priv->home_directory = g_strdup (home_directory);
     g_free (priv->shell);
     priv->shell = g_strdup (shell);
-    g_free (priv->image);
-    priv->image = g_strdup (image);
 
     return TRUE;
 }
@@ -278,18 +527,155 @@ get_logged_in_cb (CommonUser *user, CommonUserList *user_list)
 static void
 user_changed_cb (CommonUser *user, CommonUserList *user_list)
 {
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+    /* Accounts service users can be renamed or change UID */
+    if ((user_priv->name && g_hash_table_lookup (priv->users_by_name, user_priv->name) != user) ||
+        !g_hash_table_contains (priv->users_by_uid, GUINT_TO_POINTER ((guint) user_priv->uid)))
+    {
+        unindex_user (user_list, user);
+        index_user (user_list, user);
+    }
+
+    /* A new name changes where the user sorts */
+    if (!user_priv->collate_key)
+        resort_user (user_list, user);
+
     g_signal_emit (user_list, list_signals[USER_CHANGED], 0, user);
 }
 
+static void
+image_lookup_free (ImageLookup *lookup)
+{
+    g_free (lookup->home_directory);
+    g_free (lookup->image);
+    g_free (lookup);
+}
+
+/* Runs in a worker thread so slow (e.g. NFS) home directories don't block the main loop */
+static void
+lookup_image_thread (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    ImageLookup *lookup = task_data;
+    GStatBuf info;
+    gchar *image;
+
+    if (g_stat (lookup->home_directory, &info) == 0)
+        lookup->mtime = info.st_mtime;
+
+    /* Nothing has been added to the home directory since we last checked */
+    if (lookup->mtime >= 0 && lookup->mtime == lookup->missing_mtime)
+    {
+        g_task_return_boolean (task, TRUE);
+        return;
+    }
+
+    image = g_build_filename (lookup->home_directory, ".face", NULL);
+    if (!g_file_test (image, G_FILE_TEST_EXISTS))
+    {
+        g_free (image);
+        image = g_build_filename (lookup->home_directory, ".face.icon", NULL);
+        if (!g_file_test (image, G_FILE_TEST_EXISTS))
+        {
+            g_free (image);
+            image = NULL;
+        }
+    }
+    lookup->image = image;
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static void start_image_lookups (CommonUserList *user_list);
+
+static void
+lookup_image_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    CommonUser *user = (CommonUser *) object;
+    CommonUserList *user_list = data;
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+    ImageLookup *lookup = g_task_get_task_data (G_TASK (result));
+
+    priv->n_image_lookups--;
+
+    /* Ignore if the home directory changed while we were looking */
+    if (g_strcmp0 (lookup->home_directory, user_priv->home_directory) == 0)
+    {
+        if (!lookup->image && lookup->mtime >= 0)
+        {
+            gint64 *mtime = g_new (gint64, 1);
+            *mtime = lookup->mtime;
+            g_hash_table_insert (priv->missing_images, g_strdup (lookup->home_directory), mtime);
+        }
+        else
+            g_hash_table_remove (priv->missing_images, lookup->home_directory);
+
+        if (g_strcmp0 (user_priv->image, lookup->image) != 0)
+        {
+            g_free (user_priv->image);
+            user_priv->image = g_strdup (lookup->image);
+            g_debug ("User %s image changed", user_priv->name);
+            g_object_notify (G_OBJECT (user), "image");
+            g_signal_emit (user, user_signals[CHANGED], 0);
+        }
+    }
+
+    start_image_lookups (user_list);
+    g_object_unref (user_list);
+}
+
+static void
+start_image_lookups (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    while (priv->n_image_lookups < MAX_IMAGE_LOOKUPS && !g_queue_is_empty (priv->image_queue))
+    {
+        CommonUser *user = g_queue_pop_head (priv->image_queue);
+        CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+        ImageLookup *lookup;
+        gint64 *missing_mtime;
+        GTask *task;
+
+        lookup = g_new0 (ImageLookup, 1);
+        lookup->home_directory = g_strdup (user_priv->home_directory);
+        missing_mtime = g_hash_table_lookup (priv->missing_images, lookup->home_directory);
+        lookup->missing_mtime = missing_mtime ? *missing_mtime : -1;
+        lookup->mtime = -1;
+
+        priv->n_image_lookups++;
+        task = g_task_new (user, NULL, lookup_image_cb, g_object_ref (user_list));
+        g_task_set_task_data (task, lookup, (GDestroyNotify) image_lookup_free);
+        g_task_run_in_thread (task, lookup_image_thread);
+        g_object_unref (task);
+        g_object_unref (user);
+    }
+}
+
+static void
+load_image_cb (CommonUser *user, CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    if (!GET_USER_PRIVATE (user)->home_directory)
+        return;
+
+    g_queue_push_tail (priv->image_queue, g_object_ref (user));
+    start_image_lookups (user_list);
+}
+
 static CommonUser *
 make_passwd_user (CommonUserList *user_list, struct passwd *entry)
 {
     CommonUser *user = g_object_new (COMMON_TYPE_USER, NULL);
     CommonUserPrivate *priv = GET_USER_PRIVATE (user);
     char **tokens;
-    gchar *real_name, *image;
+    gchar *real_name;
 
     g_signal_connect (user, "get-logged-in", G_CALLBACK (get_logged_in_cb), user_list);  
+    g_signal_connect (user, "load-image", G_CALLBACK (load_image_cb), user_list);
 
     tokens = g_strsplit (entry->pw_gecos, ",", -1);
     if (tokens[0] != NULL && tokens[0][0] != '\0')
@@ -298,38 +684,95 @@ make_passwd_user (CommonUserList *user_list, struct passwd *entry)
         real_name = g_strdup ("");
     g_strfreev (tokens);
 
-    image = g_build_filename (entry->pw_dir, ".face", NULL);
-    if (!g_file_test (image, G_FILE_TEST_EXISTS))
-    {
-        g_free (image);
-        image = g_build_filename (entry->pw_dir, ".face.icon", NULL);
-        if (!g_file_test (image, G_FILE_TEST_EXISTS))
-        {
-            g_free (image);
-            image = NULL;
-        }
-    }
-
+    /* The image is looked up from the home directory when first requested */
     priv->name = g_strdup (entry->pw_name);
     priv->real_name = real_name;
     priv->home_directory = g_strdup (entry->pw_dir);
     priv->shell = g_strdup (entry->pw_shell);
-    priv->image = image;
     priv->uid = entry->pw_uid;
     priv->gid = entry->pw_gid;
 
     return user;
 }
 
+static PasswdEntry *
+passwd_entry_new (struct passwd *pw)
+{
+    PasswdEntry *entry = g_slice_new0 (PasswdEntry);
+
+    entry->name = g_strdup (pw->pw_name);
+    entry->uid = pw->pw_uid;
+    entry->gid = pw->pw_gid;
+    entry->gecos = g_strdup (pw->pw_gecos);
+    entry->dir = g_strdup (pw->pw_dir);
+    entry->shell = g_strdup (pw->pw_shell);
+
+    entry->hash = g_str_hash (entry->name);
+    entry->hash = entry->hash * 31 + entry->uid;
+    entry->hash = entry->hash * 31 + entry->gid;
+    entry->hash = entry->hash * 31 + (entry->gecos ? g_str_hash (entry->gecos) : 0);
+    entry->hash = entry->hash * 31 + (entry->dir ? g_str_hash (entry->dir) : 0);
+    entry->hash = entry->hash * 31 + (entry->shell ? g_str_hash (entry->shell) : 0);
+
+    return entry;
+}
+
+static gboolean
+passwd_entry_equal (PasswdEntry *a, PasswdEntry *b)
+{
+    return a->hash == b->hash &&
+           a->uid == b->uid &&
+           a->gid == b->gid &&
+           g_strcmp0 (a->name, b->name) == 0 &&
+           g_strcmp0 (a->gecos, b->gecos) == 0 &&
+           g_strcmp0 (a->dir, b->dir) == 0 &&
+           g_strcmp0 (a->shell, b->shell) == 0;
+}
+
 static void
-load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
+passwd_entry_free (PasswdEntry *entry)
+{
+    g_free (entry->name);
+    g_free (entry->gecos);
+    g_free (entry->dir);
+    g_free (entry->shell);
+    g_slice_free (PasswdEntry, entry);
+}
+
+/* Remove users whose entries are not in the given password file snapshot */
+static GList *
+remove_missing_users (CommonUserList *user_list, GHashTable *entries)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    GList *removed_users = NULL;
+    guint i, n_users = 0;
+
+    for (i = 0; i < priv->users->len; i++)
+    {
+        CommonUser *user = g_ptr_array_index (priv->users, i);
+        if (g_hash_table_contains (entries, common_user_get_name (user)))
+            g_ptr_array_index (priv->users, n_users++) = user;
+        else
+        {
+            unindex_user (user_list, user);
+            removed_users = g_list_prepend (removed_users, user);
+        }
+    }
+    g_ptr_array_set_size (priv->users, n_users);
+
+    return g_list_reverse (removed_users);
+}
+
+static void
+load_passwd_file (CommonUserList *user_list)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
     GKeyFile *config;
     gchar *value;
     gint minimum_uid;
     gchar **hidden_users, **hidden_shells;
-    GList *users = NULL, *old_users, *new_users = NULL, *changed_users = NULL, *link;
+    GHashTable *entries;
+    GList *new_users = NULL, *changed_users = NULL, *removed_users = NULL, *link;
     GError *error = NULL;
 
     g_debug ("Loading user config from %s", USER_CONFIG_FILE);
@@ -359,58 +802,65 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
 
     g_key_file_free (config);
 
+    /* Snapshot of the entries in the password database, compared against the
+     * previous snapshot so only changed records are turned into users */
+    entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) passwd_entry_free);
+
     setpwent ();
 
     while (TRUE)
     {
-        struct passwd *entry;
-        CommonUser *user;
+        struct passwd *pw;
+        PasswdEntry *entry, *old_entry;
+        CommonUser *user, *info;
         int i;
 
         errno = 0;
-        entry = getpwent ();
-        if (!entry)
+        pw = getpwent ();
+        if (!pw)
             break;
 
         /* Ignore system users */
-        if (entry->pw_uid < minimum_uid)
+        if (pw->pw_uid < minimum_uid)
             continue;
 
         /* Ignore users disabled by shell */
-        if (entry->pw_shell)
+        if (pw->pw_shell)
         {
-            for (i = 0; hidden_shells[i] && strcmp (entry->pw_shell, hidden_shells[i]) != 0; i++);
+            for (i = 0; hidden_shells[i] && strcmp (pw->pw_shell, hidden_shells[i]) != 0; i++);
             if (hidden_shells[i])
                 continue;
         }
 
         /* Ignore certain users */
-        for (i = 0; hidden_users[i] && strcmp (entry->pw_name, hidden_users[i]) != 0; i++);
+        for (i = 0; hidden_users[i] && strcmp (pw->pw_name, hidden_users[i]) != 0; i++);
         if (hidden_users[i])
             continue;
 
-        user = make_passwd_user (user_list, entry);
+        /* Only use the first entry if a user is listed more than once */
+        if (g_hash_table_contains (entries, pw->pw_name))
+            continue;
+
+        entry = passwd_entry_new (pw);
+        g_hash_table_insert (entries, entry->name, entry);
+
+        /* Skip users that haven't changed since the last load */
+        info = get_user_by_name (user_list, entry->name);
+        old_entry = priv->passwd_entries ? g_hash_table_lookup (priv->passwd_entries, entry->name) : NULL;
+        if (info && old_entry && passwd_entry_equal (old_entry, entry))
+            continue;
+
+        user = make_passwd_user (user_list, pw);
 
         /* Update existing users if have them */
-        for (link = priv->users; link; link = link->next)
-        {
-            CommonUser *info = link->data;
-            if (strcmp (common_user_get_name (info), common_user_get_name (user)) == 0)
-            {
-                if (update_passwd_user (info, common_user_get_real_name (user), common_user_get_home_directory (user), common_user_get_shell (user), common_user_get_image (user)))
-                    changed_users = g_list_insert_sorted (changed_users, info, compare_user);
-                g_object_unref (user);
-                user = info;
-                break;
-            }
-        }
-        if (!link)
+        if (info)
         {
-            /* Only notify once we have loaded the user list */
-            if (priv->have_users)
-                new_users = g_list_insert_sorted (new_users, user, compare_user);
+            if (update_passwd_user (info, common_user_get_real_name (user), common_user_get_home_directory (user), common_user_get_shell (user)))
+                changed_users = g_list_prepend (changed_users, info);
+            g_object_unref (user);
         }
-        users = g_list_insert_sorted (users, user, compare_user);
+        else
+            new_users = g_list_prepend (new_users, user);
     }
     g_strfreev (hidden_users);
     g_strfreev (hidden_shells);
@@ -420,18 +870,33 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
 
     endpwent ();
 
-    /* Use new user list */
-    old_users = priv->users;
-    priv->users = users;
-  
+    /* Update the user list, resorting once if anything changed */
+    removed_users = remove_missing_users (user_list, entries);
+    for (link = new_users; link; link = link->next)
+    {
+        g_ptr_array_add (priv->users, link->data);
+        index_user (user_list, link->data);
+    }
+    if (new_users || changed_users || removed_users)
+    {
+        g_ptr_array_sort (priv->users, compare_user_array);
+        users_changed (user_list);
+    }
+
+    /* Use new snapshot */
+    if (priv->passwd_entries)
+        g_hash_table_unref (priv->passwd_entries);
+    priv->passwd_entries = entries;
+    new_users = g_list_sort (g_list_reverse (new_users), compare_user);
+    changed_users = g_list_sort (g_list_reverse (changed_users), compare_user);
+
     /* Notify of changes */
     for (link = new_users; link; link = link->next)
     {
         CommonUser *info = link->data;
         g_debug ("User %s added", common_user_get_name (info));
         g_signal_connect (info, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
-        if (emit_add_signal)
-            g_signal_emit (user_list, list_signals[USER_ADDED], 0, info);
+        g_signal_emit (user_list, list_signals[USER_ADDED], 0, info);
     }
     g_list_free (new_users);
     for (link = changed_users; link; link = link->next)
@@ -441,201 +906,448 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
         g_signal_emit (info, user_signals[CHANGED], 0);
     }
     g_list_free (changed_users);
-    for (link = old_users; link; link = link->next)
+    for (link = removed_users; link; link = link->next)
+    {
+        CommonUser *info = link->data;
+        g_debug ("User %s removed", common_user_get_name (info));
+        g_signal_emit (user_list, list_signals[USER_REMOVED], 0, info);
+        g_object_unref (info);
+    }
+    g_list_free (removed_users);
+}
+
+static void
+passwd_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, CommonUserList *user_list)
+{
+    if (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+    {
+        g_debug ("%s changed, reloading user list", g_file_get_path (file));
+        load_passwd_file (user_list);
+    }
+}
+
+/* Update a user from the result of a GetAll call on the accounts service */
+static gboolean
+update_accounts_user (CommonUser *user, GVariant *result)
+{
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+    GVariant *value;
+    GVariantIter *iter;
+    gchar *name;
+    gboolean system_account = FALSE;
+
+    /* Store the properties we need */
+    g_variant_get (result, "(a{sv})", &iter);
+    while (g_variant_iter_loop (iter, "{&sv}", &name, &value))
+    {
+        if (strcmp (name, "UserName") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->name);
+            priv->name = g_variant_dup_string (value, NULL);
+            g_clear_pointer (&priv->collate_key, g_free);
+        }
+        else if (strcmp (name, "RealName") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->real_name);
+            priv->real_name = g_variant_dup_string (value, NULL);
+            g_clear_pointer (&priv->collate_key, g_free);
+        }
+        else if (strcmp (name, "HomeDirectory") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->home_directory);
+            priv->home_directory = g_variant_dup_string (value, NULL);
+        }
+        else if (strcmp (name, "Shell") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->shell);
+            priv->shell = g_variant_dup_string (value, NULL);
+        }
+        else if (strcmp (name, "SystemAccount") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            system_account = g_variant_get_boolean (value);
+        else if (strcmp (name, "Language") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            if (priv->language)
+                g_free (priv->language);
+            priv->language = g_variant_dup_string (value, NULL);
+        }
+        else if (strcmp (name, "IconFile") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->image);
+            priv->image = g_variant_dup_string (value, NULL);
+            if (strcmp (priv->image, "") == 0)
+            {
+                g_free (priv->image);
+                priv->image = NULL;
+            }
+        }
+        else if (strcmp (name, "XSession") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->session);
+            priv->session = g_variant_dup_string (value, NULL);
+        }
+        else if (strcmp (name, "BackgroundFile") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->background);
+            priv->background = g_variant_dup_string (value, NULL);
+            if (strcmp (priv->background, "") == 0)
+            {
+                g_free (priv->background);
+                priv->background = NULL;
+            }
+        }
+        else if (strcmp (name, "XKeyboardLayouts") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING_ARRAY))
+        {
+            g_strfreev (priv->layouts);
+            priv->layouts = g_variant_dup_strv (value, NULL);
+            if (!priv->layouts)
+            {
+                priv->layouts = g_malloc (sizeof (gchar *) * 1);
+                priv->layouts[0] = NULL;
+            }
+        }
+        else if (strcmp (name, "XHasMessages") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            priv->has_messages = g_variant_get_boolean (value);
+        else if (strcmp (name, "Uid") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_UINT64))
+            priv->uid = g_variant_get_uint64 (value);
+    }
+    g_variant_iter_free (iter);
+
+    return !system_account;
+}
+
+static void
+accounts_user_changed_loaded_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    CommonUser *user = data;
+    GVariant *result;
+    GError *error = NULL;
+
+    result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+    if (error)
+        g_warning ("Error updating user %s: %s", GET_USER_PRIVATE (user)->path, error->message);
+    g_clear_error (&error);
+    if (result)
+    {
+        if (update_accounts_user (user, result))
+            g_signal_emit (user, user_signals[CHANGED], 0);
+        g_variant_unref (result);
+    }
+
+    g_object_unref (user);
+}
+
+static void
+accounts_user_changed_cb (GDBusConnection *connection,
+                          const gchar *sender_name,
+                          const gchar *object_path,
+                          const gchar *interface_name,
+                          const gchar *signal_name,
+                          GVariant *parameters,
+                          gpointer data)
+{
+    CommonUserList *user_list = data;
+    CommonUser *user;
+
+    user = get_user_by_path (user_list, object_path);
+    if (!user)
+        return;
+
+    /* Log message disabled as AccountsService can have arbitrary plugins that
+     * might cause us to log when properties change we don't use. LP: #1376357
+     */
+    /*g_debug ("User %s changed", object_path);*/
+    g_dbus_connection_call (connection,
+                            "org.freedesktop.Accounts",
+                            object_path,
+                            "org.freedesktop.DBus.Properties",
+                            "GetAll",
+                            g_variant_new ("(s)", "org.freedesktop.Accounts.User"),
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            NULL,
+                            accounts_user_changed_loaded_cb,
+                            g_object_ref (user));
+}
+
+static CommonUser *
+make_accounts_user (CommonUserList *user_list, const gchar *path)
+{
+    CommonUserListPrivate *list_priv = GET_LIST_PRIVATE (user_list);
+    CommonUser *user;
+    CommonUserPrivate *priv;
+
+    user = g_object_new (COMMON_TYPE_USER, NULL);
+    priv = GET_USER_PRIVATE (user);
+
+    g_debug ("User %s added", path);
+    priv->bus = g_object_ref (list_priv->bus);
+    priv->path = g_strdup (path);
+    g_signal_connect (user, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
+    g_signal_connect (user, "get-logged-in", G_CALLBACK (get_logged_in_cb), user_list);  
+
+    return user;
+}
+
+static void
+accounts_user_added_loaded_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    AccountsRequest *request = data;
+    CommonUserList *user_list = request->user_list;
+    CommonUser *user = request->user;
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+    GVariant *result;
+    GError *error = NULL;
+
+    g_free (request);
+
+    result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+    if (error)
+        g_warning ("Error updating user %s: %s", priv->path, error->message);
+    g_clear_error (&error);
+
+    /* Skip if they were added by another signal while we were waiting */
+    if (result && update_accounts_user (user, result) && !get_user_by_path (user_list, priv->path))
+    {
+        insert_user_sorted (user_list, user);
+        index_user (user_list, user);
+        g_signal_emit (user_list, list_signals[USER_ADDED], 0, user);
+    }
+    else
+        g_object_unref (user);
+    if (result)
+        g_variant_unref (result);
+}
+
+static void
+add_accounts_user (CommonUserList *user_list, const gchar *path)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    AccountsRequest *request;
+
+    request = g_new0 (AccountsRequest, 1);
+    request->user_list = user_list;
+    request->user = make_accounts_user (user_list, path);
+    g_dbus_connection_call (priv->bus,
+                            "org.freedesktop.Accounts",
+                            path,
+                            "org.freedesktop.DBus.Properties",
+                            "GetAll",
+                            g_variant_new ("(s)", "org.freedesktop.Accounts.User"),
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            NULL,
+                            accounts_user_added_loaded_cb,
+                            request);
+}
+
+static void send_accounts_requests (AccountsLoad *load);
+static void finish_async_load (AccountsLoad *load);
+
+static void
+accounts_user_loaded_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    AccountsRequest *request = data;
+    AccountsLoad *load = request->load;
+    CommonUser *user = request->user;
+    GVariant *result;
+    GError *error = NULL;
+
+    g_free (request);
+
+    result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+    if (error)
+        g_warning ("Error updating user %s: %s", GET_USER_PRIVATE (user)->path, error->message);
+    g_clear_error (&error);
+    /* Users are added to the list once they have all loaded */
+    if (result && update_accounts_user (user, result))
+        load->users = g_list_prepend (load->users, user);
+    else
+        g_object_unref (user);
+    if (result)
+        g_variant_unref (result);
+
+    load->n_requests--;
+    send_accounts_requests (load);
+    if (load->async && load->n_requests == 0)
+        finish_async_load (load);
+}
+
+static void
+send_accounts_requests (AccountsLoad *load)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (load->user_list);
+
+    while (load->n_requests < MAX_ACCOUNTS_REQUESTS && !g_queue_is_empty (load->paths))
+    {
+        gchar *path = g_queue_pop_head (load->paths);
+        AccountsRequest *request;
+
+        request = g_new0 (AccountsRequest, 1);
+        request->load = load;
+        request->user_list = load->user_list;
+        request->user = make_accounts_user (load->user_list, path);
+        load->n_requests++;
+        g_dbus_connection_call (priv->bus,
+                                "org.freedesktop.Accounts",
+                                path,
+                                "org.freedesktop.DBus.Properties",
+                                "GetAll",
+                                g_variant_new ("(s)", "org.freedesktop.Accounts.User"),
+                                G_VARIANT_TYPE ("(a{sv})"),
+                                G_DBUS_CALL_FLAGS_NONE,
+                                -1,
+                                NULL,
+                                accounts_user_loaded_cb,
+                                request);
+        g_free (path);
+    }
+}
+
+static AccountsLoad *
+accounts_load_new (CommonUserList *user_list, gboolean async)
+{
+    AccountsLoad *load;
+
+    load = g_new0 (AccountsLoad, 1);
+    load->user_list = user_list;
+    load->async = async;
+    load->paths = g_queue_new ();
+    load->deleted_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    return load;
+}
+
+static void
+accounts_load_free (AccountsLoad *load)
+{
+    g_queue_free_full (load->paths, g_free);
+    g_list_free_full (load->users, g_object_unref);
+    g_hash_table_unref (load->deleted_paths);
+    g_free (load);
+}
+
+/* Queue the users from a ListCachedUsers result to be loaded */
+static void
+queue_accounts_users (AccountsLoad *load, GVariant *result)
+{
+    GVariantIter *iter;
+    const gchar *path;
+
+    g_debug ("Loading users from org.freedesktop.Accounts");
+    g_variant_get (result, "(ao)", &iter);
+    while (g_variant_iter_loop (iter, "&o", &path))
+        g_queue_push_tail (load->paths, g_strdup (path));
+    g_variant_iter_free (iter);
+}
+
+static void watch_passwd_file (CommonUserList *user_list);
+
+/* Use the password file when the accounts service isn't available */
+static void
+use_passwd_file (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_added_signal);
+    priv->user_added_signal = 0;
+    g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_removed_signal);
+    priv->user_removed_signal = 0;
+    g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_changed_signal);
+    priv->user_changed_signal = 0;
+
+    load_passwd_file (user_list);
+    watch_passwd_file (user_list);
+}
+
+/* Add the users that were loaded, returning the new users in order */
+static GList *
+add_loaded_users (AccountsLoad *load)
+{
+    CommonUserList *user_list = load->user_list;
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    GList *new_users = NULL, *link;
+
+    for (link = load->users; link; link = link->next)
     {
-        GList *new_link;
+        CommonUser *user = link->data;
+        const gchar *path = GET_USER_PRIVATE (user)->path;
 
-        /* See if this user is in the current list */
-        for (new_link = priv->users; new_link; new_link = new_link->next)
+        /* Skip users that were added or deleted by signals while loading */
+        if (get_user_by_path (user_list, path) || g_hash_table_contains (load->deleted_paths, path))
         {
-            if (new_link->data == link->data)
-                break;
+            g_object_unref (user);
+            continue;
         }
 
-        if (!new_link)
-        {
-            CommonUser *info = link->data;
-            g_debug ("User %s removed", common_user_get_name (info));
-            g_signal_emit (user_list, list_signals[USER_REMOVED], 0, info);
-            g_object_unref (info);
-        }
+        g_ptr_array_add (priv->users, user);
+        index_user (user_list, user);
+        new_users = g_list_prepend (new_users, user);
     }
-    g_list_free (old_users);
-}
+    g_list_free (load->users);
+    load->users = NULL;
 
-static void
-passwd_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file, GFileMonitorEvent event_type, CommonUserList *user_list)
-{
-    if (event_type == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+    if (new_users)
     {
-        g_debug ("%s changed, reloading user list", g_file_get_path (file));
-        load_passwd_file (user_list, TRUE);
+        g_ptr_array_sort (priv->users, compare_user_array);
+        users_changed (user_list);
     }
-}
 
-static gboolean load_accounts_user (CommonUser *user);
+    return g_list_sort (new_users, compare_user);
+}
 
 static void
-accounts_user_changed_cb (GDBusConnection *connection,
-                          const gchar *sender_name,
-                          const gchar *object_path,
-                          const gchar *interface_name,
-                          const gchar *signal_name,
-                          GVariant *parameters,
-                          gpointer data)
+finish_async_load (AccountsLoad *load)
 {
-    CommonUser *user = data;
-    /*CommonUserPrivate *priv = GET_USER_PRIVATE (user);*/
+    CommonUserList *user_list = load->user_list;
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    GList *new_users, *tasks, *link;
 
-    /* Log message disabled as AccountsService can have arbitrary plugins that
-     * might cause us to log when properties change we don't use. LP: #1376357
-     */
-    /*g_debug ("User %s changed", priv->path);*/
-    if (load_accounts_user (user))
-        g_signal_emit (user, user_signals[CHANGED], 0);
+    new_users = add_loaded_users (load);
+    priv->load = NULL;
+    priv->loaded = TRUE;
+    accounts_load_free (load);
+
+    /* Unlike a synchronous load, callers may already have a partial list so tell them about the new users */
+    for (link = new_users; link; link = link->next)
+        g_signal_emit (user_list, list_signals[USER_ADDED], 0, link->data);
+    g_list_free (new_users);
+
+    tasks = priv->load_tasks;
+    priv->load_tasks = NULL;
+    for (link = tasks; link; link = link->next)
+    {
+        g_task_return_boolean (link->data, TRUE);
+        g_object_unref (link->data);
+    }
+    g_list_free (tasks);
 }
 
-static gboolean
-load_accounts_user (CommonUser *user)
+static void
+list_cached_users_cb (GObject *object, GAsyncResult *res, gpointer data)
 {
-    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
-    GVariant *result, *value;
-    GVariantIter *iter;
-    gchar *name;
-    gboolean system_account = FALSE;
+    AccountsLoad *load = data;
+    GVariant *result;
     GError *error = NULL;
 
-    /* Get the properties for this user */
-    if (!priv->changed_signal)
-        priv->changed_signal = g_dbus_connection_signal_subscribe (priv->bus,
-                                                                   "org.freedesktop.Accounts",
-                                                                   "org.freedesktop.Accounts.User",
-                                                                   "Changed",
-                                                                   priv->path,
-                                                                   NULL,
-                                                                   G_DBUS_SIGNAL_FLAGS_NONE,
-                                                                   accounts_user_changed_cb,
-                                                                   user,
-                                                                   NULL);
-    result = g_dbus_connection_call_sync (priv->bus,
-                                          "org.freedesktop.Accounts",
-                                          priv->path,
-                                          "org.freedesktop.DBus.Properties",
-                                          "GetAll",
-                                          g_variant_new ("(s)", "org.freedesktop.Accounts.User"),
-                                          G_VARIANT_TYPE ("(a{sv})"),
-                                          G_DBUS_CALL_FLAGS_NONE,
-                                          -1,
-                                          NULL,
-                                          &error);
+    result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
     if (error)
-        g_warning ("Error updating user %s: %s", priv->path, error->message);
+        g_warning ("Error getting user list from org.freedesktop.Accounts: %s", error->message);
     g_clear_error (&error);
     if (!result)
-        return FALSE;
-
-    /* Store the properties we need */
-    g_variant_get (result, "(a{sv})", &iter);
-    while (g_variant_iter_loop (iter, "{&sv}", &name, &value))
     {
-        if (strcmp (name, "UserName") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            g_free (priv->name);
-            priv->name = g_variant_dup_string (value, NULL);
-        }
-        else if (strcmp (name, "RealName") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            g_free (priv->real_name);
-            priv->real_name = g_variant_dup_string (value, NULL);
-        }
-        else if (strcmp (name, "HomeDirectory") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            g_free (priv->home_directory);
-            priv->home_directory = g_variant_dup_string (value, NULL);
-        }
-        else if (strcmp (name, "Shell") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            g_free (priv->shell);
-            priv->shell = g_variant_dup_string (value, NULL);
-        }
-        else if (strcmp (name, "SystemAccount") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
-            system_account = g_variant_get_boolean (value);
-        else if (strcmp (name, "Language") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            if (priv->language)
-                g_free (priv->language);
-            priv->language = g_variant_dup_string (value, NULL);
-        }
-        else if (strcmp (name, "IconFile") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            g_free (priv->image);
-            priv->image = g_variant_dup_string (value, NULL);
-            if (strcmp (priv->image, "") == 0)
-            {
-                g_free (priv->image);
-                priv->image = NULL;
-            }
-        }
-        else if (strcmp (name, "XSession") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            g_free (priv->session);
-            priv->session = g_variant_dup_string (value, NULL);
-        }
-        else if (strcmp (name, "BackgroundFile") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-        {
-            g_free (priv->background);
-            priv->background = g_variant_dup_string (value, NULL);
-            if (strcmp (priv->background, "") == 0)
-            {
-                g_free (priv->background);
-                priv->background = NULL;
-            }
-        }
-        else if (strcmp (name, "XKeyboardLayouts") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING_ARRAY))
-        {
-            g_strfreev (priv->layouts);
-            priv->layouts = g_variant_dup_strv (value, NULL);
-            if (!priv->layouts)
-            {
-                priv->layouts = g_malloc (sizeof (gchar *) * 1);
-                priv->layouts[0] = NULL;
-            }
-        }
-        else if (strcmp (name, "XHasMessages") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
-            priv->has_messages = g_variant_get_boolean (value);
-        else if (strcmp (name, "Uid") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_UINT64))
-            priv->uid = g_variant_get_uint64 (value);
+        use_passwd_file (load->user_list);
+        finish_async_load (load);
+        return;
     }
-    g_variant_iter_free (iter);
 
+    queue_accounts_users (load, result);
     g_variant_unref (result);
 
-    return !system_account;
-}
-
-static void
-add_accounts_user (CommonUserList *user_list, const gchar *path, gboolean emit_signal)
-{
-    CommonUserListPrivate *list_priv = GET_LIST_PRIVATE (user_list);
-    CommonUser *user;
-    CommonUserPrivate *priv;
-
-    user = g_object_new (COMMON_TYPE_USER, NULL);
-    priv = GET_USER_PRIVATE (user);
-
-    g_debug ("User %s added", path);
-    priv->bus = g_object_ref (list_priv->bus);
-    priv->path = g_strdup (path);
-    g_signal_connect (user, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
-    g_signal_connect (user, "get-logged-in", G_CALLBACK (get_logged_in_cb), user_list);  
-    if (load_accounts_user (user))
-    {
-        list_priv->users = g_list_insert_sorted (list_priv->users, user, compare_user);
-        if (emit_signal)      
-            g_signal_emit (user_list, list_signals[USER_ADDED], 0, user);
-    }
-    else
-        g_object_unref (user);
+    send_accounts_requests (load);
+    if (load->n_requests == 0)
+        finish_async_load (load);
 }
 
 static void
@@ -662,7 +1374,7 @@ accounts_user_added_cb (GDBusConnection *connection,
     /* Add user if we haven't got them */
     user = get_user_by_path (user_list, path);
     if (!user)
-        add_accounts_user (user_list, path, TRUE);
+        add_accounts_user (user_list, path);
 }
 
 static void
@@ -687,12 +1399,18 @@ accounts_user_deleted_cb (GDBusConnection *connection,
 
     g_variant_get (parameters, "(&o)", &path);
 
+    /* Don't add the user if they were still loading */
+    if (priv->load)
+        g_hash_table_add (priv->load->deleted_paths, g_strdup (path));
+
     /* Delete user if we know of them */
     user = get_user_by_path (user_list, path);
     if (user)
     {
         g_debug ("User %s deleted", path);
-        priv->users = g_list_remove (priv->users, user);
+        g_ptr_array_remove (priv->users, user);
+        users_changed (user_list);
+        unindex_user (user_list, user);
 
         g_signal_emit (user_list, list_signals[USER_REMOVED], 0, user);
 
@@ -879,17 +1597,28 @@ load_sessions (CommonUserList *user_list)
 }
 
 static void
-load_users (CommonUserList *user_list)
+watch_passwd_file (CommonUserList *user_list)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
-    GVariant *result;
+    GFile *passwd_file;
     GError *error = NULL;
 
-    if (priv->have_users)
-        return;
-    priv->have_users = TRUE;
+    passwd_file = g_file_new_for_path (PASSWD_FILE);
+    priv->passwd_monitor = g_file_monitor (passwd_file, G_FILE_MONITOR_NONE, NULL, &error);
+    g_object_unref (passwd_file);
+    if (error)
+        g_warning ("Error monitoring %s: %s", PASSWD_FILE, error->message);
+    else
+        g_signal_connect (priv->passwd_monitor, "changed", G_CALLBACK (passwd_changed_cb), user_list);
+    g_clear_error (&error);
+}
+
+/* Listen for accounts service events, these are dropped if we fall back to the password file */
+static void
+subscribe_accounts_signals (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
-    /* Get user list from accounts service and fall back to /etc/passwd if that fails */
     priv->user_added_signal = g_dbus_connection_signal_subscribe (priv->bus,
                                                                   "org.freedesktop.Accounts",
                                                                   "org.freedesktop.Accounts",
@@ -910,6 +1639,33 @@ load_users (CommonUserList *user_list)
                                                                     accounts_user_deleted_cb,
                                                                     user_list,
                                                                     NULL);
+    priv->user_changed_signal = g_dbus_connection_signal_subscribe (priv->bus,
+                                                                    "org.freedesktop.Accounts",
+                                                                    "org.freedesktop.Accounts.User",
+                                                                    "Changed",
+                                                                    NULL,
+                                                                    NULL,
+                                                                    G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                    accounts_user_changed_cb,
+                                                                    user_list,
+                                                                    NULL);
+}
+
+/* Load the users if they haven't been, blocking until they are all available */
+static void
+load_users (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    AccountsLoad *load;
+    GVariant *result;
+    GError *error = NULL;
+
+    if (priv->have_users)
+        return;
+    priv->have_users = TRUE;
+
+    /* Get user list from accounts service and fall back to /etc/passwd if that fails */
+    subscribe_accounts_signals (user_list);
     result = g_dbus_connection_call_sync (priv->bus,
                                           "org.freedesktop.Accounts",
                                           "/org/freedesktop/Accounts",
@@ -926,38 +1682,100 @@ load_users (CommonUserList *user_list)
     g_clear_error (&error);
     if (result)
     {
-        GVariantIter *iter;
-        const gchar *path;
-
-        g_debug ("Loading users from org.freedesktop.Accounts");
-        g_variant_get (result, "(ao)", &iter);
-        while (g_variant_iter_loop (iter, "&o", &path))
-            add_accounts_user (user_list, path, FALSE);
-        g_variant_iter_free (iter);
+        GMainContext *context;
+
+        load = accounts_load_new (user_list, FALSE);
+        queue_accounts_users (load, result);
         g_variant_unref (result);
+
+        /* Wait for the replies on a private context so callers get a complete
+         * list and no other events are dispatched while it is incomplete */
+        context = g_main_context_new ();
+        g_main_context_push_thread_default (context);
+        send_accounts_requests (load);
+        while (load->n_requests > 0)
+            g_main_context_iteration (context, TRUE);
+        g_main_context_pop_thread_default (context);
+        g_main_context_unref (context);
+
+        g_list_free (add_loaded_users (load));
+        accounts_load_free (load);
     }
     else
-    {
-        GFile *passwd_file;
+        use_passwd_file (user_list);
 
-        g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_added_signal);
-        priv->user_added_signal = 0;
-        g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_removed_signal);
-        priv->user_removed_signal = 0;
+    priv->loaded = TRUE;
+}
+
+/**
+ * common_user_list_load_async:
+ * @user_list: A #CommonUserList
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: (allow-none): A #GAsyncReadyCallback to call when the users are loaded or %NULL.
+ * @user_data: (allow-none): data to pass to the @callback or %NULL.
+ *
+ * Load the users without blocking.  Until @callback is called
+ * common_user_list_get_users() returns only the users loaded so far, and
+ * ::user-added is emitted for each user as they are added.  Users that are
+ * looked up by name or UID before they have loaded come from the password
+ * database.  If the users have already been loaded @callback is called once
+ * control returns to the main loop.
+ **/
+void
+common_user_list_load_async (CommonUserList *user_list, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    CommonUserListPrivate *priv;
+    GTask *task;
 
-        load_passwd_file (user_list, FALSE);
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
 
-        /* Watch for changes to user list */
+    priv = GET_LIST_PRIVATE (user_list);
 
-        passwd_file = g_file_new_for_path (PASSWD_FILE);
-        priv->passwd_monitor = g_file_monitor (passwd_file, G_FILE_MONITOR_NONE, NULL, &error);
-        g_object_unref (passwd_file);
-        if (error)
-            g_warning ("Error monitoring %s: %s", PASSWD_FILE, error->message);
-        else
-            g_signal_connect (priv->passwd_monitor, "changed", G_CALLBACK (passwd_changed_cb), user_list);
-        g_clear_error (&error);
+    task = g_task_new (user_list, cancellable, callback, user_data);
+    if (priv->loaded)
+    {
+        g_task_return_boolean (task, TRUE);
+        g_object_unref (task);
+        return;
     }
+    priv->load_tasks = g_list_append (priv->load_tasks, task);
+
+    /* Already loading */
+    if (priv->have_users)
+        return;
+    priv->have_users = TRUE;
+
+    subscribe_accounts_signals (user_list);
+    priv->load = accounts_load_new (user_list, TRUE);
+    g_dbus_connection_call (priv->bus,
+                            "org.freedesktop.Accounts",
+                            "/org/freedesktop/Accounts",
+                            "org.freedesktop.Accounts",
+                            "ListCachedUsers",
+                            g_variant_new ("()"),
+                            G_VARIANT_TYPE ("(ao)"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            NULL,
+                            list_cached_users_cb,
+                            priv->load);
+}
+
+/**
+ * common_user_list_load_finish:
+ * @user_list: A #CommonUserList
+ * @result: A #GAsyncResult.
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finish loading the users started with common_user_list_load_async().
+ *
+ * Return value: #TRUE if the users were loaded.
+ **/
+gboolean
+common_user_list_load_finish (CommonUserList *user_list, GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail (g_task_is_valid (result, user_list), FALSE);
+    return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 /**
@@ -971,7 +1789,7 @@ common_user_list_get_length (CommonUserList *user_list)
 {
     g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), 0);
     load_users (user_list);
-    return g_list_length (GET_LIST_PRIVATE (user_list)->users);
+    return GET_LIST_PRIVATE (user_list)->users->len;
 }
 
 /**
@@ -986,9 +1804,22 @@ common_user_list_get_length (CommonUserList *user_list)
 GList *
 common_user_list_get_users (CommonUserList *user_list)
 {
+    CommonUserListPrivate *priv;
+
     g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), NULL);
+
     load_users (user_list);
-    return GET_LIST_PRIVATE (user_list)->users;
+
+    priv = GET_LIST_PRIVATE (user_list);
+    if (!priv->users_list)
+    {
+        guint i;
+
+        for (i = priv->users->len; i > 0; i--)
+            priv->users_list = g_list_prepend (priv->users_list, g_ptr_array_index (priv->users, i - 1));
+    }
+
+    return priv->users_list;
 }
 
 /**
@@ -1025,12 +1856,47 @@ common_user_list_get_user_by_name (CommonUserList *user_list, const gchar *usern
     return NULL;
 }
 
+/**
+ * common_user_list_get_user_by_uid:
+ * @user_list: A #CommonUserList
+ * @uid: UID of user to get.
+ *
+ * Get infomation about a given user or #NULL if this user doesn't exist.
+ * Includes hidden and system users, unlike the list from
+ * common_user_list_get_users.
+ *
+ * Return value: (transfer full): A #CommonUser entry for the given user.
+ **/
+CommonUser *
+common_user_list_get_user_by_uid (CommonUserList *user_list, uid_t uid)
+{
+    g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), NULL);
+
+    load_users (user_list);
+
+    CommonUser *user = get_user_by_uid (user_list, uid);
+    if (user)
+        return g_object_ref (user);
+
+    struct passwd *entry = getpwuid (uid);
+    if (entry != NULL)
+        return make_passwd_user (user_list, entry);
+
+    return NULL;
+}
+
 static void
 common_user_list_init (CommonUserList *user_list)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
     priv->bus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
+    priv->users = g_ptr_array_new ();
+    priv->users_by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->users_by_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->users_by_uid = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->image_queue = g_queue_new ();
+    priv->missing_images = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
 static void
@@ -1070,19 +1936,33 @@ common_user_list_finalize (GObject *object)
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (self);
 
     /* Remove children first, they might access us */
-    g_list_free_full (priv->users, g_object_unref);
+    g_hash_table_unref (priv->users_by_name);
+    g_hash_table_unref (priv->users_by_path);
+    g_hash_table_unref (priv->users_by_uid);
+    g_queue_free_full (priv->image_queue, g_object_unref);
+    g_hash_table_unref (priv->missing_images);
+    g_list_free (priv->users_list);
+    g_slist_free_full (priv->old_users_lists, (GDestroyNotify) g_list_free);
+    if (priv->free_old_users_lists_source)
+        g_source_remove (priv->free_old_users_lists_source);
+    g_ptr_array_foreach (priv->users, (GFunc) g_object_unref, NULL);
+    g_ptr_array_unref (priv->users);
     g_list_free_full (priv->sessions, g_object_unref);
 
     if (priv->user_added_signal)
         g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_added_signal);
     if (priv->user_removed_signal)
         g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_removed_signal);
+    if (priv->user_changed_signal)
+        g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_changed_signal);
     if (priv->session_added_signal)
         g_dbus_connection_signal_unsubscribe (priv->bus, priv->session_added_signal);
     if (priv->session_removed_signal)
         g_dbus_connection_signal_unsubscribe (priv->bus, priv->session_removed_signal);
     g_object_unref (priv->bus);
     g_clear_object (&priv->passwd_monitor);
+    if (priv->passwd_entries)
+        g_hash_table_unref (priv->passwd_entries);
 
     G_OBJECT_CLASS (common_user_list_parent_class)->finalize (object);
 }
@@ -1323,15 +2203,28 @@ common_user_get_shell (CommonUser *user)
  * common_user_get_image:
  * @user: A #CommonUser
  * 
- * Get the image URI for a user.
+ * Get the image URI for a user.  For users not from the accounts service the
+ * image is looked up in the background the first time this is called, so this
+ * returns #NULL until the lookup completes.  The image property is notified and
+ * the ::changed signal is emitted when the image is found.
  * 
  * Return value: The image URI for the given user or #NULL if no URI
  **/
 const gchar *
 common_user_get_image (CommonUser *user)
 {
+    CommonUserPrivate *priv;
+
     g_return_val_if_fail (COMMON_IS_USER (user), NULL);
-    return GET_USER_PRIVATE (user)->image;
+
+    priv = GET_USER_PRIVATE (user);
+    if (!priv->path && !priv->loaded_image)
+    {
+        priv->loaded_image = TRUE;
+        g_signal_emit (user, user_signals[LOAD_IMAGE], 0);
+    }
+
+    return priv->image;
 }
 
 /**
@@ -1613,14 +2506,13 @@ common_user_finalize (GObject *object)
     CommonUserPrivate *priv = GET_USER_PRIVATE (self);
 
     g_free (priv->path);
-    if (priv->changed_signal)
-        g_dbus_connection_signal_unsubscribe (priv->bus, priv->changed_signal);
     g_clear_object (&priv->bus);
     g_free (priv->name);
     g_free (priv->real_name);
     g_free (priv->home_directory);
     g_free (priv->shell);
     g_free (priv->image);
+    g_free (priv->collate_key);
     g_free (priv->background);
     g_free (priv->language);
     g_strfreev (priv->layouts);
@@ -1772,6 +2664,15 @@ common_user_class_init (CommonUserClass *klass)
                       NULL,
                       NULL,
                       G_TYPE_BOOLEAN, 0);
+
+    user_signals[LOAD_IMAGE] =
+        g_signal_new ("load-image",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      0,
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
 }
 
 static void
@@ -13,7 +13,7 @@
 #ifndef COMMON_USER_LIST_H_
 #define COMMON_USER_LIST_H_
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include <sys/types.h>
 
 G_BEGIN_DECLS
@@ -72,10 +72,16 @@ CommonUserList *common_user_list_get_instance (void);
 
 void common_user_list_cleanup (void);
 
+void common_user_list_load_async (CommonUserList *user_list, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+gboolean common_user_list_load_finish (CommonUserList *user_list, GAsyncResult *result, GError **error);
+
 gint common_user_list_get_length (CommonUserList *user_list);
 
 CommonUser *common_user_list_get_user_by_name (CommonUserList *user_list, const gchar *username);
 
+CommonUser *common_user_list_get_user_by_uid (CommonUserList *user_list, uid_t uid);
+
 GList *common_user_list_get_users (CommonUserList *user_list);
 
 const gchar *common_user_get_name (CommonUser *user);
@@ -11,7 +11,7 @@
 #ifndef LIGHTDM_USER_H_
 #define LIGHTDM_USER_H_
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -110,6 +110,10 @@ LightDMUser *lightdm_user_list_get_user_by_name (LightDMUserList *user_list, con
 
 GList *lightdm_user_list_get_users (LightDMUserList *user_list);
 
+void lightdm_user_list_load (LightDMUserList *user_list, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+gboolean lightdm_user_list_load_finish (LightDMUserList *user_list, GAsyncResult *result, GError **error);
+
 const gchar *lightdm_user_get_name (LightDMUser *user);
 
 const gchar *lightdm_user_get_real_name (LightDMUser *user);
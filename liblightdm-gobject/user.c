@@ -141,11 +141,18 @@ user_changed_cb (CommonUser *common_user, LightDMUser *lightdm_user)
     g_signal_emit (lightdm_user, user_signals[CHANGED], 0);
 }
 
+static void
+user_image_notify_cb (CommonUser *common_user, GParamSpec *pspec, LightDMUser *lightdm_user)
+{
+    g_object_notify (G_OBJECT (lightdm_user), "image");
+}
+
 static LightDMUser *
 wrap_common_user (CommonUser *user)
 {
     LightDMUser *lightdm_user = g_object_new (LIGHTDM_TYPE_USER, "common-user", user, NULL);
     g_signal_connect (user, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), lightdm_user);
+    g_signal_connect (user, "notify::image", G_CALLBACK (user_image_notify_cb), lightdm_user);
     return lightdm_user;
 }
 
@@ -163,8 +170,21 @@ static void
 user_list_changed_cb (CommonUserList *common_list, CommonUser *common_user, LightDMUserList *user_list)
 {
     LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
-    GList *common_users = common_user_list_get_users (common_list);
-    LightDMUser *lightdm_user = g_list_nth_data (priv->lightdm_list, g_list_index (common_users, common_user));
+    GList *common_users, *link;
+    LightDMUser *lightdm_user;
+
+    for (link = priv->lightdm_list; link; link = link->next)
+        if (GET_USER_PRIVATE (link->data)->common_user == common_user)
+            break;
+    if (!link)
+        return;
+
+    /* Keep the same order as the common list, which changes if the user was renamed */
+    lightdm_user = link->data;
+    priv->lightdm_list = g_list_delete_link (priv->lightdm_list, link);
+    common_users = common_user_list_get_users (common_list);
+    priv->lightdm_list = g_list_insert (priv->lightdm_list, lightdm_user, g_list_index (common_users, common_user));
+
     g_signal_emit (user_list, list_signals[USER_CHANGED], 0, lightdm_user);
 }
 
@@ -275,6 +295,69 @@ lightdm_user_list_get_user_by_name (LightDMUserList *user_list, const gchar *use
     return NULL;
 }
 
+static void
+user_list_loaded_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    GTask *task = data;
+    GError *error = NULL;
+
+    if (common_user_list_load_finish (COMMON_USER_LIST (object), result, &error))
+        g_task_return_boolean (task, TRUE);
+    else
+        g_task_return_error (task, error);
+    g_object_unref (task);
+}
+
+/**
+ * lightdm_user_list_load:
+ * @user_list: A #LightDMUserList
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @callback: (allow-none): A #GAsyncReadyCallback to call when completed or %NULL.
+ * @user_data: (allow-none): data to pass to the @callback or %NULL.
+ *
+ * Asynchronously load the users.  Greeters can call this at startup instead of
+ * blocking in the first call to lightdm_user_list_get_users() while the account
+ * information is loaded.
+ *
+ * Until the operation is finished lightdm_user_list_get_users() only returns
+ * the users that have loaded so far and the #LightDMUserList::user-added signal
+ * is emitted as the rest are added.  When the operation is finished, @callback
+ * will be invoked. You can then call lightdm_user_list_load_finish() to get the
+ * result of the operation.
+ **/
+void
+lightdm_user_list_load (LightDMUserList *user_list, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    GTask *task;
+
+    g_return_if_fail (LIGHTDM_IS_USER_LIST (user_list));
+
+    task = g_task_new (user_list, cancellable, callback, user_data);
+
+    /* Start loading before connecting to the list so the users it has so far are
+     * copied without blocking, the rest are added by signals */
+    common_user_list_load_async (common_user_list_get_instance (), cancellable, user_list_loaded_cb, task);
+    initialize_user_list_if_needed (user_list);
+}
+
+/**
+ * lightdm_user_list_load_finish:
+ * @user_list: A #LightDMUserList
+ * @result: A #GAsyncResult.
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with lightdm_user_list_load().
+ *
+ * Return value: #TRUE if the users were loaded
+ **/
+gboolean
+lightdm_user_list_load_finish (LightDMUserList *user_list, GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail (LIGHTDM_IS_USER_LIST (user_list), FALSE);
+    g_return_val_if_fail (g_task_is_valid (result, user_list), FALSE);
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 static void
 lightdm_user_list_init (LightDMUserList *user_list)
 {
@@ -469,7 +552,10 @@ lightdm_user_get_home_directory (LightDMUser *user)
  * lightdm_user_get_image:
  * @user: A #LightDMUser
  *
- * Get the image URI for a user.
+ * Get the image URI for a user.  Images in the home directory of users not from
+ * the accounts service are looked up in the background, so this may return
+ * #NULL at first.  Connect to notify::image or #LightDMUser::changed to be told
+ * when the image is found.
  *
  * Return value: (nullable): The image URI for the given user or #NULL if no URI
  **/
@@ -688,6 +774,7 @@ lightdm_user_finalize (GObject *object)
     LightDMUser *self = LIGHTDM_USER (object);
     LightDMUserPrivate *priv = GET_USER_PRIVATE (self);
 
+    g_signal_handlers_disconnect_by_data (priv->common_user, self);
     g_object_unref (priv->common_user);
 
     G_OBJECT_CLASS (lightdm_user_parent_class)->finalize (object);
@@ -45,11 +45,17 @@ accounts_get_user_by_name (const gchar *username)
 User *
 accounts_get_current_user ()
 {
-    struct passwd *entry = getpwuid (getuid ());
-    if (entry != NULL)
-        return accounts_get_user_by_name (entry->pw_name);
-    else
-        return NULL;
+    User *user = NULL;
+    CommonUser *common_user;
+
+    common_user = common_user_list_get_user_by_uid (common_user_list_get_instance (), getuid ());
+    if (common_user != NULL)
+    {
+        user = g_object_new (USER_TYPE, NULL);
+        user->priv->common_user = common_user;
+    }
+
+    return user;
 }
 
 const gchar *
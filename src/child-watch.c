@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <glib-unix.h>
+
+#include "child-watch.h"
+
+#if defined(SYS_pidfd_open) && defined(SYS_pidfd_send_signal)
+#define HAVE_PIDFD 1
+#endif
+
+struct ChildWatch
+{
+    /* Process being watched */
+    GPid pid;
+
+    /* File descriptor referring to the process or -1 if not supported */
+    int pidfd;
+
+    /* Source that is notified when the process exits, 0 once it has been reaped */
+    guint source;
+
+    /* Function to call when the process exits */
+    GChildWatchFunc func;
+    gpointer data;
+};
+
+/* Cleared on the first failure so kernels without pidfds don't pay for a syscall per child */
+static gboolean pidfd_supported = TRUE;
+
+static int
+open_pidfd (GPid pid)
+{
+#ifdef HAVE_PIDFD
+    int fd;
+
+    if (!pidfd_supported)
+        return -1;
+
+    /* The kernel creates pidfds close-on-exec */
+    fd = syscall (SYS_pidfd_open, pid, 0);
+    if (fd < 0 && (errno == ENOSYS || errno == EPERM))
+    {
+        g_debug ("pidfds not supported, using SIGCHLD to watch child processes");
+        pidfd_supported = FALSE;
+    }
+
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static void
+child_exited (ChildWatch *watch, gint status)
+{
+    /* Note the callback may free the watch */
+    watch->source = 0;
+    watch->func (watch->pid, status, watch->data);
+}
+
+static gboolean
+pidfd_cb (gint fd, GIOCondition condition, gpointer data)
+{
+    ChildWatch *watch = data;
+    pid_t result;
+    int status = 0;
+
+    do
+        result = waitpid (watch->pid, &status, WNOHANG);
+    while (result < 0 && errno == EINTR);
+
+    /* Readable pidfds mean the process has exited, so this should only happen if someone else reaped it */
+    if (result == 0)
+        return G_SOURCE_CONTINUE;
+    /* The exit status is lost, so report it as a failure rather than a clean exit */
+    if (result < 0)
+    {
+        g_warning ("Failed to reap process %d: %s", watch->pid, strerror (errno));
+        status = W_EXITCODE (EXIT_FAILURE, 0);
+    }
+
+    child_exited (watch, status);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+child_watch_cb (GPid pid, gint status, gpointer data)
+{
+    child_exited (data, status);
+}
+
+ChildWatch *
+child_watch_new (GPid pid, GChildWatchFunc func, gpointer data)
+{
+    ChildWatch *watch;
+
+    g_return_val_if_fail (pid > 0, NULL);
+    g_return_val_if_fail (func != NULL, NULL);
+
+    watch = g_malloc0 (sizeof (ChildWatch));
+    watch->pid = pid;
+    watch->func = func;
+    watch->data = data;
+
+    /* Poll a descriptor for this process so we get notified directly and signals can't go to a recycled pid.
+       Fall back to GLib's SIGCHLD handling on older kernels */
+    watch->pidfd = open_pidfd (pid);
+    if (watch->pidfd >= 0)
+        watch->source = g_unix_fd_add (watch->pidfd, G_IO_IN, pidfd_cb, watch);
+    else
+        watch->source = g_child_watch_add (pid, child_watch_cb, watch);
+
+    return watch;
+}
+
+void
+child_watch_disable_pidfd (void)
+{
+    pidfd_supported = FALSE;
+}
+
+gboolean
+child_watch_get_uses_pidfd (ChildWatch *watch)
+{
+    g_return_val_if_fail (watch != NULL, FALSE);
+    return watch->pidfd >= 0;
+}
+
+gboolean
+child_watch_signal (ChildWatch *watch, int signum)
+{
+    g_return_val_if_fail (watch != NULL, FALSE);
+
+    /* Once reaped the pid may belong to another process */
+    if (watch->source == 0)
+    {
+        errno = ESRCH;
+        return FALSE;
+    }
+
+#ifdef HAVE_PIDFD
+    if (watch->pidfd >= 0)
+        return syscall (SYS_pidfd_send_signal, watch->pidfd, signum, NULL, 0) == 0;
+#endif
+
+    return kill (watch->pid, signum) == 0;
+}
+
+void
+child_watch_free (ChildWatch *watch)
+{
+    if (!watch)
+        return;
+
+    if (watch->source)
+        g_source_remove (watch->source);
+    if (watch->pidfd >= 0)
+        close (watch->pidfd);
+    g_free (watch);
+}
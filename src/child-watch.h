@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef CHILD_WATCH_H_
+#define CHILD_WATCH_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct ChildWatch ChildWatch;
+
+ChildWatch *child_watch_new (GPid pid, GChildWatchFunc func, gpointer data);
+
+void child_watch_disable_pidfd (void);
+
+gboolean child_watch_get_uses_pidfd (ChildWatch *watch);
+
+gboolean child_watch_signal (ChildWatch *watch, int signum);
+
+void child_watch_free (ChildWatch *watch);
+
+G_END_DECLS
+
+#endif /* CHILD_WATCH_H_ */
@@ -11,10 +11,13 @@
 #include <config.h>
 
 #include "display-manager-service.h"
+#include "login-metrics.h"
+#include "trace.h"
 
 enum {
     READY,
     ADD_XLOCAL_SEAT,
+    RELOAD_CONFIG,
     NAME_LOST,
     LAST_SIGNAL
 };
@@ -213,6 +216,10 @@ handle_display_manager_get_property (GDBusConnection       *connection,
         return get_seat_list (service);
     else if (g_strcmp0 (property_name, "Sessions") == 0)
         return get_session_list (service, NULL);
+    else if (g_strcmp0 (property_name, "LoginLatency") == 0)
+        return login_metrics_get_summary ();
+    else if (g_strcmp0 (property_name, "SeatLoginLatency") == 0)
+        return login_metrics_get_seat_summaries ();
 
     return NULL;
 }
@@ -256,6 +263,37 @@ handle_display_manager_call (GDBusConnection       *connection,
         g_dbus_method_invocation_return_value (invocation, g_variant_new ("(o)", entry->path));
         g_object_unref (seat);
     }
+    else if (g_strcmp0 (method_name, "ReloadConfig") == 0)
+    {
+        if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("()")))
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid arguments");
+            return;
+        }
+
+        g_signal_emit (service, signals[RELOAD_CONFIG], 0);
+        g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+    else if (g_strcmp0 (method_name, "GetTrace") == 0)
+    {
+        gchar *trace;
+
+        if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("()")))
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS, "Invalid arguments");
+            return;
+        }
+
+        if (!trace_get_enabled ())
+        {
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED, "Tracing is not enabled");
+            return;
+        }
+
+        trace = trace_to_json ();
+        g_dbus_method_invocation_return_value (invocation, g_variant_new ("(s)", trace));
+        g_free (trace);
+    }
     else
         g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method");
 }
@@ -275,6 +313,8 @@ handle_seat_get_property (GDBusConnection       *connection,
         return g_variant_new_boolean (seat_get_can_switch (entry->seat));
     if (g_strcmp0 (property_name, "HasGuestAccount") == 0)
         return g_variant_new_boolean (seat_get_allow_guest (entry->seat));
+    else if (g_strcmp0 (property_name, "SpareGreeterReady") == 0)
+        return g_variant_new_boolean (seat_get_spare_greeter_ready (entry->seat));
     else if (g_strcmp0 (property_name, "Sessions") == 0)
         return get_session_list (entry->service, entry->path);
 
@@ -489,6 +529,16 @@ session_removed_cb (Seat *seat, Session *session, DisplayManagerService *service
     }
 }
 
+static void
+spare_greeter_changed_cb (Seat *seat, DisplayManagerService *service)
+{
+    SeatBusEntry *entry;
+
+    entry = g_hash_table_lookup (service->priv->seat_bus_entries, seat);
+    if (entry)
+        emit_object_value_changed (service->priv->bus, entry->path, "org.freedesktop.DisplayManager.Seat", "SpareGreeterReady", g_variant_new_boolean (seat_get_spare_greeter_ready (seat)));
+}
+
 static void
 seat_added_cb (DisplayManager *display_manager, Seat *seat, DisplayManagerService *service)
 {
@@ -525,6 +575,7 @@ seat_added_cb (DisplayManager *display_manager, Seat *seat, DisplayManagerServic
 
     g_signal_connect (seat, SEAT_SIGNAL_RUNNING_USER_SESSION, G_CALLBACK (running_user_session_cb), service);
     g_signal_connect (seat, SEAT_SIGNAL_SESSION_REMOVED, G_CALLBACK (session_removed_cb), service);
+    g_signal_connect (seat, SEAT_SIGNAL_SPARE_GREETER_CHANGED, G_CALLBACK (spare_greeter_changed_cb), service);
 }
 
 static void
@@ -554,6 +605,8 @@ bus_acquired_cb (GDBusConnection *connection,
         "  <interface name='org.freedesktop.DisplayManager'>"
         "    <property name='Seats' type='ao' access='read'/>"
         "    <property name='Sessions' type='ao' access='read'/>"
+        "    <property name='LoginLatency' type='" LOGIN_METRICS_SUMMARY_TYPE "' access='read'/>"
+        "    <property name='SeatLoginLatency' type='a{s" LOGIN_METRICS_SUMMARY_TYPE "}' access='read'/>"
         "    <method name='AddSeat'>"
         "      <arg name='type' direction='in' type='s'/>"
         "      <arg name='properties' direction='in' type='a(ss)'/>"
@@ -563,6 +616,10 @@ bus_acquired_cb (GDBusConnection *connection,
         "      <arg name='display-number' direction='in' type='i'/>"
         "      <arg name='seat' direction='out' type='o'/>"
         "    </method>"
+        "    <method name='ReloadConfig'/>"
+        "    <method name='GetTrace'>"
+        "      <arg name='trace' direction='out' type='s'/>"
+        "    </method>"
         "    <signal name='SeatAdded'>"
         "      <arg name='seat' type='o'/>"
         "    </signal>"
@@ -587,6 +644,7 @@ bus_acquired_cb (GDBusConnection *connection,
         "  <interface name='org.freedesktop.DisplayManager.Seat'>"
         "    <property name='CanSwitch' type='b' access='read'/>"
         "    <property name='HasGuestAccount' type='b' access='read'/>"
+        "    <property name='SpareGreeterReady' type='b' access='read'/>"
         "    <property name='Sessions' type='ao' access='read'/>"
         "    <method name='SwitchToGreeter'/>"
         "    <method name='SwitchToUser'>"
@@ -735,6 +793,15 @@ display_manager_service_class_init (DisplayManagerServiceClass *klass)
                       NULL,
                       SEAT_TYPE, 1, G_TYPE_INT);
 
+    signals[RELOAD_CONFIG] =
+        g_signal_new (DISPLAY_MANAGER_SERVICE_SIGNAL_RELOAD_CONFIG,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (DisplayManagerServiceClass, reload_config),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
+
     signals[NAME_LOST] =
         g_signal_new (DISPLAY_MANAGER_SERVICE_SIGNAL_NAME_LOST,
                       G_TYPE_FROM_CLASS (klass),
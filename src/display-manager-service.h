@@ -22,6 +22,7 @@ G_BEGIN_DECLS
 
 #define DISPLAY_MANAGER_SERVICE_SIGNAL_READY           "ready"
 #define DISPLAY_MANAGER_SERVICE_SIGNAL_ADD_XLOCAL_SEAT "add-xlocal-seat"
+#define DISPLAY_MANAGER_SERVICE_SIGNAL_RELOAD_CONFIG   "reload-config"
 #define DISPLAY_MANAGER_SERVICE_SIGNAL_NAME_LOST       "name-lost"
 
 typedef struct DisplayManagerServicePrivate DisplayManagerServicePrivate;
@@ -38,6 +39,7 @@ typedef struct
 
     void  (*ready)(DisplayManagerService *service);
     Seat *(*add_xlocal_seat)(DisplayManagerService *service, gint display_number);
+    void  (*reload_config)(DisplayManagerService *service);
     void  (*name_lost)(DisplayManagerService *service);
 } DisplayManagerServiceClass;
 
@@ -12,6 +12,7 @@
 #include <config.h>
 
 #include "display-server.h"
+#include "trace.h"
 
 enum {
     READY,
@@ -25,6 +26,9 @@ struct DisplayServerPrivate
     /* TRUE when started */
     gboolean is_ready;
 
+    /* Time the display server was started */
+    gint64 start_time;
+
     /* TRUE when being stopped */
     gboolean stopping;
 
@@ -86,9 +90,19 @@ gboolean
 display_server_start (DisplayServer *server)
 {
     g_return_val_if_fail (server != NULL, FALSE);
+    server->priv->start_time = g_get_monotonic_time ();
+    trace_begin (server, "display-server", NULL);
+    trace_begin (server, "start", NULL);
     return DISPLAY_SERVER_GET_CLASS (server)->start (server);
 }
 
+gint64
+display_server_get_start_time (DisplayServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->start_time;
+}
+
 gboolean
 display_server_get_is_ready (DisplayServer *server)
 {
@@ -100,6 +114,7 @@ static gboolean
 display_server_real_start (DisplayServer *server)
 {
     server->priv->is_ready = TRUE;
+    trace_end (server, "start", NULL);
     g_signal_emit (server, signals[READY], 0);
     return TRUE;
 }
@@ -148,6 +163,7 @@ display_server_get_is_stopping (DisplayServer *server)
 static void
 display_server_real_stop (DisplayServer *server)
 {
+    trace_end (server, "display-server", NULL);
     g_signal_emit (server, signals[STOPPED], 0);
 }
 
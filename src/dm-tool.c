@@ -101,6 +101,42 @@ get_seat_proxy (void)
     return seat_proxy;
 }
 
+static void
+print_latency (GVariant *summary, const gchar *indent)
+{
+    GVariantIter *iter;
+    const gchar *name;
+    guint64 count, total, minimum, maximum;
+    GVariant *buckets;
+
+    g_variant_get (summary, "a{s(ttttat)}", &iter);
+    while (g_variant_iter_loop (iter, "{&s(tttt@at)}", &name, &count, &total, &minimum, &maximum, &buckets))
+    {
+        const guint64 *values;
+        gsize n_values, i;
+
+        if (count == 0)
+            continue;
+
+        g_print ("%s%s: count=%" G_GUINT64_FORMAT " mean=%.1fms min=%.1fms max=%.1fms\n",
+                 indent, name, count,
+                 total / (count * 1000.0), minimum / 1000.0, maximum / 1000.0);
+
+        /* Bucket n counts durations below 2^n ms, the last bucket everything longer */
+        values = g_variant_get_fixed_array (buckets, &n_values, sizeof (guint64));
+        for (i = 0; i < n_values; i++)
+        {
+            if (values[i] == 0)
+                continue;
+            if (i == n_values - 1)
+                g_print ("%s  >= %lums: %" G_GUINT64_FORMAT "\n", indent, 1lu << (i - 1), values[i]);
+            else
+                g_print ("%s  < %lums: %" G_GUINT64_FORMAT "\n", indent, 1lu << i, values[i]);
+        }
+    }
+    g_variant_iter_free (iter);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -137,6 +173,8 @@ main (int argc, char **argv)
                         "  switch-to-guest [SESSION]                            Switch to a guest session\n"
                         "  lock                                                 Lock the current seat\n"
                         "  list-seats                                           List the active seats\n"
+                        "  stats                                                Show login latency statistics\n"
+                        "  trace                                                Dump recent events as Chrome trace JSON\n"
                         "  add-nested-seat [--fullscreen|--screen DIMENSIONS]   Start a nested display\n"
                         "  add-local-x-seat DISPLAY_NUMBER                      Add a local X seat\n"
                         "  add-seat TYPE [NAME=VALUE...]                        Add a dynamic seat\n");
@@ -387,6 +425,85 @@ main (int argc, char **argv)
 
         return EXIT_SUCCESS;
     }
+    else if (strcmp (command, "stats") == 0)
+    {
+        GVariant *summary, *seat_summaries;
+        GVariantIter *seat_iter;
+        const gchar *seat_name;
+
+        if (n_options != 0)
+        {
+            g_printerr ("Usage stats\n");
+            usage ();
+            return EXIT_FAILURE;
+        }
+
+        if (!g_dbus_proxy_get_name_owner (dm_proxy))
+        {
+            g_printerr ("Unable to contact display manager\n");
+            return EXIT_FAILURE;
+        }
+
+        summary = g_dbus_proxy_get_cached_property (dm_proxy, "LoginLatency");
+        seat_summaries = g_dbus_proxy_get_cached_property (dm_proxy, "SeatLoginLatency");
+        if (!summary || !seat_summaries)
+        {
+            g_printerr ("Display manager does not provide login statistics\n");
+            return EXIT_FAILURE;
+        }
+
+        g_print ("All seats\n");
+        print_latency (summary, "  ");
+        g_variant_unref (summary);
+
+        g_variant_get (seat_summaries, "a{sa{s(ttttat)}}", &seat_iter);
+        while (g_variant_iter_loop (seat_iter, "{&s@a{s(ttttat)}}", &seat_name, &summary))
+        {
+            g_print ("%s\n", seat_name);
+            print_latency (summary, "  ");
+        }
+        g_variant_iter_free (seat_iter);
+        g_variant_unref (seat_summaries);
+
+        return EXIT_SUCCESS;
+    }
+    else if (strcmp (command, "trace") == 0)
+    {
+        GVariant *result;
+        const gchar *trace;
+
+        if (n_options != 0)
+        {
+            g_printerr ("Usage trace\n");
+            usage ();
+            return EXIT_FAILURE;
+        }
+
+        result = g_dbus_proxy_call_sync (dm_proxy,
+                                         "GetTrace",
+                                         g_variant_new ("()"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1,
+                                         NULL,
+                                         &error);
+        if (!result)
+        {
+            g_printerr ("Unable to get trace: %s\n", error->message);
+            return EXIT_FAILURE;
+        }
+
+        if (!g_variant_is_of_type (result, G_VARIANT_TYPE ("(s)")))
+        {
+            g_printerr ("Unexpected response to GetTrace: %s\n", g_variant_get_type_string (result));
+            return EXIT_FAILURE;
+        }
+
+        g_variant_get (result, "(&s)", &trace);
+        g_print ("%s\n", trace);
+        g_variant_unref (result);
+
+        return EXIT_SUCCESS;
+    }
     else if (strcmp (command, "add-nested-seat") == 0)
     {
         gchar *path, *xephyr_command, **xephyr_argv;
@@ -65,6 +65,7 @@ greeter_session_start (Session *session)
     fcntl (from_greeter_output, F_SETFD, FD_CLOEXEC);
 
     /* Let the greeter session know how to communicate with the daemon */
+    session_set_inherit_fds (session, TRUE);
     value = g_strdup_printf ("%d", from_greeter_input);
     session_set_env (session, "LIGHTDM_TO_SERVER_FD", value);
     g_free (value);
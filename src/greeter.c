@@ -12,11 +12,15 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <gcrypt.h>
 
 #include "greeter.h"
 #include "configuration.h"
 #include "shared-data-manager.h"
+#include "trace.h"
 
 enum {
     PROP_ACTIVE_USERNAME = 1,
@@ -39,9 +43,14 @@ struct GreeterPrivate
 
     /* Buffer for data read from greeter */
     guint8 *read_buffer;
+    gsize read_buffer_size;
     gsize n_read;
     gboolean use_secure_memory;
 
+    /* Buffer reused to hold secrets while they are passed to PAM */
+    gchar *secret_buffer;
+    gsize secret_buffer_size;
+
     /* Hints for the greeter */
     GHashTable *hints;
 
@@ -75,12 +84,30 @@ struct GreeterPrivate
     /* TRUE if logging into guest session */
     gboolean guest_account_authenticated;
 
+    /* TRUE if the greeter has been stopped and its messages should be ignored */
+    gboolean stopped;
+
+    /* TRUE if the greeter has connected and the trace span for it is open */
+    gboolean connected;
+
+    /* Number of times the greeter has sent CONNECT */
+    guint n_connects;
+
     /* Communication channels to communicate with */
     int to_greeter_input;
     int from_greeter_output;
     GIOChannel *to_greeter_channel;
     GIOChannel *from_greeter_channel;
     guint from_greeter_watch;
+
+    /* Messages waiting to be sent to the greeter */
+    GByteArray *write_buffer;
+
+    /* Idle source to send queued messages */
+    guint flush_idle;
+
+    /* Watch for greeter to accept more data when the channel is full */
+    guint to_greeter_watch;
 };
 
 G_DEFINE_TYPE (Greeter, greeter, G_TYPE_OBJECT);
@@ -132,6 +159,7 @@ greeter_set_file_descriptors (Greeter *greeter, int to_greeter_fd, int from_gree
     g_return_if_fail (greeter->priv->from_greeter_output < 0);
 
     greeter->priv->to_greeter_input = to_greeter_fd;  
+    fcntl (greeter->priv->to_greeter_input, F_SETFL, fcntl (greeter->priv->to_greeter_input, F_GETFL) | O_NONBLOCK);
     greeter->priv->to_greeter_channel = g_io_channel_unix_new (greeter->priv->to_greeter_input);
     g_io_channel_set_encoding (greeter->priv->to_greeter_channel, NULL, &error);
     if (error)
@@ -151,6 +179,7 @@ void
 greeter_stop (Greeter *greeter)
 {
     /* Stop any events occurring after we've stopped */
+    greeter->priv->stopped = TRUE;
     if (greeter->priv->authentication_session)
         g_signal_handlers_disconnect_matched (greeter->priv->authentication_session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, greeter);
 }
@@ -220,52 +249,91 @@ int_length (void)
 }
 
 #define HEADER_SIZE (sizeof (guint32) * 2)
-#define MAX_MESSAGE_LENGTH 1024
 
-static void
-write_message (Greeter *greeter, guint8 *message, gsize message_length)
+/* Initial size of buffer to read messages into, grown for larger messages */
+#define READ_BUFFER_SIZE 1024
+
+/* Longest message accepted from the greeter, so it can't make us allocate without limit */
+#define MAX_MESSAGE_LENGTH 65536
+
+/* Write as much queued data as the greeter will take, returns TRUE if all sent */
+static gboolean
+flush_messages (Greeter *greeter)
 {
-    gchar *data;
-    gsize data_length;
-    GError *error = NULL;
+    GByteArray *buffer = greeter->priv->write_buffer;
+    gsize offset = 0;
 
-    data = (gchar *) message;
-    data_length = message_length;
-    while (data_length > 0)
+    while (offset < buffer->len)
     {
-        GIOStatus status;
-        gsize n_written;
-
-        status = g_io_channel_write_chars (greeter->priv->to_greeter_channel, data, data_length, &n_written, &error);
-        if (error)
-            g_warning ("Error writing to greeter: %s", error->message);
-        g_clear_error (&error);
-        if (status != G_IO_STATUS_NORMAL)
-            return;
-        data_length -= n_written;
-        data += n_written;
+        ssize_t n_written;
+
+        n_written = write (greeter->priv->to_greeter_input, buffer->data + offset, buffer->len - offset);
+        if (n_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            g_warning ("Error writing to greeter: %s", strerror (errno));
+            offset = buffer->len;
+            break;
+        }
+        offset += n_written;
     }
+    g_byte_array_remove_range (buffer, 0, offset);
 
-    g_io_channel_flush (greeter->priv->to_greeter_channel, &error);
-    if (error)
-        g_warning ("Failed to flush data to greeter: %s", error->message);
-    g_clear_error (&error);
+    return buffer->len == 0;
+}
+
+static gboolean
+write_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    Greeter *greeter = data;
+
+    if (!flush_messages (greeter))
+        return TRUE;
+
+    greeter->priv->to_greeter_watch = 0;
+    return FALSE;
+}
+
+static gboolean
+flush_idle_cb (gpointer data)
+{
+    Greeter *greeter = data;
+
+    greeter->priv->flush_idle = 0;
+
+    /* Wait until the greeter can take more if the channel is full */
+    if (!flush_messages (greeter))
+        greeter->priv->to_greeter_watch = g_io_add_watch (greeter->priv->to_greeter_channel, G_IO_OUT | G_IO_HUP | G_IO_ERR, write_cb, greeter);
+
+    return FALSE;
 }
 
 static void
-write_int (guint8 *buffer, gint buffer_length, guint32 value, gsize *offset)
+write_message (Greeter *greeter)
 {
-    if (*offset + 4 >= buffer_length)
-        return;
-    buffer[*offset] = value >> 24;
-    buffer[*offset+1] = (value >> 16) & 0xFF;
-    buffer[*offset+2] = (value >> 8) & 0xFF;
-    buffer[*offset+3] = value & 0xFF;
-    *offset += 4;
+    /* Messages are sent together once per main loop iteration */
+    if (greeter->priv->flush_idle == 0 && greeter->priv->to_greeter_watch == 0)
+        greeter->priv->flush_idle = g_idle_add_full (G_PRIORITY_DEFAULT, flush_idle_cb, greeter, NULL);
+}
+
+static void
+write_int (Greeter *greeter, guint32 value)
+{
+    guint8 buffer[4];
+
+    buffer[0] = value >> 24;
+    buffer[1] = (value >> 16) & 0xFF;
+    buffer[2] = (value >> 8) & 0xFF;
+    buffer[3] = value & 0xFF;
+    g_byte_array_append (greeter->priv->write_buffer, buffer, 4);
 }
 
 static void
-write_string (guint8 *buffer, gint buffer_length, const gchar *value, gsize *offset)
+write_string (Greeter *greeter, const gchar *value)
 {
     gint length;
 
@@ -273,21 +341,16 @@ write_string (guint8 *buffer, gint buffer_length, const gchar *value, gsize *off
         length = strlen (value);
     else
         length = 0;
-    write_int (buffer, buffer_length, length, offset);
-    if (*offset + length >= buffer_length)
-        return;
+    write_int (greeter, length);
     if (length > 0)
-    {
-        memcpy (buffer + *offset, value, length);
-        *offset += length;
-    }
+        g_byte_array_append (greeter->priv->write_buffer, (const guint8 *) value, length);
 }
 
 static void
-write_header (guint8 *buffer, gint buffer_length, guint32 id, guint32 length, gsize *offset)
+write_header (Greeter *greeter, guint32 id, guint32 length)
 {
-    write_int (buffer, buffer_length, id, offset);
-    write_int (buffer, buffer_length, length, offset);
+    write_int (greeter, id);
+    write_int (greeter, length);
 }
 
 static guint32
@@ -302,8 +365,6 @@ string_length (const gchar *value)
 static void
 handle_connect (Greeter *greeter, const gchar *version, gboolean resettable, guint32 api_version)
 {
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
     guint32 env_length = 0;
     GHashTableIter iter;
     gpointer key, value;
@@ -319,30 +380,36 @@ handle_connect (Greeter *greeter, const gchar *version, gboolean resettable, gui
 
     if (api_version == 0)
     {
-        write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_CONNECTED, string_length (VERSION) + env_length, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, VERSION, &offset);
+        write_header (greeter, SERVER_MESSAGE_CONNECTED, string_length (VERSION) + env_length);
+        write_string (greeter, VERSION);
         g_hash_table_iter_init (&iter, greeter->priv->hints);
         while (g_hash_table_iter_next (&iter, &key, &value))
         {
-            write_string (message, MAX_MESSAGE_LENGTH, key, &offset);
-            write_string (message, MAX_MESSAGE_LENGTH, value, &offset);
+            write_string (greeter, key);
+            write_string (greeter, value);
         }
     }
     else
     {
-        write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_CONNECTED_V2, string_length (VERSION) + int_length () * 2 + env_length, &offset);
-        write_int (message, MAX_MESSAGE_LENGTH, api_version <= API_VERSION ? api_version : API_VERSION, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, VERSION, &offset);
-        write_int (message, MAX_MESSAGE_LENGTH, g_hash_table_size (greeter->priv->hints), &offset);
+        write_header (greeter, SERVER_MESSAGE_CONNECTED_V2, string_length (VERSION) + int_length () * 2 + env_length);
+        write_int (greeter, api_version <= API_VERSION ? api_version : API_VERSION);
+        write_string (greeter, VERSION);
+        write_int (greeter, g_hash_table_size (greeter->priv->hints));
         g_hash_table_iter_init (&iter, greeter->priv->hints);
         while (g_hash_table_iter_next (&iter, &key, &value))
         {
-            write_string (message, MAX_MESSAGE_LENGTH, key, &offset);
-            write_string (message, MAX_MESSAGE_LENGTH, value, &offset);
+            write_string (greeter, key);
+            write_string (greeter, value);
         }
     }
-    write_message (greeter, message, offset);
+    write_message (greeter);
 
+    if (!greeter->priv->connected)
+    {
+        greeter->priv->connected = TRUE;
+        trace_begin (greeter, "connected", NULL);
+    }
+    greeter->priv->n_connects++;
     g_signal_emit (greeter, signals[CONNECTED], 0);
 }
 
@@ -351,10 +418,8 @@ pam_messages_cb (Session *session, Greeter *greeter)
 {
     int i;
     guint32 size;
-    guint8 message[MAX_MESSAGE_LENGTH];
     const struct pam_message *messages;
     int messages_length;
-    gsize offset = 0;
     int n_prompts = 0;
 
     messages = session_get_messages (session);
@@ -366,19 +431,19 @@ pam_messages_cb (Session *session, Greeter *greeter)
     for (i = 0; i < messages_length; i++)
         size += int_length () + string_length (messages[i].msg);
 
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_PROMPT_AUTHENTICATION, size, &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, greeter->priv->authentication_sequence_number, &offset);
-    write_string (message, MAX_MESSAGE_LENGTH, session_get_username (session), &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, messages_length, &offset);
+    write_header (greeter, SERVER_MESSAGE_PROMPT_AUTHENTICATION, size);
+    write_int (greeter, greeter->priv->authentication_sequence_number);
+    write_string (greeter, session_get_username (session));
+    write_int (greeter, messages_length);
     for (i = 0; i < messages_length; i++)
     {
-        write_int (message, MAX_MESSAGE_LENGTH, messages[i].msg_style, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, messages[i].msg, &offset);
+        write_int (greeter, messages[i].msg_style);
+        write_string (greeter, messages[i].msg);
 
         if (messages[i].msg_style == PAM_PROMPT_ECHO_OFF || messages[i].msg_style == PAM_PROMPT_ECHO_ON)
             n_prompts++;
     }
-    write_message (greeter, message, offset);
+    write_message (greeter);
 
     /* Continue immediately if nothing to respond with */
     // FIXME: Should probably give the greeter a chance to ack the message
@@ -394,31 +459,23 @@ pam_messages_cb (Session *session, Greeter *greeter)
 static void
 send_end_authentication (Greeter *greeter, guint32 sequence_number, const gchar *username, int result)
 {
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_END_AUTHENTICATION, int_length () + string_length (username) + int_length (), &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, sequence_number, &offset);
-    write_string (message, MAX_MESSAGE_LENGTH, username, &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, result, &offset);
-    write_message (greeter, message, offset);
+    write_header (greeter, SERVER_MESSAGE_END_AUTHENTICATION, int_length () + string_length (username) + int_length ());
+    write_int (greeter, sequence_number);
+    write_string (greeter, username);
+    write_int (greeter, result);
+    write_message (greeter);
 }
 
 void
 greeter_idle (Greeter *greeter)
 {
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_IDLE, 0, &offset);
-    write_message (greeter, message, offset);
+    write_header (greeter, SERVER_MESSAGE_IDLE, 0);
+    write_message (greeter);
 }
 
 void
 greeter_reset (Greeter *greeter)
 {
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
     guint32 length = 0;
     GHashTableIter iter;
     gpointer key, value;
@@ -429,14 +486,14 @@ greeter_reset (Greeter *greeter)
     while (g_hash_table_iter_next (&iter, &key, &value))
         length += string_length (key) + string_length (value);
 
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_RESET, length, &offset);
+    write_header (greeter, SERVER_MESSAGE_RESET, length);
     g_hash_table_iter_init (&iter, greeter->priv->hints);
     while (g_hash_table_iter_next (&iter, &key, &value))
     {
-        write_string (message, MAX_MESSAGE_LENGTH, key, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, value, &offset);
+        write_string (greeter, key);
+        write_string (greeter, value);
     }
-    write_message (greeter, message, offset);
+    write_message (greeter);
 }
 
 static void
@@ -660,24 +717,20 @@ handle_continue_authentication (Greeter *greeter, gchar **secrets)
 
     g_debug ("Continue authentication");
 
-    /* Build response */
+    /* Build response, the secrets are copied when sent so no need to duplicate them */
     response = calloc (messages_length, sizeof (struct pam_response));
     for (i = 0, j = 0; i < messages_length; i++)
     {
         int msg_style = messages[i].msg_style;
         if (msg_style == PAM_PROMPT_ECHO_OFF || msg_style == PAM_PROMPT_ECHO_ON)
         {
-            size_t secret_length = strlen (secrets[j]) + 1;
-            response[i].resp = secure_malloc (greeter, secret_length);
-            memcpy (response[i].resp, secrets[j], secret_length); // FIXME: Need to convert from UTF-8
+            response[i].resp = secrets[j]; // FIXME: Need to convert from UTF-8
             j++;
         }
     }
 
     session_respond (greeter->priv->authentication_session, response);
 
-    for (i = 0; i < messages_length; i++)
-        secure_free (greeter, response[i].resp);
     free (response);
 }
 
@@ -696,8 +749,6 @@ static void
 handle_start_session (Greeter *greeter, const gchar *session)
 {
     gboolean result;
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
     SessionType session_type = SESSION_TYPE_LOCAL;
 
     if (strcmp (session, "") == 0)
@@ -725,9 +776,9 @@ handle_start_session (Greeter *greeter, const gchar *session)
         result = FALSE;
     }
 
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_SESSION_RESULT, int_length (), &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, result ? 0 : 1, &offset);
-    write_message (greeter, message, offset);
+    write_header (greeter, SERVER_MESSAGE_SESSION_RESULT, int_length ());
+    write_int (greeter, result ? 0 : 1);
+    write_message (greeter);
 }
 
 static void
@@ -757,220 +808,182 @@ static void
 handle_ensure_shared_dir (Greeter *greeter, const gchar *username)
 {
     gchar *dir;
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
 
     g_debug ("Greeter requests data directory for user %s", username);
 
     dir = shared_data_manager_ensure_user_dir (shared_data_manager_get_instance (), username);
 
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_SHARED_DIR_RESULT, string_length (dir), &offset);
-    write_string (message, MAX_MESSAGE_LENGTH, dir, &offset);
-    write_message (greeter, message, offset);
+    write_header (greeter, SERVER_MESSAGE_SHARED_DIR_RESULT, string_length (dir));
+    write_string (greeter, dir);
+    write_message (greeter);
 
     g_free (dir);
 }
 
 static guint32
-read_int (Greeter *greeter, gsize *offset)
+read_int (const guint8 *message, gsize message_length, gsize *offset)
 {
     guint32 value;
-    guint8 *buffer;
-    if (greeter->priv->n_read - *offset < sizeof (guint32))
+    const guint8 *buffer;
+    if (message_length - *offset < sizeof (guint32))
     {
-        g_warning ("Not enough space for int, need %zu, got %zu", sizeof (guint32), greeter->priv->n_read - *offset);
+        g_warning ("Not enough space for int, need %zu, got %zu", sizeof (guint32), message_length - *offset);
         return 0;
     }
-    buffer = greeter->priv->read_buffer + *offset;
+    buffer = message + *offset;
     value = buffer[0] << 24 | buffer[1] << 16 | buffer[2] << 8 | buffer[3];
     *offset += int_length ();
     return value;
 }
 
-static int
-get_message_length (Greeter *greeter)
+/* Get the length of the message starting with this header or 0 if not valid */
+static gsize
+get_message_length (const guint8 *header)
 {
     gsize offset;
-    int payload_length;
+    guint32 payload_length;
 
     offset = int_length ();
-    payload_length = read_int (greeter, &offset);
+    payload_length = read_int (header, HEADER_SIZE, &offset);
 
-    if (HEADER_SIZE + payload_length < HEADER_SIZE)
+    if (payload_length > MAX_MESSAGE_LENGTH - HEADER_SIZE)
     {
         g_warning ("Payload length of %u octets too long", payload_length);
-        return HEADER_SIZE;
+        return 0;
     }
 
     return HEADER_SIZE + payload_length;
 }
 
 static gchar *
-read_string_full (Greeter *greeter, gsize *offset, void* (*alloc_fn)(size_t n))
+read_string (const guint8 *message, gsize message_length, gsize *offset)
 {
     guint32 length;
     gchar *value;
 
-    length = read_int (greeter, offset);
-    if (greeter->priv->n_read - *offset < length)
+    length = read_int (message, message_length, offset);
+    if (message_length - *offset < length)
     {
-        g_warning ("Not enough space for string, need %u, got %zu", length, greeter->priv->n_read - *offset);
+        g_warning ("Not enough space for string, need %u, got %zu", length, message_length - *offset);
         return g_strdup ("");
     }
 
-    value = (*alloc_fn) (sizeof (gchar) * (length + 1));
-    memcpy (value, greeter->priv->read_buffer + *offset, length);
+    value = g_malloc (sizeof (gchar) * (length + 1));
+    memcpy (value, message + *offset, length);
     value[length] = '\0';
     *offset += length;
 
     return value;
 }
 
+/* Read a secret into the secret buffer, which must be at least as long as the message */
 static gchar *
-read_string (Greeter *greeter, gsize *offset)
+read_secret (Greeter *greeter, const guint8 *message, gsize message_length, gsize *offset, gsize *secret_offset)
 {
-    return read_string_full (greeter, offset, g_malloc);
-}
+    guint32 length;
+    gchar *value;
 
-static gchar *
-read_secret (Greeter *greeter, gsize *offset)
-{
-    if (greeter->priv->use_secure_memory)
-        return read_string_full (greeter, offset, gcry_malloc_secure);
-    else
-        return read_string_full (greeter, offset, g_malloc);
+    value = greeter->priv->secret_buffer + *secret_offset;
+    length = read_int (message, message_length, offset);
+    if (message_length - *offset < length)
+    {
+        g_warning ("Not enough space for string, need %u, got %zu", length, message_length - *offset);
+        length = 0;
+    }
+
+    memcpy (value, message + *offset, length);
+    value[length] = '\0';
+    *offset += length;
+    *secret_offset += length + 1;
+
+    return value;
 }
 
+/* Returns FALSE if the greeter broke the protocol and should not be read from again */
 static gboolean
-read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+handle_message (Greeter *greeter, const guint8 *message, gsize length)
 {
-    Greeter *greeter = data;
-    gsize n_to_read, n_read, offset;
-    GIOStatus status;
-    int id, length, i;
+    gsize offset, secret_offset;
+    int id, i;
     guint32 sequence_number, n_secrets, max_secrets;
     gchar *version, *username, *session_name, *language;
     gchar **secrets;
     gboolean resettable = FALSE;
     guint32 api_version = 0;
-    GError *error = NULL;
-
-    if (condition == G_IO_HUP)
-    {
-        g_debug ("Greeter closed communication channel");
-        greeter->priv->from_greeter_watch = 0;
-        g_signal_emit (greeter, signals[DISCONNECTED], 0);
-        return FALSE;
-    }
-
-    n_to_read = HEADER_SIZE;
-    if (greeter->priv->n_read >= HEADER_SIZE)
-    {
-        n_to_read = get_message_length (greeter);
-        if (n_to_read <= HEADER_SIZE)
-        {
-            greeter->priv->from_greeter_watch = 0;
-            return FALSE;
-        }
-    }
-
-    status = g_io_channel_read_chars (greeter->priv->from_greeter_channel,
-                                      (gchar *) greeter->priv->read_buffer + greeter->priv->n_read,
-                                      n_to_read - greeter->priv->n_read,
-                                      &n_read,
-                                      &error);
-    if (error)
-        g_warning ("Error reading from greeter: %s", error->message);
-    g_clear_error (&error);
-    if (status == G_IO_STATUS_EOF)
-    {
-        g_debug ("Greeter closed communication channel");
-        greeter->priv->from_greeter_watch = 0;
-        g_signal_emit (greeter, signals[DISCONNECTED], 0);
-        return FALSE;
-    }
-    else if (status != G_IO_STATUS_NORMAL)
-        return TRUE;
-
-    greeter->priv->n_read += n_read;
-    if (greeter->priv->n_read != n_to_read)
-        return TRUE;
-
-    /* If have header, rerun for content */
-    if (greeter->priv->n_read == HEADER_SIZE)
-    {
-        n_to_read = get_message_length (greeter);
-        if (n_to_read > HEADER_SIZE)
-        {
-            greeter->priv->read_buffer = secure_realloc (greeter, greeter->priv->read_buffer, n_to_read);
-            read_cb (source, condition, greeter);
-            return TRUE;
-        }
-    }
 
     offset = 0;
-    id = read_int (greeter, &offset);
-    length = HEADER_SIZE + read_int (greeter, &offset);
+    id = read_int (message, length, &offset);
+    /* Skip payload length, already checked */
+    read_int (message, length, &offset);
     switch (id)
     {
     case GREETER_MESSAGE_CONNECT:
-        version = read_string (greeter, &offset);
+        version = read_string (message, length, &offset);
         if (offset < length)
-            resettable = read_int (greeter, &offset) != 0;
+            resettable = read_int (message, length, &offset) != 0;
         if (offset < length)
-            api_version = read_int (greeter, &offset);
+            api_version = read_int (message, length, &offset);
         handle_connect (greeter, version, resettable, api_version);
         g_free (version);
         break;
     case GREETER_MESSAGE_AUTHENTICATE:
-        sequence_number = read_int (greeter, &offset);
-        username = read_string (greeter, &offset);
+        sequence_number = read_int (message, length, &offset);
+        username = read_string (message, length, &offset);
         handle_authenticate (greeter, sequence_number, username);
         g_free (username);
         break;
     case GREETER_MESSAGE_AUTHENTICATE_AS_GUEST:
-        sequence_number = read_int (greeter, &offset);
+        sequence_number = read_int (message, length, &offset);
         handle_authenticate_as_guest (greeter, sequence_number);
         break;
     case GREETER_MESSAGE_AUTHENTICATE_REMOTE:
-        sequence_number = read_int (greeter, &offset);
-        session_name = read_string (greeter, &offset);
-        username = read_string (greeter, &offset);
+        sequence_number = read_int (message, length, &offset);
+        session_name = read_string (message, length, &offset);
+        username = read_string (message, length, &offset);
         handle_authenticate_remote (greeter, session_name, username, sequence_number);
         break;
     case GREETER_MESSAGE_CONTINUE_AUTHENTICATION:
-        n_secrets = read_int (greeter, &offset);
-        max_secrets = (G_MAXUINT32 - 1) / sizeof (gchar *);
+        n_secrets = read_int (message, length, &offset);
+        /* Each secret has at least a length field */
+        max_secrets = (length - offset) / int_length ();
         if (n_secrets > max_secrets)
         {
             g_warning ("Array length of %u elements too long", n_secrets);
-            greeter->priv->from_greeter_watch = 0;
             return FALSE;
         }
+
+        /* Secrets are never longer than the message they come in */
+        if (greeter->priv->secret_buffer_size < length)
+        {
+            secure_free (greeter, greeter->priv->secret_buffer);
+            greeter->priv->secret_buffer = secure_malloc (greeter, length);
+            greeter->priv->secret_buffer_size = length;
+        }
+
         secrets = g_malloc (sizeof (gchar *) * (n_secrets + 1));
+        secret_offset = 0;
         for (i = 0; i < n_secrets; i++)
-            secrets[i] = read_secret (greeter, &offset);
+            secrets[i] = read_secret (greeter, message, length, &offset, &secret_offset);
         secrets[i] = NULL;
         handle_continue_authentication (greeter, secrets);
-        for (i = 0; i < n_secrets; i++)
-            secure_free (greeter, secrets[i]);
+        memset (greeter->priv->secret_buffer, 0, secret_offset);
         g_free (secrets);
         break;
     case GREETER_MESSAGE_CANCEL_AUTHENTICATION:
         handle_cancel_authentication (greeter);
         break;
     case GREETER_MESSAGE_START_SESSION:
-        session_name = read_string (greeter, &offset);
+        session_name = read_string (message, length, &offset);
         handle_start_session (greeter, session_name);
         g_free (session_name);
         break;
     case GREETER_MESSAGE_SET_LANGUAGE:
-        language = read_string (greeter, &offset);
+        language = read_string (message, length, &offset);
         handle_set_language (greeter, language);
         g_free (language);
         break;
     case GREETER_MESSAGE_ENSURE_SHARED_DIR:
-        username = read_string (greeter, &offset);
+        username = read_string (message, length, &offset);
         handle_ensure_shared_dir (greeter, username);
         g_free (username);
         break;
@@ -979,11 +992,132 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
         break;
     }
 
-    greeter->priv->n_read = 0;
-
     return TRUE;
 }
 
+/* Close the trace span for the connection, if the greeter ever connected */
+static void
+end_connected_trace (Greeter *greeter)
+{
+    if (!greeter->priv->connected)
+        return;
+    greeter->priv->connected = FALSE;
+    trace_end (greeter, "connected", NULL);
+}
+
+static gboolean
+read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    Greeter *greeter = data;
+    gsize offset, length = 0;
+    ssize_t n_read;
+    gboolean result = TRUE;
+
+    if (condition == G_IO_HUP)
+    {
+        g_debug ("Greeter closed communication channel");
+        greeter->priv->from_greeter_watch = 0;
+        end_connected_trace (greeter);
+        g_signal_emit (greeter, signals[DISCONNECTED], 0);
+        return FALSE;
+    }
+
+    if (greeter->priv->stopped)
+    {
+        greeter->priv->from_greeter_watch = 0;
+        return FALSE;
+    }
+
+    /* Grow the buffer if it is full of an incomplete message */
+    if (greeter->priv->n_read == greeter->priv->read_buffer_size)
+    {
+        greeter->priv->read_buffer_size *= 2;
+        greeter->priv->read_buffer = secure_realloc (greeter, greeter->priv->read_buffer, greeter->priv->read_buffer_size);
+    }
+
+    /* Read everything available that fits */
+    n_read = read (greeter->priv->from_greeter_output,
+                   greeter->priv->read_buffer + greeter->priv->n_read,
+                   greeter->priv->read_buffer_size - greeter->priv->n_read);
+    if (n_read < 0)
+    {
+        if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+            g_warning ("Error reading from greeter: %s", strerror (errno));
+        return TRUE;
+    }
+    if (n_read == 0)
+    {
+        g_debug ("Greeter closed communication channel");
+        greeter->priv->from_greeter_watch = 0;
+        end_connected_trace (greeter);
+        g_signal_emit (greeter, signals[DISCONNECTED], 0);
+        return FALSE;
+    }
+    greeter->priv->n_read += n_read;
+
+    /* Handle all the complete messages we have, the handlers may drop the last reference to us */
+    g_object_ref (greeter);
+    offset = 0;
+    while (greeter->priv->n_read - offset >= HEADER_SIZE)
+    {
+        length = get_message_length (greeter->priv->read_buffer + offset);
+        if (length == 0)
+        {
+            result = FALSE;
+            break;
+        }
+
+        /* Wait for the rest of the message */
+        if (greeter->priv->n_read - offset < length)
+            break;
+
+        if (!handle_message (greeter, greeter->priv->read_buffer + offset, length))
+        {
+            result = FALSE;
+            break;
+        }
+        offset += length;
+        length = 0;
+
+        /* Ignore the rest if the greeter was stopped while handling the message */
+        if (greeter->priv->stopped)
+        {
+            greeter->priv->from_greeter_watch = 0;
+            g_object_unref (greeter);
+            return FALSE;
+        }
+    }
+    if (!result)
+    {
+        /* Drop a greeter that breaks the protocol */
+        g_warning ("Closing connection to greeter after invalid message");
+        greeter->priv->from_greeter_watch = 0;
+        close (greeter->priv->from_greeter_output);
+        greeter->priv->from_greeter_output = -1;
+        length = 0;
+        end_connected_trace (greeter);
+        g_signal_emit (greeter, signals[DISCONNECTED], 0);
+    }
+
+    /* Move any partial message to the start and clear what was used */
+    if (offset > 0)
+    {
+        memmove (greeter->priv->read_buffer, greeter->priv->read_buffer + offset, greeter->priv->n_read - offset);
+        greeter->priv->n_read -= offset;
+        memset (greeter->priv->read_buffer + greeter->priv->n_read, 0, offset);
+    }
+
+    /* Make space for the whole of a partial message */
+    if (length > greeter->priv->read_buffer_size)
+    {
+        greeter->priv->read_buffer_size = length;
+        greeter->priv->read_buffer = secure_realloc (greeter, greeter->priv->read_buffer, greeter->priv->read_buffer_size);
+    }
+    g_object_unref (greeter);
+
+    return result;
+}
+
 gboolean
 greeter_get_guest_authenticated (Greeter *greeter)
 {
@@ -1027,6 +1161,13 @@ greeter_get_active_username (Greeter *greeter)
     return greeter->priv->active_username;
 }
 
+guint
+greeter_get_n_connects (Greeter *greeter)
+{
+    g_return_val_if_fail (greeter != NULL, 0);
+    return greeter->priv->n_connects;
+}
+
 static Session *
 greeter_real_create_session (Greeter *greeter)
 {
@@ -1043,7 +1184,9 @@ static void
 greeter_init (Greeter *greeter)
 {
     greeter->priv = G_TYPE_INSTANCE_GET_PRIVATE (greeter, GREETER_TYPE, GreeterPrivate);
-    greeter->priv->read_buffer = secure_malloc (greeter, HEADER_SIZE);
+    greeter->priv->read_buffer_size = READ_BUFFER_SIZE;
+    greeter->priv->read_buffer = secure_malloc (greeter, greeter->priv->read_buffer_size);
+    greeter->priv->write_buffer = g_byte_array_new ();
     greeter->priv->hints = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
     greeter->priv->use_secure_memory = config_get_boolean (config_get_instance (), "LightDM", "lock-memory");
     greeter->priv->to_greeter_input = -1;
@@ -1058,6 +1201,7 @@ greeter_finalize (GObject *object)
     g_free (self->priv->pam_service);
     g_free (self->priv->autologin_pam_service);
     secure_free (self, self->priv->read_buffer);
+    secure_free (self, self->priv->secret_buffer);
     g_hash_table_unref (self->priv->hints);
     g_free (self->priv->remote_session);
     g_free (self->priv->active_username);
@@ -1066,6 +1210,14 @@ greeter_finalize (GObject *object)
         g_signal_handlers_disconnect_matched (self->priv->authentication_session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
         g_object_unref (self->priv->authentication_session);
     }
+    if (self->priv->flush_idle)
+        g_source_remove (self->priv->flush_idle);
+    if (self->priv->to_greeter_watch)
+        g_source_remove (self->priv->to_greeter_watch);
+    /* Send anything still queued if the greeter will take it */
+    if (self->priv->to_greeter_input >= 0)
+        flush_messages (self);
+    g_byte_array_unref (self->priv->write_buffer);
     close (self->priv->to_greeter_input);
     close (self->priv->from_greeter_output);
     if (self->priv->to_greeter_channel)
@@ -79,6 +79,8 @@ gboolean greeter_get_resettable (Greeter *greeter);
 
 const gchar *greeter_get_active_username (Greeter *greeter);
 
+guint greeter_get_n_connects (Greeter *greeter);
+
 G_END_DECLS
 
 #endif /* GREETER_H_ */
@@ -30,13 +30,22 @@
 #include "seat-xvnc.h"
 #include "x-server.h"
 #include "process.h"
+#include "session.h"
 #include "session-child.h"
 #include "shared-data-manager.h"
 #include "user-list.h"
 #include "login1.h"
 #include "log-file.h"
+#include "log-writer.h"
+#include "trace.h"
 
 static gchar *config_path = NULL;
+static gchar *option_log_dir = NULL;
+static gchar *option_run_dir = NULL;
+static gchar *option_cache_dir = NULL;
+static gchar *default_log_dir = NULL;
+static gchar *default_run_dir = NULL;
+static gchar *default_cache_dir = NULL;
 static GMainLoop *loop = NULL;
 static GTimer *log_timer;
 static int log_fd = -1;
@@ -48,57 +57,80 @@ static XDMCPServer *xdmcp_server = NULL;
 static VNCServer *vnc_server = NULL;
 static gint exit_code = EXIT_SUCCESS;
 
+/* Resolved seat configuration, keyed by seat name ("" for seats without a name) */
+static GHashTable *seat_properties = NULL;
+
 static gboolean update_login1_seat (Login1Seat *login1_seat);
+static void reload_config (void);
+static void set_config_defaults (Configuration *config);
 
-static void
-log_cb (const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer data)
+static const gchar *
+get_log_level_prefix (GLogLevelFlags log_level)
 {
-    const gchar *prefix;
-    gchar *text;
-
     switch (log_level & G_LOG_LEVEL_MASK)
     {
     case G_LOG_LEVEL_ERROR:
-        prefix = "ERROR:";
-        break;
+        return "ERROR:";
     case G_LOG_LEVEL_CRITICAL:
-        prefix = "CRITICAL:";
-        break;
+        return "CRITICAL:";
     case G_LOG_LEVEL_WARNING:
-        prefix = "WARNING:";
-        break;
+        return "WARNING:";
     case G_LOG_LEVEL_MESSAGE:
-        prefix = "MESSAGE:";
-        break;
+        return "MESSAGE:";
     case G_LOG_LEVEL_INFO:
-        prefix = "INFO:";
-        break;
+        return "INFO:";
     case G_LOG_LEVEL_DEBUG:
-        prefix = "DEBUG:";
-        break;
+        return "DEBUG:";
     default:
-        prefix = "LOG:";
-        break;
+        return "LOG:";
     }
+}
 
-    text = g_strdup_printf ("[%+.2fs] %s %s\n", g_timer_elapsed (log_timer, NULL), prefix, message);
+static void
+log_cb (const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer data)
+{
+    const gchar *prefix;
+    gchar buf[1024], *text = buf;
+    gint length;
+
+    prefix = get_log_level_prefix (log_level);
 
-    /* Log everything to a file */
-    if (log_fd >= 0)
+    /* Log everything to a file (and stderr if debugging) from the writer thread */
+    if (log_writer_get_is_running ())
     {
-        ssize_t n_written;
-        n_written = write (log_fd, text, strlen (text));
-        if (n_written < 0)
-            ; /* Check result so compiler doesn't warn about it */
-    }
+        log_writer_write (g_timer_elapsed (log_timer, NULL), prefix, message);
 
-    /* Log to stderr if requested */
-    if (debug)
-        g_printerr ("%s", text);
+        /* Make sure fatal errors are written out before we abort */
+        if (log_level & G_LOG_FLAG_FATAL)
+            log_writer_flush ();
+    }
     else
-        g_log_default_handler (log_domain, log_level, message, data);
+    {
+        /* Format into the buffer, only allocating for long messages */
+        length = g_snprintf (buf, sizeof (buf), "[%+.2fs] %s %s\n", g_timer_elapsed (log_timer, NULL), prefix, message);
+        if (length >= (gint) sizeof (buf))
+            text = g_strdup_printf ("[%+.2fs] %s %s\n", g_timer_elapsed (log_timer, NULL), prefix, message);
+        length = strlen (text);
+
+        /* Log everything to a file */
+        if (log_fd >= 0)
+        {
+            ssize_t n_written;
+            n_written = write (log_fd, text, length);
+            if (n_written < 0)
+                ; /* Check result so compiler doesn't warn about it */
+        }
+
+        /* Log to stderr if requested */
+        if (debug)
+            g_printerr ("%s", text);
+
+        if (text != buf)
+            g_free (text);
+    }
 
-    g_free (text);
+    if (!debug)
+        g_log_default_handler (log_domain, log_level, message, data);
 }
 
 static void
@@ -117,6 +149,21 @@ log_init (void)
     backup_logs = config_get_boolean (config_get_instance (), "LightDM", "backup-logs");
     log_fd = log_file_open (path, backup_logs ? LOG_MODE_BACKUP_AND_TRUNCATE : LOG_MODE_APPEND);
     fcntl (log_fd, F_SETFD, FD_CLOEXEC);
+
+    /* Optionally write the log from a separate thread so logging doesn't block the main loop */
+    if (config_get_boolean (config_get_instance (), "LightDM", "async-logging"))
+    {
+        int fds[2];
+        gsize n_fds = 0;
+
+        if (log_fd >= 0)
+            fds[n_fds++] = log_fd;
+        if (debug)
+            fds[n_fds++] = STDERR_FILENO;
+        if (n_fds > 0)
+            log_writer_start (fds, n_fds, MAX (config_get_integer (config_get_instance (), "LightDM", "async-logging-buffer-size"), 1));
+    }
+
     g_log_set_default_handler (log_cb, NULL);
 
     g_debug ("Logging to %s", path);
@@ -147,29 +194,51 @@ get_config_sections (const gchar *seat_name)
     return config_sections;
 }
 
-static void
-set_seat_properties (Seat *seat, const gchar *seat_name)
+static SeatProperties *
+load_seat_properties (const gchar *seat_name)
 {
+    SeatProperties *properties;
     GList *sections, *link;
     gchar **keys;
     gint i;
 
+    properties = seat_properties_new ();
     sections = get_config_sections (seat_name);
     for (link = sections; link; link = link->next)
     {
         const gchar *section = link->data;
         keys = config_get_keys (config_get_instance (), section);
 
-        l_debug (seat, "Loading properties from config section %s", section);
+        g_debug ("Loading properties from config section %s", section);
         for (i = 0; keys && keys[i]; i++)
         {
             gchar *value = config_get_string (config_get_instance (), section, keys[i]);
-            seat_set_property (seat, keys[i], value);
+            seat_properties_set (properties, keys[i], value);
             g_free (value);
         }
         g_strfreev (keys);
     }
     g_list_free_full (sections, g_free);
+
+    return properties;
+}
+
+static void
+set_seat_properties (Seat *seat, const gchar *seat_name)
+{
+    SeatProperties *properties;
+
+    /* Resolve the config sections once for each seat name and share the result between seats */
+    if (!seat_properties)
+        seat_properties = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) seat_properties_unref);
+    properties = g_hash_table_lookup (seat_properties, seat_name ? seat_name : "");
+    if (!properties)
+    {
+        properties = load_seat_properties (seat_name);
+        g_hash_table_insert (seat_properties, g_strdup (seat_name ? seat_name : ""), properties);
+    }
+
+    seat_set_properties (seat, properties);
 }
 
 static void
@@ -183,9 +252,11 @@ signal_cb (Process *process, int signum)
         display_manager_stop (display_manager);
         // FIXME: Stop XDMCP server
         break;
+    case SIGHUP:
+        reload_config ();
+        break;
     case SIGUSR1:
     case SIGUSR2:
-    case SIGHUP:
         break;
     }
 }
@@ -234,6 +305,23 @@ service_add_xlocal_seat_cb (DisplayManagerService *service, gint display_number)
     return seat;
 }
 
+/* Let the XDMCP server know how busy we are so it can report load to terminals */
+static void
+update_xdmcp_sessions (void)
+{
+    GList *link;
+    guint n_sessions = 0;
+
+    if (!xdmcp_server)
+        return;
+
+    /* Count every XDMCP seat, a display at the greeter or still stopping uses the host as much as a running session */
+    for (link = display_manager_get_seats (display_manager); link; link = link->next)
+        if (IS_SEAT_XDMCP_SESSION (link->data))
+            n_sessions++;
+    xdmcp_server_set_n_sessions (xdmcp_server, n_sessions);
+}
+
 static void
 display_manager_seat_removed_cb (DisplayManager *display_manager, Seat *seat)
 {
@@ -242,9 +330,12 @@ display_manager_seat_removed_cb (DisplayManager *display_manager, Seat *seat)
     Seat *next_seat = NULL;
     GString *next_types;
 
+    if (IS_SEAT_XDMCP_SESSION (seat))
+        update_xdmcp_sessions ();
+
     /* If we have fallback types registered for the seat, let's try them
        before giving up. */
-    types = seat_get_string_list_property (seat, "type");
+    types = seat_get_string_list (seat, SEAT_PROPERTY_TYPE);
     next_types = g_string_new ("");
     for (iter = types; iter && *iter; iter++)
     {
@@ -270,7 +361,7 @@ display_manager_seat_removed_cb (DisplayManager *display_manager, Seat *seat)
         set_seat_properties (next_seat, seat_get_name (seat));
 
         // We set this manually on default seat.  Let's port it over if needed.
-        if (seat_get_boolean_property (seat, "exit-on-failure"))
+        if (seat_get_boolean (seat, SEAT_PROPERTY_EXIT_ON_FAILURE))
             seat_set_property (next_seat, "exit-on-failure", "true");
 
         seat_set_property (next_seat, "type", next_types->str);
@@ -278,7 +369,7 @@ display_manager_seat_removed_cb (DisplayManager *display_manager, Seat *seat)
         display_manager_add_seat (display_manager, next_seat);
         g_object_unref (next_seat);
     }
-    else if (seat_get_boolean_property (seat, "exit-on-failure"))
+    else if (seat_get_boolean (seat, SEAT_PROPERTY_EXIT_ON_FAILURE))
     {
         g_debug ("Required seat has stopped");
         exit_code = EXIT_FAILURE;
@@ -298,6 +389,7 @@ xdmcp_session_cb (XDMCPServer *server, XDMCPSession *session)
     set_seat_properties (SEAT (seat), NULL);
     result = display_manager_add_seat (display_manager, SEAT (seat));
     g_object_unref (seat);
+    update_xdmcp_sessions ();
 
     return result;
 }
@@ -313,114 +405,252 @@ vnc_connection_cb (VNCServer *server, GSocket *connection)
     g_object_unref (seat);
 }
 
-static void
-start_display_manager (void)
+static gchar *
+load_xdmcp_key (const gchar *key_name)
 {
-    display_manager_start (display_manager);
+    gchar *path, *key = NULL;
+    GKeyFile *keys;
+    gboolean result;
+    GError *error = NULL;
 
-    /* Start the XDMCP server */
-    if (config_get_boolean (config_get_instance (), "XDMCPServer", "enabled"))
+    path = g_build_filename (config_get_directory (config_get_instance ()), "keys.conf", NULL);
+
+    keys = g_key_file_new ();
+    result = g_key_file_load_from_file (keys, path, G_KEY_FILE_NONE, &error);
+    if (error)
+        g_warning ("Unable to load keys from %s: %s", path, error->message);
+    g_clear_error (&error);
+
+    if (result)
     {
-        gchar *key_name, *key = NULL, *listen_address, *hostname;
+        if (g_key_file_has_key (keys, "keyring", key_name, NULL))
+            key = g_key_file_get_string (keys, "keyring", key_name, NULL);
+        else
+            g_warning ("Key %s not defined", key_name);
+    }
+    g_free (path);
+    g_key_file_free (keys);
 
+    return key;
+}
+
+static gboolean
+start_xdmcp_server (void)
+{
+    gchar *key_name, *key = NULL, *listen_address, *hostname;
+    gint port;
+
+    /* Server is kept across configuration reloads so existing sessions continue */
+    if (!xdmcp_server)
+    {
         xdmcp_server = xdmcp_server_new ();
-        if (config_has_key (config_get_instance (), "XDMCPServer", "port"))
-        {
-            gint port;
-            port = config_get_integer (config_get_instance (), "XDMCPServer", "port");
-            if (port > 0)
-                xdmcp_server_set_port (xdmcp_server, port);
-        }
-        listen_address = config_get_string (config_get_instance (), "XDMCPServer", "listen-address");
-        xdmcp_server_set_listen_address (xdmcp_server, listen_address);
-        g_free (listen_address);
-        hostname = config_get_string (config_get_instance (), "XDMCPServer", "hostname");
-        xdmcp_server_set_hostname (xdmcp_server, hostname);
-        g_free (hostname);
         g_signal_connect (xdmcp_server, XDMCP_SERVER_SIGNAL_NEW_SESSION, G_CALLBACK (xdmcp_session_cb), NULL);
+    }
 
-        key_name = config_get_string (config_get_instance (), "XDMCPServer", "key");
-        if (key_name)
-        {
-            gchar *path;
-            GKeyFile *keys;
-            gboolean result;
-            GError *error = NULL;
+    port = config_get_integer (config_get_instance (), "XDMCPServer", "port");
+    xdmcp_server_set_port (xdmcp_server, MAX (port, 0));
+    listen_address = config_get_string (config_get_instance (), "XDMCPServer", "listen-address");
+    xdmcp_server_set_listen_address (xdmcp_server, listen_address);
+    g_free (listen_address);
+    hostname = config_get_string (config_get_instance (), "XDMCPServer", "hostname");
+    xdmcp_server_set_hostname (xdmcp_server, hostname);
+    g_free (hostname);
+    xdmcp_server_set_log_packets (xdmcp_server, config_get_boolean (config_get_instance (), "XDMCPServer", "log-packets"));
+    xdmcp_server_set_capacity (xdmcp_server, MAX (config_get_integer (config_get_instance (), "XDMCPServer", "capacity"), 0));
+    xdmcp_server_set_report_load (xdmcp_server, config_get_boolean (config_get_instance (), "XDMCPServer", "report-load"));
+    xdmcp_server_set_max_pending_sessions (xdmcp_server, MAX (config_get_integer (config_get_instance (), "XDMCPServer", "max-pending-sessions"), 0));
+    xdmcp_server_set_request_rate_limit (xdmcp_server, MAX (config_get_integer (config_get_instance (), "XDMCPServer", "request-rate-limit"), 0));
+    xdmcp_server_set_keep_alive_timeout (xdmcp_server, MAX (config_get_integer (config_get_instance (), "XDMCPServer", "keep-alive-timeout"), 0));
+
+    key_name = config_get_string (config_get_instance (), "XDMCPServer", "key");
+    if (key_name)
+        key = load_xdmcp_key (key_name);
+    xdmcp_server_set_key (xdmcp_server, key);
+    g_free (key);
+
+    if (key_name && !key)
+    {
+        g_free (key_name);
+        return FALSE;
+    }
+    g_free (key_name);
 
-            path = g_build_filename (config_get_directory (config_get_instance ()), "keys.conf", NULL);
+    g_debug ("Starting XDMCP server on UDP/IP port %d", xdmcp_server_get_port (xdmcp_server));
+    xdmcp_server_start (xdmcp_server);
 
-            keys = g_key_file_new ();
-            result = g_key_file_load_from_file (keys, path, G_KEY_FILE_NONE, &error);
-            if (error)
-                g_warning ("Unable to load keys from %s: %s", path, error->message);
-            g_clear_error (&error);
+    return TRUE;
+}
 
-            if (result)
-            {
-                if (g_key_file_has_key (keys, "keyring", key_name, NULL))
-                    key = g_key_file_get_string (keys, "keyring", key_name, NULL);
-                else
-                    g_warning ("Key %s not defined", key_name);
-            }
-            g_free (path);
-            g_key_file_free (keys);
-        }
-        if (key)
-            xdmcp_server_set_key (xdmcp_server, key);
-        g_free (key_name);
-        g_free (key);
-      
-        if (key_name && !key)
-        {
-            exit_code = EXIT_FAILURE;
-            display_manager_stop (display_manager);
-            return;
-        }
-        else
-        {
-            g_debug ("Starting XDMCP server on UDP/IP port %d", xdmcp_server_get_port (xdmcp_server));
-            xdmcp_server_start (xdmcp_server);
-        }
+static void
+start_vnc_server (void)
+{
+    gchar *path, *listen_address;
+    gint port;
+
+    path = g_find_program_in_path ("Xvnc");
+    if (!path)
+    {
+        g_warning ("Can't start VNC server, Xvnc is not in the path");
+        return;
+    }
+    g_free (path);
+
+    if (!vnc_server)
+    {
+        vnc_server = vnc_server_new ();
+        g_signal_connect (vnc_server, VNC_SERVER_SIGNAL_NEW_CONNECTION, G_CALLBACK (vnc_connection_cb), NULL);
+    }
+
+    port = config_get_integer (config_get_instance (), "VNCServer", "port");
+    vnc_server_set_port (vnc_server, MAX (port, 0));
+    listen_address = config_get_string (config_get_instance (), "VNCServer", "listen-address");
+    vnc_server_set_listen_address (vnc_server, listen_address);
+    g_free (listen_address);
+
+    g_debug ("Starting VNC server on TCP/IP port %d", vnc_server_get_port (vnc_server));
+    vnc_server_start (vnc_server);
+}
+
+static void
+start_display_manager (void)
+{
+    /* Have session child processes ready before the first authentication */
+    session_set_child_pool_size (MAX (config_get_integer (config_get_instance (), "LightDM", "session-child-pool-size"), 0));
+
+    display_manager_start (display_manager);
+
+    /* Start the XDMCP server */
+    if (config_get_boolean (config_get_instance (), "XDMCPServer", "enabled") && !start_xdmcp_server ())
+    {
+        exit_code = EXIT_FAILURE;
+        display_manager_stop (display_manager);
+        return;
     }
 
     /* Start the VNC server */
     if (config_get_boolean (config_get_instance (), "VNCServer", "enabled"))
+        start_vnc_server ();
+}
+
+static gboolean
+has_changes_in_section (gchar **changes, const gchar *section)
+{
+    gchar *prefix;
+    gboolean result = FALSE;
+    int i;
+
+    prefix = g_strdup_printf ("[%s] ", section);
+    for (i = 0; changes[i] && !result; i++)
+        result = g_str_has_prefix (changes[i], prefix);
+    g_free (prefix);
+
+    return result;
+}
+
+typedef struct
+{
+    Configuration *config;
+    GList *messages;
+} ConfigReload;
+
+static void
+config_reload_free (ConfigReload *reload)
+{
+    g_clear_object (&reload->config);
+    g_list_free_full (reload->messages, g_free);
+    g_free (reload);
+}
+
+static void
+load_config_thread (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    ConfigReload *reload = task_data;
+
+    reload->config = config_new ();
+    g_task_return_boolean (task, config_load_from_standard_locations (reload->config, config_path, &reload->messages));
+}
+
+static void
+config_loaded_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    ConfigReload *reload = g_task_get_task_data (G_TASK (result));
+    gchar **changes;
+    GList *link;
+    int i;
+
+    for (link = reload->messages; link; link = link->next)
+        g_debug ("%s", (gchar *) link->data);
+
+    if (!g_task_propagate_boolean (G_TASK (result), NULL))
     {
-        gchar *path;
+        g_warning ("Failed to reload configuration, keeping current configuration");
+        return;
+    }
 
-        path = g_find_program_in_path ("Xvnc");
-        if (path)
-        {
-            gchar *listen_address;
+    set_config_defaults (reload->config);
+    changes = config_get_changes (config_get_instance (), reload->config);
+    if (changes[0] == NULL)
+    {
+        g_debug ("Configuration unchanged");
+        g_strfreev (changes);
+        return;
+    }
+    for (i = 0; changes[i]; i++)
+        g_message ("Configuration changed: %s", changes[i]);
 
-            vnc_server = vnc_server_new ();
-            if (config_has_key (config_get_instance (), "VNCServer", "port"))
-            {
-                gint port;
-                port = config_get_integer (config_get_instance (), "VNCServer", "port");
-                if (port > 0)
-                    vnc_server_set_port (vnc_server, port);
-            }
-            listen_address = config_get_string (config_get_instance (), "VNCServer", "listen-address");
-            vnc_server_set_listen_address (vnc_server, listen_address);
-            g_free (listen_address);
-            g_signal_connect (vnc_server, VNC_SERVER_SIGNAL_NEW_CONNECTION, G_CALLBACK (vnc_connection_cb), NULL);
+    /* Swap in the new configuration, running seats keep the properties they were created with */
+    config_set_instance (reload->config);
+    if (seat_properties)
+        g_hash_table_remove_all (seat_properties);
 
-            g_debug ("Starting VNC server on TCP/IP port %d", vnc_server_get_port (vnc_server));
-            vnc_server_start (vnc_server);
+    if (has_changes_in_section (changes, "LightDM"))
+        session_set_child_pool_size (MAX (config_get_integer (config_get_instance (), "LightDM", "session-child-pool-size"), 0));
 
-            g_free (path);
-        }
-        else
-            g_warning ("Can't start VNC server, Xvnc is not in the path");
+    if (has_changes_in_section (changes, "XDMCPServer"))
+    {
+        if (xdmcp_server)
+            xdmcp_server_stop (xdmcp_server);
+        if (config_get_boolean (config_get_instance (), "XDMCPServer", "enabled") && !start_xdmcp_server ())
+            g_warning ("Failed to restart XDMCP server with new configuration");
     }
+
+    if (has_changes_in_section (changes, "VNCServer"))
+    {
+        if (vnc_server)
+            vnc_server_stop (vnc_server);
+        if (config_get_boolean (config_get_instance (), "VNCServer", "enabled"))
+            start_vnc_server ();
+    }
+
+    g_strfreev (changes);
 }
+
+static void
+reload_config (void)
+{
+    GTask *task;
+
+    g_debug ("Reloading configuration");
+
+    /* Parse the files in a thread so we don't block the main loop */
+    task = g_task_new (NULL, NULL, config_loaded_cb, NULL);
+    g_task_set_task_data (task, g_malloc0 (sizeof (ConfigReload)), (GDestroyNotify) config_reload_free);
+    g_task_run_in_thread (task, load_config_thread);
+    g_object_unref (task);
+}
+
 static void
 service_ready_cb (DisplayManagerService *service)
 {
     start_display_manager ();
 }
 
+static void
+service_reload_config_cb (DisplayManagerService *service)
+{
+    reload_config ();
+}
+
 static void
 service_name_lost_cb (DisplayManagerService *service)
 {
@@ -594,6 +824,105 @@ login1_service_seat_removed_cb (Login1Service *service, Login1Seat *login1_seat)
     remove_login1_seat (login1_seat);
 }
 
+static void
+set_config_defaults (Configuration *config)
+{
+    /* Set default values */
+    if (!config_has_key (config, "LightDM", "start-default-seat"))
+        config_set_boolean (config, "LightDM", "start-default-seat", TRUE);
+    if (!config_has_key (config, "LightDM", "minimum-vt"))
+        config_set_integer (config, "LightDM", "minimum-vt", 7);
+    if (!config_has_key (config, "LightDM", "guest-account-script"))
+        config_set_string (config, "LightDM", "guest-account-script", "guest-account");
+    if (!config_has_key (config, "LightDM", "greeter-user"))
+        config_set_string (config, "LightDM", "greeter-user", GREETER_USER);
+    if (!config_has_key (config, "LightDM", "lock-memory"))
+        config_set_boolean (config, "LightDM", "lock-memory", TRUE);
+    if (!config_has_key (config, "LightDM", "backup-logs"))
+        config_set_boolean (config, "LightDM", "backup-logs", TRUE);
+    if (!config_has_key (config, "LightDM", "dbus-service"))
+        config_set_boolean (config, "LightDM", "dbus-service", TRUE);
+    if (!config_has_key (config, "LightDM", "async-logging-buffer-size"))
+        config_set_integer (config, "LightDM", "async-logging-buffer-size", 1024 * 1024);
+    if (!config_has_key (config, "Seat:*", "type"))
+        config_set_string (config, "Seat:*", "type", "local");
+    if (!config_has_key (config, "Seat:*", "pam-service"))
+        config_set_string (config, "Seat:*", "pam-service", "lightdm");
+    if (!config_has_key (config, "Seat:*", "pam-autologin-service"))
+        config_set_string (config, "Seat:*", "pam-autologin-service", "lightdm-autologin");
+    if (!config_has_key (config, "Seat:*", "pam-greeter-service"))
+        config_set_string (config, "Seat:*", "pam-greeter-service", "lightdm-greeter");
+    if (!config_has_key (config, "Seat:*", "xserver-command"))
+        config_set_string (config, "Seat:*", "xserver-command", "X");
+    if (!config_has_key (config, "Seat:*", "xmir-command"))
+        config_set_string (config, "Seat:*", "xmir-command", "Xmir");
+    if (!config_has_key (config, "Seat:*", "xserver-share"))
+        config_set_boolean (config, "Seat:*", "xserver-share", TRUE);
+    if (!config_has_key (config, "Seat:*", "unity-compositor-command"))
+        config_set_string (config, "Seat:*", "unity-compositor-command", "unity-system-compositor");
+    if (!config_has_key (config, "Seat:*", "start-session"))
+        config_set_boolean (config, "Seat:*", "start-session", TRUE);
+    if (!config_has_key (config, "Seat:*", "allow-user-switching"))
+        config_set_boolean (config, "Seat:*", "allow-user-switching", TRUE);
+    if (!config_has_key (config, "Seat:*", "allow-guest"))
+        config_set_boolean (config, "Seat:*", "allow-guest", TRUE);
+    if (!config_has_key (config, "Seat:*", "greeter-allow-guest"))
+        config_set_boolean (config, "Seat:*", "greeter-allow-guest", TRUE);
+    if (!config_has_key (config, "Seat:*", "greeter-show-remote-login"))
+        config_set_boolean (config, "Seat:*", "greeter-show-remote-login", TRUE);
+    if (!config_has_key (config, "Seat:*", "greeter-session"))
+        config_set_string (config, "Seat:*", "greeter-session", DEFAULT_GREETER_SESSION);
+    if (!config_has_key (config, "Seat:*", "user-session"))
+        config_set_string (config, "Seat:*", "user-session", DEFAULT_USER_SESSION);
+    if (!config_has_key (config, "Seat:*", "session-wrapper"))
+        config_set_string (config, "Seat:*", "session-wrapper", "lightdm-session");
+    if (!config_has_key (config, "LightDM", "log-directory"))
+        config_set_string (config, "LightDM", "log-directory", default_log_dir);
+    if (!config_has_key (config, "LightDM", "run-directory"))
+        config_set_string (config, "LightDM", "run-directory", default_run_dir);
+    if (!config_has_key (config, "LightDM", "cache-directory"))
+        config_set_string (config, "LightDM", "cache-directory", default_cache_dir);
+    if (!config_has_key (config, "LightDM", "sessions-directory"))
+        config_set_string (config, "LightDM", "sessions-directory", SESSIONS_DIR);
+    if (!config_has_key (config, "LightDM", "remote-sessions-directory"))
+        config_set_string (config, "LightDM", "remote-sessions-directory", REMOTE_SESSIONS_DIR);
+    if (!config_has_key (config, "LightDM", "greeters-directory"))
+    {
+        GPtrArray *dirs;
+        const gchar * const *data_dirs;
+        gchar *value;
+        int i;
+
+        dirs = g_ptr_array_new_with_free_func (g_free);
+        data_dirs = g_get_system_data_dirs ();
+        for (i = 0; data_dirs[i]; i++) 
+            g_ptr_array_add (dirs, g_build_filename (data_dirs[i], "lightdm/greeters", NULL));
+        for (i = 0; data_dirs[i]; i++)
+            g_ptr_array_add (dirs, g_build_filename (data_dirs[i], "xgreeters", NULL));
+        g_ptr_array_add (dirs, NULL);
+        value = g_strjoinv (":", (gchar **) dirs->pdata);
+        config_set_string (config, "LightDM", "greeters-directory", value);
+        g_free (value);
+        g_ptr_array_unref (dirs);
+    }
+    if (!config_has_key (config, "XDMCPServer", "hostname"))
+        config_set_string (config, "XDMCPServer", "hostname", g_get_host_name ());
+    if (!config_has_key (config, "XDMCPServer", "log-packets"))
+        config_set_boolean (config, "XDMCPServer", "log-packets", debug);
+    if (!config_has_key (config, "XDMCPServer", "max-pending-sessions"))
+        config_set_integer (config, "XDMCPServer", "max-pending-sessions", 100);
+    if (!config_has_key (config, "XDMCPServer", "request-rate-limit"))
+        config_set_integer (config, "XDMCPServer", "request-rate-limit", 5);
+
+    /* Override defaults */
+    if (option_log_dir)
+        config_set_string (config, "LightDM", "log-directory", option_log_dir);
+    if (option_run_dir)
+        config_set_string (config, "LightDM", "run-directory", option_run_dir);
+    if (option_cache_dir)
+        config_set_string (config, "LightDM", "cache-directory", option_cache_dir);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -604,12 +933,6 @@ main (int argc, char **argv)
     gchar *dir;
     gboolean test_mode = FALSE;
     gchar *pid_path = "/var/run/lightdm.pid";
-    gchar *log_dir = NULL;
-    gchar *run_dir = NULL;
-    gchar *cache_dir = NULL;
-    gchar *default_log_dir = g_strdup (LOG_DIR);
-    gchar *default_run_dir = g_strdup (RUN_DIR);
-    gchar *default_cache_dir = g_strdup (CACHE_DIR);
     gboolean show_config = FALSE, show_version = FALSE;
     GList *link, *messages = NULL;
     GOptionEntry options[] =
@@ -626,13 +949,13 @@ main (int argc, char **argv)
         { "pid-file", 0, 0, G_OPTION_ARG_STRING, &pid_path,
           /* Help string for command line --pid-file flag */
           N_("File to write PID into"), "FILE" },
-        { "log-dir", 0, 0, G_OPTION_ARG_STRING, &log_dir,
+        { "log-dir", 0, 0, G_OPTION_ARG_STRING, &option_log_dir,
           /* Help string for command line --log-dir flag */
           N_("Directory to write logs to"), "DIRECTORY" },
-        { "run-dir", 0, 0, G_OPTION_ARG_STRING, &run_dir,
+        { "run-dir", 0, 0, G_OPTION_ARG_STRING, &option_run_dir,
           /* Help string for command line --run-dir flag */
           N_("Directory to store running state"), "DIRECTORY" },
-        { "cache-dir", 0, 0, G_OPTION_ARG_STRING, &cache_dir,
+        { "cache-dir", 0, 0, G_OPTION_ARG_STRING, &option_cache_dir,
           /* Help string for command line --cache-dir flag */
           N_("Directory to cache information"), "DIRECTORY" },
         { "show-config", 0, 0, G_OPTION_ARG_NONE, &show_config,
@@ -648,7 +971,7 @@ main (int argc, char **argv)
     /* Disable the SIGPIPE handler - this is a stupid Unix hangover behaviour.
      * We will handle pipes / sockets being closed instead of having the whole daemon be killed...
      * http://stackoverflow.com/questions/8369506/why-does-sigpipe-exist
-     * Similar case for SIGHUP.
+     * Similar case for SIGHUP (the daemon itself uses it to reload configuration once running).
      */
     action.sa_handler = SIG_IGN;
     sigemptyset (&action.sa_mask);
@@ -813,111 +1136,22 @@ main (int argc, char **argv)
     /* If not running as root write output to directories we control */
     if (getuid () != 0)
     {
-        g_free (default_log_dir);
         default_log_dir = g_build_filename (g_get_user_cache_dir (), "lightdm", "log", NULL);
-        g_free (default_run_dir);
         default_run_dir = g_build_filename (g_get_user_cache_dir (), "lightdm", "run", NULL);
-        g_free (default_cache_dir);
         default_cache_dir = g_build_filename (g_get_user_cache_dir (), "lightdm", "cache", NULL);
     }
+    else
+    {
+        default_log_dir = g_strdup (LOG_DIR);
+        default_run_dir = g_strdup (RUN_DIR);
+        default_cache_dir = g_strdup (CACHE_DIR);
+    }
 
     /* Load config file(s) */
     if (!config_load_from_standard_locations (config_get_instance (), config_path, &messages))
         exit (EXIT_FAILURE);
-    g_free (config_path);
-
-    /* Set default values */
-    if (!config_has_key (config_get_instance (), "LightDM", "start-default-seat"))
-        config_set_boolean (config_get_instance (), "LightDM", "start-default-seat", TRUE);
-    if (!config_has_key (config_get_instance (), "LightDM", "minimum-vt"))
-        config_set_integer (config_get_instance (), "LightDM", "minimum-vt", 7);
-    if (!config_has_key (config_get_instance (), "LightDM", "guest-account-script"))
-        config_set_string (config_get_instance (), "LightDM", "guest-account-script", "guest-account");
-    if (!config_has_key (config_get_instance (), "LightDM", "greeter-user"))
-        config_set_string (config_get_instance (), "LightDM", "greeter-user", GREETER_USER);
-    if (!config_has_key (config_get_instance (), "LightDM", "lock-memory"))
-        config_set_boolean (config_get_instance (), "LightDM", "lock-memory", TRUE);
-    if (!config_has_key (config_get_instance (), "LightDM", "backup-logs"))
-        config_set_boolean (config_get_instance (), "LightDM", "backup-logs", TRUE);
-    if (!config_has_key (config_get_instance (), "LightDM", "dbus-service"))
-        config_set_boolean (config_get_instance (), "LightDM", "dbus-service", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "type"))
-        config_set_string (config_get_instance (), "Seat:*", "type", "local");
-    if (!config_has_key (config_get_instance (), "Seat:*", "pam-service"))
-        config_set_string (config_get_instance (), "Seat:*", "pam-service", "lightdm");
-    if (!config_has_key (config_get_instance (), "Seat:*", "pam-autologin-service"))
-        config_set_string (config_get_instance (), "Seat:*", "pam-autologin-service", "lightdm-autologin");
-    if (!config_has_key (config_get_instance (), "Seat:*", "pam-greeter-service"))
-        config_set_string (config_get_instance (), "Seat:*", "pam-greeter-service", "lightdm-greeter");
-    if (!config_has_key (config_get_instance (), "Seat:*", "xserver-command"))
-        config_set_string (config_get_instance (), "Seat:*", "xserver-command", "X");
-    if (!config_has_key (config_get_instance (), "Seat:*", "xmir-command"))
-        config_set_string (config_get_instance (), "Seat:*", "xmir-command", "Xmir");
-    if (!config_has_key (config_get_instance (), "Seat:*", "xserver-share"))
-        config_set_boolean (config_get_instance (), "Seat:*", "xserver-share", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "unity-compositor-command"))
-        config_set_string (config_get_instance (), "Seat:*", "unity-compositor-command", "unity-system-compositor");
-    if (!config_has_key (config_get_instance (), "Seat:*", "start-session"))
-        config_set_boolean (config_get_instance (), "Seat:*", "start-session", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "allow-user-switching"))
-        config_set_boolean (config_get_instance (), "Seat:*", "allow-user-switching", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "allow-guest"))
-        config_set_boolean (config_get_instance (), "Seat:*", "allow-guest", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "greeter-allow-guest"))
-        config_set_boolean (config_get_instance (), "Seat:*", "greeter-allow-guest", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "greeter-show-remote-login"))
-        config_set_boolean (config_get_instance (), "Seat:*", "greeter-show-remote-login", TRUE);
-    if (!config_has_key (config_get_instance (), "Seat:*", "greeter-session"))
-        config_set_string (config_get_instance (), "Seat:*", "greeter-session", DEFAULT_GREETER_SESSION);
-    if (!config_has_key (config_get_instance (), "Seat:*", "user-session"))
-        config_set_string (config_get_instance (), "Seat:*", "user-session", DEFAULT_USER_SESSION);
-    if (!config_has_key (config_get_instance (), "Seat:*", "session-wrapper"))
-        config_set_string (config_get_instance (), "Seat:*", "session-wrapper", "lightdm-session");
-    if (!config_has_key (config_get_instance (), "LightDM", "log-directory"))
-        config_set_string (config_get_instance (), "LightDM", "log-directory", default_log_dir);
-    g_free (default_log_dir);
-    if (!config_has_key (config_get_instance (), "LightDM", "run-directory"))
-        config_set_string (config_get_instance (), "LightDM", "run-directory", default_run_dir);
-    g_free (default_run_dir);
-    if (!config_has_key (config_get_instance (), "LightDM", "cache-directory"))
-        config_set_string (config_get_instance (), "LightDM", "cache-directory", default_cache_dir);
-    g_free (default_cache_dir);
-    if (!config_has_key (config_get_instance (), "LightDM", "sessions-directory"))
-        config_set_string (config_get_instance (), "LightDM", "sessions-directory", SESSIONS_DIR);
-    if (!config_has_key (config_get_instance (), "LightDM", "remote-sessions-directory"))
-        config_set_string (config_get_instance (), "LightDM", "remote-sessions-directory", REMOTE_SESSIONS_DIR);
-    if (!config_has_key (config_get_instance (), "LightDM", "greeters-directory"))
-    {
-        GPtrArray *dirs;
-        const gchar * const *data_dirs;
-        gchar *value;
-        int i;
-
-        dirs = g_ptr_array_new_with_free_func (g_free);
-        data_dirs = g_get_system_data_dirs ();
-        for (i = 0; data_dirs[i]; i++) 
-            g_ptr_array_add (dirs, g_build_filename (data_dirs[i], "lightdm/greeters", NULL));
-        for (i = 0; data_dirs[i]; i++)
-            g_ptr_array_add (dirs, g_build_filename (data_dirs[i], "xgreeters", NULL));
-        g_ptr_array_add (dirs, NULL);
-        value = g_strjoinv (":", (gchar **) dirs->pdata);
-        config_set_string (config_get_instance (), "LightDM", "greeters-directory", value);
-        g_free (value);
-        g_ptr_array_unref (dirs);
-    }
-    if (!config_has_key (config_get_instance (), "XDMCPServer", "hostname"))
-        config_set_string (config_get_instance (), "XDMCPServer", "hostname", g_get_host_name ());
 
-    /* Override defaults */
-    if (log_dir)
-        config_set_string (config_get_instance (), "LightDM", "log-directory", log_dir);
-    g_free (log_dir);
-    if (run_dir)
-        config_set_string (config_get_instance (), "LightDM", "run-directory", run_dir);
-    g_free (run_dir);
-    if (cache_dir)
-        config_set_string (config_get_instance (), "LightDM", "cache-directory", cache_dir);
-    g_free (cache_dir);
+    set_config_defaults (config_get_instance ());
 
     /* Create run and cache directories */
     dir = config_get_string (config_get_instance (), "LightDM", "log-directory");
@@ -935,6 +1169,9 @@ main (int argc, char **argv)
 
     log_init ();
 
+    /* Optionally record lifecycle events for tracing */
+    trace_init (MAX (config_get_integer (config_get_instance (), "LightDM", "trace-buffer-size"), 0));
+
     /* Show queued messages once logging is complete */
     for (link = messages; link; link = link->next)
         g_debug ("%s", (gchar *)link->data);
@@ -953,6 +1190,7 @@ main (int argc, char **argv)
     {
         display_manager_service = display_manager_service_new (display_manager);
         g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_ADD_XLOCAL_SEAT, G_CALLBACK (service_add_xlocal_seat_cb), NULL);
+        g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_RELOAD_CONFIG, G_CALLBACK (service_reload_config_cb), NULL);
         g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_READY, G_CALLBACK (service_ready_cb), NULL);
         g_signal_connect (display_manager_service, DISPLAY_MANAGER_SERVICE_SIGNAL_NAME_LOST, G_CALLBACK (service_name_lost_cb), NULL);
         display_manager_service_start (display_manager_service);
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "log-writer.h"
+
+/* Maximum number of file descriptors to write to */
+#define MAX_FDS 2
+
+/* Lock protecting the ring buffer */
+static GMutex lock;
+
+/* Signalled when there is data to write or we are stopping */
+static GCond data_cond;
+
+/* Signalled when data has been written */
+static GCond written_cond;
+
+/* Ring buffer of formatted log lines, positions are totals and are used modulo the size */
+static gchar *buffer = NULL;
+static gsize buffer_size = 0;
+static guint64 write_position = 0;
+static guint64 read_position = 0;
+
+/* Number of messages dropped because the buffer was full */
+static guint64 n_dropped = 0;
+
+/* Last message written, repeats of it are counted rather than written */
+static gchar *last_message = NULL;
+static const gchar *last_prefix = NULL;
+static guint n_repeats = 0;
+
+/* Time of the last message, used for the notices written when stopping */
+static gdouble last_timestamp = 0;
+
+/* Where log lines go */
+static int log_fds[MAX_FDS];
+static gsize n_log_fds = 0;
+
+/* Process that owns the writer thread (forked children write directly) */
+static pid_t writer_pid = 0;
+
+static GThread *writer_thread = NULL;
+static gboolean stopping = FALSE;
+
+static void
+write_all (int fd, struct iovec *iov, int iovcnt)
+{
+    struct iovec remaining[2];
+    int i;
+
+    memcpy (remaining, iov, sizeof (struct iovec) * iovcnt);
+    i = 0;
+    while (i < iovcnt)
+    {
+        ssize_t n_written;
+
+        n_written = writev (fd, remaining + i, iovcnt - i);
+        if (n_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        /* Skip what has been written */
+        while (i < iovcnt && (gsize) n_written >= remaining[i].iov_len)
+        {
+            n_written -= remaining[i].iov_len;
+            i++;
+        }
+        if (i < iovcnt)
+        {
+            remaining[i].iov_base = (gchar *) remaining[i].iov_base + n_written;
+            remaining[i].iov_len -= n_written;
+        }
+    }
+}
+
+static gpointer
+writer_thread_func (gpointer data)
+{
+    g_mutex_lock (&lock);
+    while (TRUE)
+    {
+        struct iovec iov[2];
+        int iovcnt = 0;
+        guint64 end;
+        gsize start, length;
+        gsize i;
+
+        while (read_position == write_position && !stopping)
+            g_cond_wait (&data_cond, &lock);
+        if (read_position == write_position)
+            break;
+
+        /* Write everything queued in one go, in two parts if it wraps around the end of the buffer */
+        end = write_position;
+        start = read_position % buffer_size;
+        length = end - read_position;
+        iov[iovcnt].iov_base = buffer + start;
+        iov[iovcnt].iov_len = MIN (length, buffer_size - start);
+        iovcnt++;
+        if (iov[0].iov_len < length)
+        {
+            iov[iovcnt].iov_base = buffer;
+            iov[iovcnt].iov_len = length - iov[0].iov_len;
+            iovcnt++;
+        }
+        g_mutex_unlock (&lock);
+
+        for (i = 0; i < n_log_fds; i++)
+            write_all (log_fds[i], iov, iovcnt);
+
+        g_mutex_lock (&lock);
+        read_position = end;
+        g_cond_broadcast (&written_cond);
+    }
+    g_mutex_unlock (&lock);
+
+    return NULL;
+}
+
+static void
+write_sync (const gchar *text, gsize length)
+{
+    struct iovec iov;
+    gsize i;
+
+    iov.iov_base = (gchar *) text;
+    iov.iov_len = length;
+    for (i = 0; i < n_log_fds; i++)
+        write_all (log_fds[i], &iov, 1);
+}
+
+static void
+copy_in (const gchar *text, gsize length)
+{
+    gsize start, first;
+
+    start = write_position % buffer_size;
+    first = MIN (length, buffer_size - start);
+    memcpy (buffer + start, text, first);
+    memcpy (buffer, text + first, length - first);
+    write_position += length;
+}
+
+/* Queue a line for the writer thread, must hold the lock */
+static void
+queue_line (gdouble timestamp, const gchar *text, gsize length)
+{
+    gsize available;
+
+    available = buffer_size - (write_position - read_position);
+
+    /* Report any messages we had to drop once there is room again */
+    if (n_dropped > 0)
+    {
+        gchar notice[128];
+        gint notice_length;
+
+        notice_length = g_snprintf (notice, sizeof (notice), "[%+.2fs] WARNING: %" G_GUINT64_FORMAT " log message(s) dropped, log buffer full\n", timestamp, n_dropped);
+        if ((gsize) notice_length <= available)
+        {
+            copy_in (notice, notice_length);
+            available -= notice_length;
+            n_dropped = 0;
+        }
+    }
+
+    if (length > available)
+        n_dropped++;
+    else
+        copy_in (text, length);
+    g_cond_signal (&data_cond);
+}
+
+/* Write out how many times the last message was repeated, must hold the lock */
+static void
+queue_repeats (gdouble timestamp)
+{
+    gchar text[128];
+    gint length;
+
+    if (n_repeats == 0)
+        return;
+
+    length = g_snprintf (text, sizeof (text), "[%+.2fs] %s Last message repeated %u times\n", timestamp, last_prefix, n_repeats);
+    queue_line (timestamp, text, MIN (length, (gint) sizeof (text) - 1));
+    n_repeats = 0;
+}
+
+static void
+stop_writer (void)
+{
+    gchar notice[128];
+    gint notice_length;
+
+    if (!log_writer_get_is_running ())
+        return;
+
+    g_mutex_lock (&lock);
+    queue_repeats (last_timestamp);
+    stopping = TRUE;
+    g_cond_signal (&data_cond);
+    g_mutex_unlock (&lock);
+
+    g_thread_join (writer_thread);
+    writer_thread = NULL;
+
+    /* Report anything dropped since there was last room */
+    if (n_dropped > 0)
+    {
+        notice_length = g_snprintf (notice, sizeof (notice), "[%+.2fs] WARNING: %" G_GUINT64_FORMAT " log message(s) dropped, log buffer full\n", last_timestamp, n_dropped);
+        write_sync (notice, notice_length);
+        n_dropped = 0;
+    }
+}
+
+void
+log_writer_start (const int *fds, gsize n_fds, gsize size)
+{
+    gsize i;
+
+    g_return_if_fail (writer_thread == NULL);
+    g_return_if_fail (n_fds <= MAX_FDS);
+    g_return_if_fail (size > 0);
+
+    for (i = 0; i < n_fds; i++)
+        log_fds[i] = fds[i];
+    n_log_fds = n_fds;
+
+    buffer = g_malloc (size);
+    buffer_size = size;
+    writer_pid = getpid ();
+    writer_thread = g_thread_new ("log-writer", writer_thread_func, NULL);
+
+    /* Make sure everything is written when we exit */
+    atexit (stop_writer);
+}
+
+gboolean
+log_writer_get_is_running (void)
+{
+    /* Forked children have a copy of the state but not the thread */
+    return writer_thread != NULL && getpid () == writer_pid;
+}
+
+void
+log_writer_write (gdouble timestamp, const gchar *prefix, const gchar *message)
+{
+    gchar buf[1024], *text = buf;
+    gint length;
+
+    /* Format into the buffer, only allocating for long messages */
+    length = g_snprintf (buf, sizeof (buf), "[%+.2fs] %s %s\n", timestamp, prefix, message);
+    if (length >= (gint) sizeof (buf))
+        text = g_strdup_printf ("[%+.2fs] %s %s\n", timestamp, prefix, message);
+
+    /* Forked children (and anything after stopping) write directly, the writer thread doesn't exist there */
+    if (!log_writer_get_is_running ())
+    {
+        write_sync (text, length);
+        if (text != buf)
+            g_free (text);
+        return;
+    }
+
+    g_mutex_lock (&lock);
+
+    last_timestamp = timestamp;
+
+    /* Collapse repeated messages so a flood doesn't fill the buffer */
+    if (last_message && g_strcmp0 (prefix, last_prefix) == 0 && strcmp (message, last_message) == 0)
+        n_repeats++;
+    else
+    {
+        queue_repeats (timestamp);
+        g_free (last_message);
+        last_message = g_strdup (message);
+        last_prefix = prefix;
+        queue_line (timestamp, text, length);
+    }
+
+    g_mutex_unlock (&lock);
+
+    if (text != buf)
+        g_free (text);
+}
+
+void
+log_writer_flush (void)
+{
+    if (!log_writer_get_is_running ())
+        return;
+
+    g_mutex_lock (&lock);
+    while (read_position != write_position)
+        g_cond_wait (&written_cond, &lock);
+    g_mutex_unlock (&lock);
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef LOG_WRITER_H_
+#define LOG_WRITER_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void log_writer_start (const int *fds, gsize n_fds, gsize buffer_size);
+
+gboolean log_writer_get_is_running (void);
+
+void log_writer_write (gdouble timestamp, const gchar *prefix, const gchar *message);
+
+void log_writer_flush (void);
+
+G_END_DECLS
+
+#endif /* LOG_WRITER_H_ */
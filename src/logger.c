@@ -25,50 +25,54 @@ logger_logv (Logger *self, GLogLevelFlags log_level, const gchar *format, va_lis
     LOGGER_GET_INTERFACE (self)->logv (self, log_level, format, ap);
 }
 
+/* Size of the buffer messages are formatted into, longer messages are allocated */
+#define LOG_BUFFER_SIZE 1024
+
 void
 logger_logv_default (Logger *self, GLogLevelFlags log_level, const gchar *format, va_list ap)
 {
+    gchar buf[LOG_BUFFER_SIZE];
+    gchar *text = buf;
+    gint prefix_length, length = -1;
     va_list ap_copy;
-    gint tmp;
 
-    /* figure out how long the prefix is */
-    tmp = logger_logprefix (self, NULL, 0);
-    if (tmp < 0)
+    /* print the prefix then the message into the buffer in a single pass */
+    prefix_length = logger_logprefix (self, buf, sizeof (buf));
+    if (prefix_length < 0)
     {
         g_error ("failed to get log prefix");
         return;
     }
-
-    /* print the prefix to a variable length array (to avoid malloc) */
-    gchar pfx[tmp + 1];
-    tmp = logger_logprefix (self, pfx, sizeof(pfx));
-    if (tmp < 0)
+    if (prefix_length < (gint) sizeof (buf))
     {
-        g_error ("failed to get log prefix");
-        return;
+        va_copy (ap_copy, ap);
+        length = g_vsnprintf (buf + prefix_length, sizeof (buf) - prefix_length, format, ap_copy);
+        va_end (ap_copy);
+        if (length < 0)
+        {
+            g_error ("failed to format log message");
+            return;
+        }
     }
 
-    /* figure out how long the formatted message is */
-    va_copy (ap_copy, ap);
-    tmp = g_vsnprintf (NULL, 0, format, ap_copy);
-    va_end (ap_copy);
-    if (tmp < 0)
+    /* only allocate if it didn't fit */
+    if (length < 0 || prefix_length + length >= (gint) sizeof (buf))
     {
-        g_error ("failed to format log message");
-        return;
-    }
+        gchar *prefix, *message;
 
-    /* print the message to a variable length array (to avoid malloc) */
-    gchar msg[tmp+1];
-    tmp = g_vsnprintf (msg, sizeof(msg), format, ap);
-    if (tmp < 0)
-    {
-        g_error ("failed to format log message");
-        return;
+        prefix = g_malloc (prefix_length + 1);
+        logger_logprefix (self, prefix, prefix_length + 1);
+        message = g_strdup_vprintf (format, ap);
+        text = g_strconcat (prefix, message, NULL);
+        g_free (prefix);
+        g_free (message);
     }
 
     /* log the message with the prefix */
-    g_log (G_LOG_DOMAIN, log_level, "%s%s", pfx, msg);
+    g_log (G_LOG_DOMAIN, log_level, "%s", text);
+
+    if (text != buf)
+        g_free (text);
 }
 
 void
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <config.h>
+
+#include "login-metrics.h"
+
+typedef struct
+{
+    guint64 count;
+    guint64 total;
+    guint64 minimum;
+    guint64 maximum;
+    guint64 buckets[LOGIN_METRICS_N_BUCKETS];
+} Histogram;
+
+typedef struct
+{
+    Histogram histograms[LOGIN_METRIC_LAST];
+} LoginMetrics;
+
+static const gchar *metric_names[LOGIN_METRIC_LAST] =
+{
+    "greeter-start",
+    "display-server-ready",
+    "pam-authenticate",
+    "pam-acct-mgmt",
+    "pam-setcred",
+    "pam-open-session",
+    "session-exec",
+    "logout-to-greeter"
+};
+
+/* Metrics across all seats */
+static LoginMetrics global_metrics;
+
+/* Metrics for each seat, keyed by seat name. These are kept after a seat is removed so they survive seats coming and going */
+static GHashTable *seat_metrics = NULL;
+
+const gchar *
+login_metrics_get_name (LoginMetric metric)
+{
+    g_return_val_if_fail (metric < LOGIN_METRIC_LAST, NULL);
+    return metric_names[metric];
+}
+
+static guint
+get_bucket (guint64 duration)
+{
+    guint64 ms = duration / 1000;
+    guint bucket = 0;
+
+    while (ms > 0 && bucket < LOGIN_METRICS_N_BUCKETS - 1)
+    {
+        ms >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static void
+histogram_add (Histogram *histogram, guint64 duration)
+{
+    if (histogram->count == 0 || duration < histogram->minimum)
+        histogram->minimum = duration;
+    if (duration > histogram->maximum)
+        histogram->maximum = duration;
+    histogram->count++;
+    histogram->total += duration;
+    histogram->buckets[get_bucket (duration)]++;
+}
+
+void
+login_metrics_record (const gchar *seat_name, LoginMetric metric, gint64 duration)
+{
+    LoginMetrics *metrics;
+
+    g_return_if_fail (metric < LOGIN_METRIC_LAST);
+
+    /* Negative durations mean the phase didn't run */
+    if (duration < 0)
+        return;
+
+    histogram_add (&global_metrics.histograms[metric], duration);
+
+    if (!seat_name)
+        return;
+
+    if (!seat_metrics)
+        seat_metrics = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    metrics = g_hash_table_lookup (seat_metrics, seat_name);
+    if (!metrics)
+    {
+        metrics = g_malloc0 (sizeof (LoginMetrics));
+        g_hash_table_insert (seat_metrics, g_strdup (seat_name), metrics);
+    }
+    histogram_add (&metrics->histograms[metric], duration);
+}
+
+void
+login_metrics_record_since (const gchar *seat_name, LoginMetric metric, gint64 start_time)
+{
+    if (start_time <= 0)
+        return;
+    login_metrics_record (seat_name, metric, g_get_monotonic_time () - start_time);
+}
+
+static GVariant *
+metrics_to_variant (LoginMetrics *metrics)
+{
+    GVariantBuilder builder;
+    int i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE (LOGIN_METRICS_SUMMARY_TYPE));
+    for (i = 0; i < LOGIN_METRIC_LAST; i++)
+    {
+        Histogram *histogram = &metrics->histograms[i];
+        GVariant *buckets;
+
+        buckets = g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64, histogram->buckets, LOGIN_METRICS_N_BUCKETS, sizeof (guint64));
+        g_variant_builder_add (&builder, "{s(tttt@at)}",
+                               metric_names[i],
+                               histogram->count,
+                               histogram->total,
+                               histogram->minimum,
+                               histogram->maximum,
+                               buckets);
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+GVariant *
+login_metrics_get_summary (void)
+{
+    return metrics_to_variant (&global_metrics);
+}
+
+GVariant *
+login_metrics_get_seat_summaries (void)
+{
+    GVariantBuilder builder;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{s" LOGIN_METRICS_SUMMARY_TYPE "}"));
+    if (seat_metrics)
+    {
+        GHashTableIter iter;
+        gpointer key, value;
+
+        g_hash_table_iter_init (&iter, seat_metrics);
+        while (g_hash_table_iter_next (&iter, &key, &value))
+            g_variant_builder_add (&builder, "{s@" LOGIN_METRICS_SUMMARY_TYPE "}", (const gchar *) key, metrics_to_variant (value));
+    }
+
+    return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef LOGIN_METRICS_H_
+#define LOGIN_METRICS_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Phases of the login process that are timed, PAM phases exclude time waiting for the user to answer prompts */
+typedef enum
+{
+    LOGIN_METRIC_GREETER_START,
+    LOGIN_METRIC_DISPLAY_SERVER_READY,
+    LOGIN_METRIC_PAM_AUTHENTICATE,
+    LOGIN_METRIC_PAM_ACCT_MGMT,
+    LOGIN_METRIC_PAM_SETCRED,
+    LOGIN_METRIC_PAM_OPEN_SESSION,
+    LOGIN_METRIC_SESSION_EXEC,
+    LOGIN_METRIC_LOGOUT_TO_GREETER,
+    LOGIN_METRIC_LAST
+} LoginMetric;
+
+/* Number of histogram buckets, bucket n counts durations below 2^n ms and the last bucket everything longer */
+#define LOGIN_METRICS_N_BUCKETS 16
+
+/* D-Bus type of a metrics summary: name -> (count, total, minimum, maximum, buckets) in microseconds */
+#define LOGIN_METRICS_SUMMARY_TYPE "a{s(ttttat)}"
+
+const gchar *login_metrics_get_name (LoginMetric metric);
+
+void login_metrics_record (const gchar *seat_name, LoginMetric metric, gint64 duration);
+
+void login_metrics_record_since (const gchar *seat_name, LoginMetric metric, gint64 start_time);
+
+GVariant *login_metrics_get_summary (void);
+
+GVariant *login_metrics_get_seat_summaries (void);
+
+G_END_DECLS
+
+#endif /* LOGIN_METRICS_H_ */
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+/* Measures how long it takes to spawn and reap a number of concurrent child processes through Process */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "process.h"
+#include "child-watch.h"
+
+static GMainLoop *loop = NULL;
+static guint n_running = 0;
+
+/* Use fork instead of vfork, to compare the two */
+static gboolean use_fork = FALSE;
+
+/* Memory to allocate in the benchmark, as the cost of fork grows with the size of the parent */
+static gint heap_size = 0;
+
+/* Watch children with SIGCHLD instead of pidfds, to compare the two */
+static gboolean use_sigchld = FALSE;
+
+static GOptionEntry options[] =
+{
+    { "fork", 0, 0, G_OPTION_ARG_NONE, &use_fork, "Start processes with fork instead of vfork", NULL },
+    { "sigchld", 0, 0, G_OPTION_ARG_NONE, &use_sigchld, "Watch processes with SIGCHLD instead of pidfds", NULL },
+    { "heap", 0, 0, G_OPTION_ARG_INT, &heap_size, "Megabytes of memory to allocate before starting processes", "MB" },
+    { NULL }
+};
+
+static void
+fork_run_cb (Process *process, gpointer data)
+{
+    /* Having a run function makes Process use fork */
+}
+
+static void
+stopped_cb (Process *process)
+{
+    n_running--;
+    if (n_running == 0)
+        g_main_loop_quit (loop);
+}
+
+static gdouble
+run (guint n_processes, const gchar *command)
+{
+    GPtrArray *processes;
+    gint64 start_time;
+    guint i;
+
+    processes = g_ptr_array_new_with_free_func (g_object_unref);
+
+    start_time = g_get_monotonic_time ();
+    for (i = 0; i < n_processes; i++)
+    {
+        Process *process;
+
+        process = process_new (use_fork ? fork_run_cb : NULL, NULL);
+        process_set_command (process, command);
+        g_signal_connect (process, PROCESS_SIGNAL_STOPPED, G_CALLBACK (stopped_cb), NULL);
+        g_ptr_array_add (processes, process);
+        if (process_start (process, FALSE))
+            n_running++;
+    }
+    if (n_running > 0)
+        g_main_loop_run (loop);
+
+    g_ptr_array_unref (processes);
+
+    return (g_get_monotonic_time () - start_time) / 1000.0;
+}
+
+int
+main (int argc, char **argv)
+{
+    guint n_processes = 100, n_rounds = 5, i;
+    const gchar *command = "true";
+    gdouble total = 0, best = 0;
+    GOptionContext *context;
+    gchar *heap = NULL;
+    GError *error = NULL;
+
+    context = g_option_context_new ("[N-PROCESSES] [N-ROUNDS] [COMMAND]");
+    g_option_context_add_main_entries (context, options, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+        g_printerr ("%s\n", error->message);
+        g_clear_error (&error);
+        g_option_context_free (context);
+        return EXIT_FAILURE;
+    }
+    g_option_context_free (context);
+    if (argc > 1)
+        n_processes = atoi (argv[1]);
+    if (argc > 2)
+        n_rounds = atoi (argv[2]);
+    if (argc > 3)
+        command = argv[3];
+
+#if !defined(GLIB_VERSION_2_36)
+    g_type_init ();
+#endif
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    if (use_sigchld)
+        child_watch_disable_pidfd ();
+
+    /* Set up the signal handlers before timing anything */
+    process_get_current ();
+
+    /* Touch every page so it is mapped and has to be copied by fork */
+    if (heap_size > 0)
+    {
+        gsize length = (gsize) heap_size * 1024 * 1024;
+        heap = g_malloc (length);
+        memset (heap, 1, length);
+    }
+
+    for (i = 0; i < n_rounds; i++)
+    {
+        gdouble duration;
+
+        duration = run (n_processes, command);
+        g_print ("Round %u: %u processes in %.2fms\n", i + 1, n_processes, duration);
+        total += duration;
+        if (i == 0 || duration < best)
+            best = duration;
+    }
+
+    if (n_rounds > 0)
+        g_print ("Average %.2fms, best %.2fms (%.1fus per process)\n", total / n_rounds, best, n_processes > 0 ? best * 1000.0 / n_processes : 0.0);
+
+    g_main_loop_unref (loop);
+    g_free (heap);
+
+    return EXIT_SUCCESS;
+}
@@ -16,11 +16,14 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <pthread.h>
 #include <grp.h>
 #include <config.h>
 
+#include "child-watch.h"
 #include "log-file.h"
 #include "process.h"
+#include "trace.h"
 
 enum {
     GOT_DATA,
@@ -44,6 +47,16 @@ struct ProcessPrivate
     /* Command to run */
     gchar *command;
 
+    /* File descriptors to connect to standard input and output (-1 to inherit) */
+    int stdin_fd;
+    int stdout_fd;
+
+    /* File descriptor to leave open in the child process (-1 for none) */
+    int pass_fd;
+
+    /* Signals to ignore in the child process */
+    sigset_t ignored_signals;
+
     /* TRUE to clear the environment in this process */
     gboolean clear_environment;
 
@@ -63,7 +76,7 @@ struct ProcessPrivate
     guint quit_timeout;
 
     /* Watch on process */
-    guint watch;
+    ChildWatch *watch;
 };
 
 G_DEFINE_TYPE (Process, process, G_TYPE_OBJECT);
@@ -105,6 +118,63 @@ process_set_log_file (Process *process, const gchar *path, gboolean log_stdout,
     process->priv->log_mode = log_mode;
 }
 
+static int
+dup_fd (int fd)
+{
+    /* Keep copies above the standard streams so dup2 in the child never needs to be a no-op */
+    return fcntl (fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+}
+
+void
+process_set_stdin (Process *process, int fd)
+{
+    g_return_if_fail (process != NULL);
+
+    if (process->priv->stdin_fd >= 0)
+        close (process->priv->stdin_fd);
+
+    /* Use /dev/null if no file descriptor provided */
+    if (fd < 0)
+    {
+        int null_fd = open ("/dev/null", O_RDONLY | O_CLOEXEC);
+        process->priv->stdin_fd = dup_fd (null_fd);
+        close (null_fd);
+    }
+    else
+        process->priv->stdin_fd = dup_fd (fd);
+}
+
+void
+process_set_stdout (Process *process, int fd)
+{
+    g_return_if_fail (process != NULL);
+    g_return_if_fail (fd >= 0);
+
+    if (process->priv->stdout_fd >= 0)
+        close (process->priv->stdout_fd);
+    process->priv->stdout_fd = dup_fd (fd);
+}
+
+int
+process_set_pass_fd (Process *process, int fd)
+{
+    g_return_val_if_fail (process != NULL, -1);
+    g_return_val_if_fail (fd >= 0, -1);
+
+    if (process->priv->pass_fd >= 0)
+        close (process->priv->pass_fd);
+    process->priv->pass_fd = dup_fd (fd);
+
+    return process->priv->pass_fd;
+}
+
+void
+process_set_ignore_signal (Process *process, int signum)
+{
+    g_return_if_fail (process != NULL);
+    sigaddset (&process->priv->ignored_signals, signum);
+}
+
 void
 process_set_clear_environment (Process *process, gboolean clear_environment)
 {
@@ -151,12 +221,30 @@ process_get_command (Process *process)
     return process->priv->command;
 }
 
+static void
+trace_process (Process *process, gboolean started)
+{
+    gchar label[64];
+
+    if (!trace_get_enabled ())
+        return;
+
+    g_snprintf (label, sizeof (label), "pid=%d %s", process->priv->pid, process->priv->command);
+    if (started)
+        trace_begin (process, "process", label);
+    else
+        trace_end (process, "process", label);
+}
+
 static void
 process_watch_cb (GPid pid, gint status, gpointer data)
 {
     Process *process = data;
 
-    process->priv->watch = 0;
+    trace_process (process, FALSE);
+
+    child_watch_free (process->priv->watch);
+    process->priv->watch = NULL;
     process->priv->exit_status = status;
 
     if (WIFEXITED (status))
@@ -173,16 +261,107 @@ process_watch_cb (GPid pid, gint status, gpointer data)
     g_signal_emit (process, signals[STOPPED], 0);
 }
 
+static gchar *
+find_program (const gchar *name, gchar **envp)
+{
+    const gchar *path;
+    gchar **dirs;
+    gchar *filename = NULL;
+    int i;
+
+    if (strchr (name, '/'))
+        return g_strdup (name);
+
+    /* Search the path the child will have, as execvp would */
+    path = g_environ_getenv (envp, "PATH");
+    if (!path)
+        path = "/bin:/usr/bin";
+    dirs = g_strsplit (path, ":", -1);
+    for (i = 0; dirs[i] && !filename; i++)
+    {
+        gchar *f;
+
+        f = g_build_filename (dirs[i][0] != '\0' ? dirs[i] : ".", name, NULL);
+        if (g_file_test (f, G_FILE_TEST_IS_EXECUTABLE) && !g_file_test (f, G_FILE_TEST_IS_DIR))
+            filename = f;
+        else
+            g_free (f);
+    }
+    g_strfreev (dirs);
+
+    /* Let exec fail in the child if not found */
+    if (!filename)
+        filename = g_strdup (name);
+
+    return filename;
+}
+
+/* These run in the child after fork or vfork - only async-signal-safe calls that don't touch the heap */
+
+static void
+reset_child_signals (Process *process, const sigset_t *mask)
+{
+    int signum;
+
+    /* Drop the daemon's handlers while signals are still blocked, with vfork they would run on the daemon's memory */
+    for (signum = 1; signum < NSIG; signum++)
+    {
+        struct sigaction action;
+
+        if (sigaction (signum, NULL, &action) == 0 && action.sa_handler != SIG_DFL && action.sa_handler != SIG_IGN)
+            signal (signum, SIG_DFL);
+        if (sigismember (&process->priv->ignored_signals, signum) == 1)
+            signal (signum, SIG_IGN);
+    }
+
+    /* Reset SIGPIPE handler so the child has default behaviour (we disabled it at LightDM start) */
+    signal (SIGPIPE, SIG_DFL);
+
+    /* Children have always ignored SIGHUP, keep that now the daemon uses it to reload */
+    signal (SIGHUP, SIG_IGN);
+
+    pthread_sigmask (SIG_SETMASK, mask, NULL);
+}
+
+static void
+exec_child (Process *process, const gchar *path, gchar **argv, gchar **sh_argv, gchar **envp, int log_fd)
+{
+    if (process->priv->stdin_fd >= 0)
+        dup2 (process->priv->stdin_fd, STDIN_FILENO);
+    if (process->priv->stdout_fd >= 0)
+        dup2 (process->priv->stdout_fd, STDOUT_FILENO);
+    if (process->priv->pass_fd >= 0)
+        fcntl (process->priv->pass_fd, F_SETFD, 0);
+
+    /* Redirect output to logfile */
+    if (log_fd >= 0)
+    {
+         if (process->priv->log_stdout)
+             dup2 (log_fd, STDOUT_FILENO);
+         dup2 (log_fd, STDERR_FILENO);
+    }
+
+    execve (path, argv, envp);
+
+    /* Run scripts without a #! line with the shell, as execvp would */
+    if (errno == ENOEXEC)
+        execve ("/bin/sh", sh_argv, envp);
+    _exit (EXIT_FAILURE);
+}
+
 gboolean
 process_start (Process *process, gboolean block)
 {
     gint argc;
     gchar **argv;
-    gchar **env_keys, **env_values;
-    guint i, env_length;
-    GList *keys, *link;
+    gchar **sh_argv;
+    gchar **envp;
+    gchar *path;
+    GHashTableIter iter;
+    gpointer key, value;
     pid_t pid;
     int log_fd = -1;
+    sigset_t all_signals, old_mask;
     GError *error = NULL;
 
     g_return_val_if_fail (process != NULL, FALSE);
@@ -196,57 +375,69 @@ process_start (Process *process, gboolean block)
     }
 
     if (process->priv->log_file)
-        log_fd = log_file_open (process->priv->log_file, process->priv->log_mode);
-
-    /* Work out variables to set */
-    env_length = g_hash_table_size (process->priv->env);
-    env_keys = g_malloc (sizeof (gchar *) * env_length);
-    env_values = g_malloc (sizeof (gchar *) * env_length);
-    keys = g_hash_table_get_keys (process->priv->env);
-    for (i = 0, link = keys; i < env_length; i++, link = link->next)
     {
-        env_keys[i] = link->data;
-        env_values[i] = g_hash_table_lookup (process->priv->env, env_keys[i]);
+        log_fd = log_file_open (process->priv->log_file, process->priv->log_mode);
+        if (log_fd >= 0)
+            fcntl (log_fd, F_SETFD, FD_CLOEXEC);
     }
-    g_list_free (keys);
 
-    pid = fork ();
-    if (pid == 0)
+    /* Build the environment now so the child doesn't have to allocate */
+    if (process->priv->clear_environment)
+        envp = g_new0 (gchar *, 1);
+    else
+        envp = g_get_environ ();
+    g_hash_table_iter_init (&iter, process->priv->env);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        envp = g_environ_setenv (envp, key, value, TRUE);
+
+    path = find_program (argv[0], envp);
+
+    /* Arguments to run the program with the shell if it turns out not to be executable */
+    sh_argv = g_new (gchar *, argc + 2);
+    sh_argv[0] = (gchar *) "/bin/sh";
+    sh_argv[1] = path;
+    memcpy (sh_argv + 2, argv + 1, sizeof (gchar *) * argc);
+
+    /* Block signals until the child has reset its handlers */
+    sigfillset (&all_signals);
+    pthread_sigmask (SIG_SETMASK, &all_signals, &old_mask);
+
+    /* Custom setup can run arbitrary code so needs a full copy of the process.
+     * Otherwise use vfork which avoids copying the page tables of the daemon */
+    if (process->priv->run_func)
     {
-        /* Do custom setup */
-        if (process->priv->run_func)
+        pid = fork ();
+        if (pid == 0)
+        {
+            reset_child_signals (process, &old_mask);
             process->priv->run_func (process, process->priv->run_func_data);
-
-        /* Redirect output to logfile */
-        if (log_fd >= 0)
+            exec_child (process, path, argv, sh_argv, envp, log_fd);
+        }
+    }
+    else
+    {
+        pid = vfork ();
+        if (pid == 0)
         {
-             if (process->priv->log_stdout)
-                 dup2 (log_fd, STDOUT_FILENO);
-             dup2 (log_fd, STDERR_FILENO);
-             close (log_fd);
+            reset_child_signals (process, &old_mask);
+            exec_child (process, path, argv, sh_argv, envp, log_fd);
         }
-
-        /* Set environment */
-        if (process->priv->clear_environment)
-#ifdef HAVE_CLEARENV
-            clearenv ();
-#else
-            environ = NULL;
-#endif
-        for (i = 0; i < env_length; i++)
-            setenv (env_keys[i], env_values[i], TRUE);
-
-        /* Reset SIGPIPE handler so the child has default behaviour (we disabled it at LightDM start) */
-        signal (SIGPIPE, SIG_DFL);
-
-        execvp (argv[0], argv);
-        _exit (EXIT_FAILURE);
     }
 
-    close (log_fd);
+    pthread_sigmask (SIG_SETMASK, &old_mask, NULL);
+
+    if (log_fd >= 0)
+        close (log_fd);
+    /* Only the child should hold this open so the other end sees it close */
+    if (process->priv->pass_fd >= 0)
+    {
+        close (process->priv->pass_fd);
+        process->priv->pass_fd = -1;
+    }
     g_strfreev (argv);
-    g_free (env_keys);
-    g_free (env_values);
+    g_free (sh_argv);
+    g_strfreev (envp);
+    g_free (path);
 
     if (pid < 0)
     {
@@ -257,6 +448,7 @@ process_start (Process *process, gboolean block)
     g_debug ("Launching process %d: %s", pid, process->priv->command);
 
     process->priv->pid = pid;
+    trace_process (process, TRUE);
 
     if (block)
     {
@@ -267,7 +459,7 @@ process_start (Process *process, gboolean block)
     else
     {
         g_hash_table_insert (processes, GINT_TO_POINTER (process->priv->pid), g_object_ref (process));
-        process->priv->watch = g_child_watch_add (process->priv->pid, process_watch_cb, process);
+        process->priv->watch = child_watch_new (process->priv->pid, process_watch_cb, process);
     }
 
     return TRUE;
@@ -297,7 +489,8 @@ process_signal (Process *process, int signum)
 
     g_debug ("Sending signal %d to process %d", signum, process->priv->pid);
 
-    if (kill (process->priv->pid, signum) < 0)
+    /* Signal through the watch where possible so we can't hit a process that has reused the pid */
+    if (!(process->priv->watch ? child_watch_signal (process->priv->watch, signum) : kill (process->priv->pid, signum) == 0))
     {
         /* Ignore ESRCH, we will pick that up in our wait */
         if (errno != ESRCH)
@@ -343,6 +536,10 @@ process_init (Process *process)
 {
     process->priv = G_TYPE_INSTANCE_GET_PRIVATE (process, PROCESS_TYPE, ProcessPrivate);
     process->priv->env = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    process->priv->stdin_fd = -1;
+    process->priv->stdout_fd = -1;
+    process->priv->pass_fd = -1;
+    sigemptyset (&process->priv->ignored_signals);
 }
 
 static void
@@ -361,13 +558,20 @@ process_finalize (GObject *object)
     g_free (self->priv->log_file);
     g_free (self->priv->command);
     g_hash_table_unref (self->priv->env);
+    if (self->priv->stdin_fd >= 0)
+        close (self->priv->stdin_fd);
+    if (self->priv->stdout_fd >= 0)
+        close (self->priv->stdout_fd);
+    if (self->priv->pass_fd >= 0)
+        close (self->priv->pass_fd);
     if (self->priv->quit_timeout)
         g_source_remove (self->priv->quit_timeout);
-    if (self->priv->watch)
-        g_source_remove (self->priv->watch);
 
-    if (self->priv->pid)
+    if (self->priv->watch)
+        child_watch_signal (self->priv->watch, SIGTERM);
+    else if (self->priv->pid)
         kill (self->priv->pid, SIGTERM);
+    child_watch_free (self->priv->watch);
 
     G_OBJECT_CLASS (process_parent_class)->finalize (object);
 }
@@ -463,4 +667,5 @@ process_class_init (ProcessClass *klass)
     sigaction (SIGINT, &action, NULL);
     sigaction (SIGUSR1, &action, NULL);
     sigaction (SIGUSR2, &action, NULL);
+    sigaction (SIGHUP, &action, NULL);
 }
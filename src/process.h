@@ -53,6 +53,14 @@ Process *process_new (ProcessRunFunc run_func, gpointer run_func_data);
 
 void process_set_log_file (Process *process, const gchar *path, gboolean log_stdout, LogMode log_mode);
 
+void process_set_stdin (Process *process, int fd);
+
+void process_set_stdout (Process *process, int fd);
+
+int process_set_pass_fd (Process *process, int fd);
+
+void process_set_ignore_signal (Process *process, int signum);
+
 void process_set_clear_environment (Process *process, gboolean clear_environment);
 
 gboolean process_get_clear_environment (Process *process);
@@ -43,7 +43,7 @@ static void
 seat_local_setup (Seat *seat)
 {
     seat_set_supports_multi_session (seat, TRUE);
-    seat_set_share_display_server (seat, seat_get_boolean_property (seat, "xserver-share"));
+    seat_set_share_display_server (seat, seat_get_boolean (seat, SEAT_PROPERTY_XSERVER_SHARE));
     SEAT_CLASS (seat_local_parent_class)->setup (seat);
 }
 
@@ -85,7 +85,7 @@ seat_local_start (Seat *seat)
     const gchar *xdmcp_manager = NULL;
 
     /* If running as an XDMCP client then just start an X server */
-    xdmcp_manager = seat_get_string_property (seat, "xdmcp-manager");
+    xdmcp_manager = seat_get_string (seat, SEAT_PROPERTY_XDMCP_MANAGER);
     if (xdmcp_manager)
     {
         SeatLocal *s = SEAT_LOCAL (seat);
@@ -94,10 +94,10 @@ seat_local_start (Seat *seat)
 
         s->priv->xdmcp_x_server = create_x_server (s);
         x_server_local_set_xdmcp_server (s->priv->xdmcp_x_server, xdmcp_manager);
-        port = seat_get_integer_property (seat, "xdmcp-port");
+        port = seat_get_integer (seat, SEAT_PROPERTY_XDMCP_PORT);
         if (port > 0)
             x_server_local_set_xdmcp_port (s->priv->xdmcp_x_server, port);
-        key_name = seat_get_string_property (seat, "xdmcp-key");
+        key_name = seat_get_string (seat, SEAT_PROPERTY_XDMCP_KEY);
         if (key_name)
         {
             gchar *path;
@@ -197,11 +197,11 @@ get_unity_system_compositor (SeatLocal *seat)
 
     seat->priv->compositor = unity_system_compositor_new ();
 
-    command = seat_get_string_property (SEAT (seat), "unity-compositor-command");
+    command = seat_get_string (SEAT (seat), SEAT_PROPERTY_UNITY_COMPOSITOR_COMMAND);
     if (command)
         unity_system_compositor_set_command (seat->priv->compositor, command);
 
-    timeout = seat_get_integer_property (SEAT (seat), "unity-compositor-timeout");
+    timeout = seat_get_integer (SEAT (seat), SEAT_PROPERTY_UNITY_COMPOSITOR_TIMEOUT);
     if (timeout <= 0)
         timeout = 60;
     unity_system_compositor_set_timeout (seat->priv->compositor, timeout);
@@ -227,7 +227,7 @@ create_x_server (SeatLocal *seat)
     gboolean allow_tcp;
     gint vt;
 
-    x_server_backend = seat_get_string_property (SEAT (seat), "xserver-backend");
+    x_server_backend = seat_get_string (SEAT (seat), SEAT_PROPERTY_XSERVER_BACKEND);
     if (g_strcmp0 (x_server_backend, "mir") == 0)
     {
         UnitySystemCompositor *compositor;
@@ -237,7 +237,7 @@ create_x_server (SeatLocal *seat)
         compositor = get_unity_system_compositor (SEAT_LOCAL (seat));
         x_server = X_SERVER_LOCAL (x_server_xmir_new (compositor));
 
-        command = seat_get_string_property (SEAT (seat), "xmir-command");
+        command = seat_get_string (SEAT (seat), SEAT_PROPERTY_XMIR_COMMAND);
         if (command)
             x_server_local_set_command (x_server, command);
 
@@ -266,7 +266,7 @@ create_x_server (SeatLocal *seat)
         if (g_getenv ("DISPLAY"))
             command = "Xephyr";
         if (!command)
-            command = seat_get_string_property (SEAT (seat), "xserver-command");
+            command = seat_get_string (SEAT (seat), SEAT_PROPERTY_XSERVER_COMMAND);
         if (command)
             x_server_local_set_command (x_server, command);
     }
@@ -277,17 +277,17 @@ create_x_server (SeatLocal *seat)
     g_free (number);
     g_object_unref (cookie);
 
-    layout = seat_get_string_property (SEAT (seat), "xserver-layout");
+    layout = seat_get_string (SEAT (seat), SEAT_PROPERTY_XSERVER_LAYOUT);
     if (layout)
         x_server_local_set_layout (x_server, layout);
 
     x_server_local_set_xdg_seat (x_server, seat_get_name (SEAT (seat)));
 
-    config_file = seat_get_string_property (SEAT (seat), "xserver-config");
+    config_file = seat_get_string (SEAT (seat), SEAT_PROPERTY_XSERVER_CONFIG);
     if (config_file)
         x_server_local_set_config (x_server, config_file);
 
-    allow_tcp = seat_get_boolean_property (SEAT (seat), "xserver-allow-tcp");
+    allow_tcp = seat_get_boolean (SEAT (seat), SEAT_PROPERTY_XSERVER_ALLOW_TCP);
     x_server_local_set_allow_tcp (x_server, allow_tcp);
 
     return x_server;
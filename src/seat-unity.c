@@ -79,7 +79,7 @@ compositor_ready_cb (UnitySystemCompositor *compositor, SeatUnity *seat)
     l_debug (seat, "Compositor ready");
 
     /* If running as an XDMCP client then just start an X server */
-    xdmcp_manager = seat_get_string_property (SEAT (seat), "xdmcp-manager");
+    xdmcp_manager = seat_get_string (SEAT (seat), SEAT_PROPERTY_XDMCP_MANAGER);
     if (xdmcp_manager)
     {
         const gchar *key_name = NULL;
@@ -87,10 +87,10 @@ compositor_ready_cb (UnitySystemCompositor *compositor, SeatUnity *seat)
 
         seat->priv->xdmcp_x_server = create_x_server (SEAT (seat));
         x_server_local_set_xdmcp_server (X_SERVER_LOCAL (seat->priv->xdmcp_x_server), xdmcp_manager);
-        port = seat_get_integer_property (SEAT (seat), "xdmcp-port");
+        port = seat_get_integer (SEAT (seat), SEAT_PROPERTY_XDMCP_PORT);
         if (port > 0)
             x_server_local_set_xdmcp_port (X_SERVER_LOCAL (seat->priv->xdmcp_x_server), port);
-        key_name = seat_get_string_property (SEAT (seat), "xdmcp-key");
+        key_name = seat_get_string (SEAT (seat), SEAT_PROPERTY_XDMCP_KEY);
         if (key_name)
         {
             gchar *path;
@@ -173,14 +173,14 @@ seat_unity_start (Seat *seat)
         return FALSE;
     }
 
-    timeout = seat_get_integer_property (SEAT (seat), "unity-compositor-timeout");
+    timeout = seat_get_integer (SEAT (seat), SEAT_PROPERTY_UNITY_COMPOSITOR_TIMEOUT);
     if (timeout <= 0)
         timeout = 60;
 
     SEAT_UNITY (seat)->priv->compositor = unity_system_compositor_new ();
     g_signal_connect (SEAT_UNITY (seat)->priv->compositor, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (compositor_ready_cb), seat);
     g_signal_connect (SEAT_UNITY (seat)->priv->compositor, DISPLAY_SERVER_SIGNAL_STOPPED, G_CALLBACK (compositor_stopped_cb), seat);
-    unity_system_compositor_set_command (SEAT_UNITY (seat)->priv->compositor, seat_get_string_property (SEAT (seat), "unity-compositor-command"));
+    unity_system_compositor_set_command (SEAT_UNITY (seat)->priv->compositor, seat_get_string (SEAT (seat), SEAT_PROPERTY_UNITY_COMPOSITOR_COMMAND));
     unity_system_compositor_set_vt (SEAT_UNITY (seat)->priv->compositor, vt);
     unity_system_compositor_set_timeout (SEAT_UNITY (seat)->priv->compositor, timeout);
 
@@ -201,7 +201,7 @@ create_x_server (Seat *seat)
 
     x_server = x_server_xmir_new (SEAT_UNITY (seat)->priv->compositor);
 
-    command = seat_get_string_property (seat, "xmir-command");
+    command = seat_get_string (seat, SEAT_PROPERTY_XMIR_COMMAND);
     x_server_local_set_command (X_SERVER_LOCAL (x_server), command);
 
     id = g_strdup_printf ("x-%d", SEAT_UNITY (seat)->priv->next_x_server_id);
@@ -216,17 +216,17 @@ create_x_server (Seat *seat)
     g_free (number);
     g_object_unref (cookie);
 
-    layout = seat_get_string_property (seat, "xserver-layout");
+    layout = seat_get_string (seat, SEAT_PROPERTY_XSERVER_LAYOUT);
     if (layout)
         x_server_local_set_layout (X_SERVER_LOCAL (x_server), layout);
 
     x_server_local_set_xdg_seat (X_SERVER_LOCAL (x_server), seat_get_name (seat));
 
-    config_file = seat_get_string_property (seat, "xserver-config");
+    config_file = seat_get_string (seat, SEAT_PROPERTY_XSERVER_CONFIG);
     if (config_file)
         x_server_local_set_config (X_SERVER_LOCAL (x_server), config_file);
 
-    allow_tcp = seat_get_boolean_property (seat, "xserver-allow-tcp");
+    allow_tcp = seat_get_boolean (seat, SEAT_PROPERTY_XSERVER_ALLOW_TCP);
     x_server_local_set_allow_tcp (X_SERVER_LOCAL (x_server), allow_tcp);
 
     return x_server;
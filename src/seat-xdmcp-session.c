@@ -22,6 +22,13 @@ struct SeatXDMCPSessionPrivate
 
 G_DEFINE_TYPE (SeatXDMCPSession, seat_xdmcp_session, SEAT_TYPE);
 
+static void
+session_expired_cb (XDMCPSession *session, SeatXDMCPSession *seat)
+{
+    l_debug (seat, "Remote display stopped responding");
+    seat_stop (SEAT (seat));
+}
+
 SeatXDMCPSession *
 seat_xdmcp_session_new (XDMCPSession *session)
 {
@@ -29,6 +36,7 @@ seat_xdmcp_session_new (XDMCPSession *session)
 
     seat = g_object_new (SEAT_XDMCP_SESSION_TYPE, NULL);
     seat->priv->session = g_object_ref (session);
+    g_signal_connect (session, XDMCP_SESSION_SIGNAL_EXPIRED, G_CALLBACK (session_expired_cb), seat);
 
     return seat;
 }
@@ -51,6 +59,13 @@ seat_xdmcp_session_create_display_server (Seat *seat, Session *session)
     return DISPLAY_SERVER (x_server);
 }
 
+static void
+seat_xdmcp_session_stopped (Seat *seat)
+{
+    /* Let the XDMCP server know the display is no longer being managed */
+    xdmcp_session_stop (SEAT_XDMCP_SESSION (seat)->priv->session);
+}
+
 static void
 seat_xdmcp_session_init (SeatXDMCPSession *seat)
 {
@@ -62,6 +77,8 @@ seat_xdmcp_session_finalize (GObject *object)
 {
     SeatXDMCPSession *self = SEAT_XDMCP_SESSION (object);
 
+    if (self->priv->session)
+        g_signal_handlers_disconnect_matched (self->priv->session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
     g_clear_object (&self->priv->session);
 
     G_OBJECT_CLASS (seat_xdmcp_session_parent_class)->finalize (object);
@@ -74,6 +91,7 @@ seat_xdmcp_session_class_init (SeatXDMCPSessionClass *klass)
     GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
     seat_class->create_display_server = seat_xdmcp_session_create_display_server;
+    seat_class->stopped = seat_xdmcp_session_stopped;
     object_class->finalize = seat_xdmcp_session_finalize;
 
     g_type_class_add_private (klass, sizeof (SeatXDMCPSessionPrivate));
@@ -19,6 +19,7 @@ G_BEGIN_DECLS
 
 #define SEAT_XDMCP_SESSION_TYPE (seat_xdmcp_session_get_type())
 #define SEAT_XDMCP_SESSION(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), SEAT_XDMCP_SESSION_TYPE, SeatXDMCPSession))
+#define IS_SEAT_XDMCP_SESSION(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SEAT_XDMCP_SESSION_TYPE))
 
 typedef struct SeatXDMCPSessionPrivate SeatXDMCPSessionPrivate;
 
@@ -39,8 +39,8 @@ seat_xremote_create_display_server (Seat *seat, Session *session)
         return NULL;
     }
 
-    hostname = seat_get_string_property (seat, "xserver-hostname");
-    number = seat_get_integer_property (seat, "xserver-display-number");
+    hostname = seat_get_string (seat, SEAT_PROPERTY_XSERVER_HOSTNAME);
+    number = seat_get_integer (seat, SEAT_PROPERTY_XSERVER_DISPLAY_NUMBER);
 
     l_debug (seat, "Starting remote X display %s:%d", hostname ? hostname : "", number);
 
@@ -11,6 +11,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 #include <sys/wait.h>
 
 #include "seat.h"
@@ -18,11 +19,13 @@
 #include "guest-account.h"
 #include "greeter-session.h"
 #include "session-config.h"
+#include "trace.h"
 
 enum {
     SESSION_ADDED,
     RUNNING_USER_SESSION,
     SESSION_REMOVED,
+    SPARE_GREETER_CHANGED,
     STOPPED,
     LAST_SIGNAL
 };
@@ -34,7 +37,7 @@ struct SeatPrivate
     gchar *name;
 
     /* Configuration for this seat */
-    GHashTable *properties;
+    SeatProperties *properties;
 
     /* TRUE if this seat can run multiple sessions at once */
     gboolean supports_multi_session;
@@ -48,6 +51,9 @@ struct SeatPrivate
     /* The sessions on this seat */
     GList *sessions;
 
+    /* Setup and cleanup scripts that are running */
+    GList *scripts;
+
     /* The last session set to active */
     Session *active_session;
 
@@ -68,6 +74,115 @@ struct SeatPrivate
     
     /* The greeter to be started to replace the current one */
     GreeterSession *replacement_greeter;
+
+    /* Time the active user session stopped and we went back to the greeter */
+    gint64 logout_time;
+
+    /* Greeter kept running in the background to hand out on lock or switch */
+    GreeterSession *spare_greeter;
+
+    /* TRUE once the spare greeter has connected and can be handed out */
+    gboolean spare_greeter_ready;
+
+    /* TRUE if spare greeters can't be used on this seat */
+    gboolean spare_greeter_failed;
+
+    /* Idle source to start a spare greeter */
+    guint spare_greeter_idle;
+};
+
+typedef enum
+{
+    PROPERTY_TYPE_STRING,
+    PROPERTY_TYPE_BOOLEAN,
+    PROPERTY_TYPE_INTEGER,
+    PROPERTY_TYPE_STRING_LIST
+} PropertyType;
+
+typedef struct
+{
+    const gchar *name;
+    PropertyType type;
+} PropertySchema;
+
+/* Properties seats know about, these are parsed once when set */
+static const PropertySchema property_schema[] =
+{
+    [SEAT_PROPERTY_ALLOW_GUEST]                    = { "allow-guest",                     PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_ALLOW_USER_SWITCHING]           = { "allow-user-switching",            PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_AUTOLOGIN_GUEST]                = { "autologin-guest",                 PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_AUTOLOGIN_IN_BACKGROUND]        = { "autologin-in-background",         PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_AUTOLOGIN_PIPELINED]            = { "autologin-pipelined",             PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_AUTOLOGIN_SESSION]              = { "autologin-session",               PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_AUTOLOGIN_USER]                 = { "autologin-user",                  PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_AUTOLOGIN_USER_TIMEOUT]         = { "autologin-user-timeout",          PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_DISPLAY_SETUP_SCRIPT]           = { "display-setup-script",            PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_DISPLAY_SETUP_SCRIPT_TIMEOUT]   = { "display-setup-script-timeout",    PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_DISPLAY_STOPPED_SCRIPT]         = { "display-stopped-script",          PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_DISPLAY_STOPPED_SCRIPT_TIMEOUT] = { "display-stopped-script-timeout",  PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_EXIT_ON_FAILURE]                = { "exit-on-failure",                 PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_GREETER_ALLOW_GUEST]            = { "greeter-allow-guest",             PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_GREETER_HIDE_USERS]             = { "greeter-hide-users",              PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_GREETER_SESSION]                = { "greeter-session",                 PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_GREETER_SETUP_SCRIPT]           = { "greeter-setup-script",            PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_GREETER_SETUP_SCRIPT_TIMEOUT]   = { "greeter-setup-script-timeout",    PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_GREETER_SHOW_MANUAL_LOGIN]      = { "greeter-show-manual-login",       PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_GREETER_SHOW_REMOTE_LOGIN]      = { "greeter-show-remote-login",       PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_GREETER_WRAPPER]                = { "greeter-wrapper",                 PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_GUEST_SESSION]                  = { "guest-session",                   PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_GUEST_WRAPPER]                  = { "guest-wrapper",                   PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_PAM_AUTOLOGIN_SERVICE]          = { "pam-autologin-service",           PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_PAM_GREETER_SERVICE]            = { "pam-greeter-service",             PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_PAM_SERVICE]                    = { "pam-service",                     PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_SCRIPT_KILL_POLICY]             = { "script-kill-policy",              PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_SESSION_CLEANUP_SCRIPT]         = { "session-cleanup-script",          PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_SESSION_CLEANUP_SCRIPT_TIMEOUT] = { "session-cleanup-script-timeout",  PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_SESSION_SETUP_SCRIPT]           = { "session-setup-script",            PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_SESSION_SETUP_SCRIPT_TIMEOUT]   = { "session-setup-script-timeout",    PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_SESSION_WRAPPER]                = { "session-wrapper",                 PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_SPARE_GREETER]                  = { "spare-greeter",                   PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_TYPE]                           = { "type",                            PROPERTY_TYPE_STRING_LIST },
+    [SEAT_PROPERTY_UNITY_COMPOSITOR_COMMAND]       = { "unity-compositor-command",        PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_UNITY_COMPOSITOR_TIMEOUT]       = { "unity-compositor-timeout",        PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_USER_SESSION]                   = { "user-session",                    PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XDMCP_KEY]                      = { "xdmcp-key",                       PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XDMCP_MANAGER]                  = { "xdmcp-manager",                   PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XDMCP_PORT]                     = { "xdmcp-port",                      PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_XMIR_COMMAND]                   = { "xmir-command",                    PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XSERVER_ALLOW_TCP]              = { "xserver-allow-tcp",               PROPERTY_TYPE_BOOLEAN },
+    [SEAT_PROPERTY_XSERVER_BACKEND]                = { "xserver-backend",                 PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XSERVER_COMMAND]                = { "xserver-command",                 PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XSERVER_CONFIG]                 = { "xserver-config",                  PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XSERVER_DISPLAY_NUMBER]         = { "xserver-display-number",          PROPERTY_TYPE_INTEGER },
+    [SEAT_PROPERTY_XSERVER_HOSTNAME]               = { "xserver-hostname",                PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XSERVER_LAYOUT]                 = { "xserver-layout",                  PROPERTY_TYPE_STRING },
+    [SEAT_PROPERTY_XSERVER_SHARE]                  = { "xserver-share",                   PROPERTY_TYPE_BOOLEAN }
+};
+#define N_SCHEMA_PROPERTIES SEAT_N_PROPERTIES
+
+/* Index into property_schema for each property name */
+static GHashTable *schema_index = NULL;
+
+typedef struct
+{
+    /* Value as set, NULL if not set */
+    gchar *string;
+
+    /* Value parsed as the type in the schema */
+    gboolean boolean;
+    gint integer;
+    gchar **list;
+} PropertyValue;
+
+struct SeatProperties
+{
+    gint ref_count;
+
+    /* Properties in the schema, indexed the same as property_schema */
+    PropertyValue values[N_SCHEMA_PROPERTIES];
+
+    /* Other properties (string values) */
+    GHashTable *extra;
 };
 
 static void seat_logger_iface_init (LoggerInterface *iface);
@@ -85,9 +200,11 @@ static GHashTable *seat_modules = NULL;
 
 // FIXME: Make a get_display_server() that re-uses display servers if supported
 static DisplayServer *create_display_server (Seat *seat, Session *session);
+static void add_display_server (Seat *seat, DisplayServer *display_server);
 static gboolean start_display_server (Seat *seat, DisplayServer *display_server);
 static GreeterSession *create_greeter_session (Seat *seat);
 static void start_session (Seat *seat, Session *session);
+static void queue_spare_greeter (Seat *seat);
 
 static void
 free_seat_module (gpointer data)
@@ -132,52 +249,286 @@ seat_new (const gchar *module_name, const gchar *name)
     return seat;
 }
 
+static gint
+get_schema_index (const gchar *name)
+{
+    gpointer value;
+
+    if (!schema_index)
+    {
+        guint i;
+
+        schema_index = g_hash_table_new (g_str_hash, g_str_equal);
+        for (i = 0; i < N_SCHEMA_PROPERTIES; i++)
+            g_hash_table_insert (schema_index, (gpointer) property_schema[i].name, GINT_TO_POINTER (i + 1));
+    }
+
+    value = g_hash_table_lookup (schema_index, name);
+    return value ? GPOINTER_TO_INT (value) - 1 : -1;
+}
+
+static gboolean
+parse_boolean (const gchar *value)
+{
+    gint i, length = 0;
+
+    if (!value)
+        return FALSE;
+
+    /* Count the number of non-whitespace characters */
+    for (i = 0; value[i]; i++)
+        if (!g_ascii_isspace (value[i]))
+            length = i + 1;
+
+    return strncmp (value, "true", MAX (length, 4)) == 0;
+}
+
+static gint
+parse_integer (const gchar *value)
+{
+    return value ? atoi (value) : 0;
+}
+
+static gchar **
+parse_string_list (const gchar *value)
+{
+    return value ? g_strsplit (value, ";", 0) : NULL;
+}
+
+static void
+property_value_set (PropertyValue *value, PropertyType type, const gchar *string)
+{
+    g_free (value->string);
+    value->string = g_strdup (string);
+    g_strfreev (value->list);
+    value->list = NULL;
+
+    switch (type)
+    {
+    case PROPERTY_TYPE_STRING:
+        break;
+    case PROPERTY_TYPE_BOOLEAN:
+        value->boolean = parse_boolean (string);
+        break;
+    case PROPERTY_TYPE_INTEGER:
+        value->integer = parse_integer (string);
+        break;
+    case PROPERTY_TYPE_STRING_LIST:
+        value->list = parse_string_list (string);
+        break;
+    }
+}
+
+SeatProperties *
+seat_properties_new (void)
+{
+    SeatProperties *properties;
+
+    properties = g_malloc0 (sizeof (SeatProperties));
+    properties->ref_count = 1;
+    properties->extra = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    return properties;
+}
+
+SeatProperties *
+seat_properties_ref (SeatProperties *properties)
+{
+    g_return_val_if_fail (properties != NULL, NULL);
+    properties->ref_count++;
+    return properties;
+}
+
+void
+seat_properties_unref (SeatProperties *properties)
+{
+    guint i;
+
+    if (!properties)
+        return;
+
+    properties->ref_count--;
+    if (properties->ref_count > 0)
+        return;
+
+    for (i = 0; i < N_SCHEMA_PROPERTIES; i++)
+    {
+        g_free (properties->values[i].string);
+        g_strfreev (properties->values[i].list);
+    }
+    g_hash_table_unref (properties->extra);
+    g_free (properties);
+}
+
+void
+seat_properties_set (SeatProperties *properties, const gchar *name, const gchar *value)
+{
+    gint index;
+
+    g_return_if_fail (properties != NULL);
+    g_return_if_fail (name != NULL);
+
+    index = get_schema_index (name);
+    if (index >= 0)
+        property_value_set (&properties->values[index], property_schema[index].type, value);
+    else
+        g_hash_table_insert (properties->extra, g_strdup (name), g_strdup (value));
+}
+
+static void
+copy_properties (SeatProperties *from, SeatProperties *to)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    guint i;
+
+    for (i = 0; i < N_SCHEMA_PROPERTIES; i++)
+        if (from->values[i].string)
+            property_value_set (&to->values[i], property_schema[i].type, from->values[i].string);
+    g_hash_table_iter_init (&iter, from->extra);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        g_hash_table_insert (to->extra, g_strdup (key), g_strdup (value));
+}
+
+static gboolean
+properties_are_empty (SeatProperties *properties)
+{
+    guint i;
+
+    for (i = 0; i < N_SCHEMA_PROPERTIES; i++)
+        if (properties->values[i].string)
+            return FALSE;
+
+    return g_hash_table_size (properties->extra) == 0;
+}
+
+/* Get a copy of the seat properties that we can modify */
+static SeatProperties *
+get_writable_properties (Seat *seat)
+{
+    SeatProperties *properties;
+
+    if (seat->priv->properties->ref_count == 1)
+        return seat->priv->properties;
+
+    properties = seat_properties_new ();
+    copy_properties (seat->priv->properties, properties);
+    seat_properties_unref (seat->priv->properties);
+    seat->priv->properties = properties;
+
+    return properties;
+}
+
+void
+seat_set_properties (Seat *seat, SeatProperties *properties)
+{
+    g_return_if_fail (seat != NULL);
+    g_return_if_fail (properties != NULL);
+
+    /* Share the properties if we have none of our own, otherwise they override ours */
+    if (properties_are_empty (seat->priv->properties))
+    {
+        seat_properties_ref (properties);
+        seat_properties_unref (seat->priv->properties);
+        seat->priv->properties = properties;
+    }
+    else
+        copy_properties (properties, get_writable_properties (seat));
+}
+
 void
 seat_set_property (Seat *seat, const gchar *name, const gchar *value)
 {
     g_return_if_fail (seat != NULL);
-    g_hash_table_insert (seat->priv->properties, g_strdup (name), g_strdup (value));
+    seat_properties_set (get_writable_properties (seat), name, value);
 }
 
 const gchar *
 seat_get_string_property (Seat *seat, const gchar *name)
 {
+    gint index;
+
     g_return_val_if_fail (seat != NULL, NULL);
-    return g_hash_table_lookup (seat->priv->properties, name);
+
+    index = get_schema_index (name);
+    if (index >= 0)
+        return seat_get_string (seat, index);
+    else
+        return g_hash_table_lookup (seat->priv->properties->extra, name);
 }
 
 gchar **
 seat_get_string_list_property (Seat *seat, const gchar *name)
 {
+    gint index;
+
     g_return_val_if_fail (seat != NULL, NULL);
-    return g_strsplit (g_hash_table_lookup (seat->priv->properties, name), ";", 0);
+
+    index = get_schema_index (name);
+    if (index >= 0 && property_schema[index].type == PROPERTY_TYPE_STRING_LIST)
+        return seat_get_string_list (seat, index);
+    else
+        return parse_string_list (seat_get_string_property (seat, name));
 }
 
 gboolean
 seat_get_boolean_property (Seat *seat, const gchar *name)
 {
-    const gchar *value;
-    gint i, length = 0;
+    gint index;
 
-    value = seat_get_string_property (seat, name);
-    if (!value)
-        return FALSE;
-
-    /* Count the number of non-whitespace characters */
-    for (i = 0; value[i]; i++)
-        if (!g_ascii_isspace (value[i]))
-            length = i + 1;
+    g_return_val_if_fail (seat != NULL, FALSE);
 
-    return strncmp (value, "true", MAX (length, 4)) == 0;
+    index = get_schema_index (name);
+    if (index >= 0 && property_schema[index].type == PROPERTY_TYPE_BOOLEAN)
+        return seat_get_boolean (seat, index);
+    else
+        return parse_boolean (seat_get_string_property (seat, name));
 }
 
 gint
 seat_get_integer_property (Seat *seat, const gchar *name)
 {
-    const gchar *value;
+    gint index;
 
-    value = seat_get_string_property (seat, name);
-    return value ? atoi (value) : 0;
+    g_return_val_if_fail (seat != NULL, 0);
+
+    index = get_schema_index (name);
+    if (index >= 0 && property_schema[index].type == PROPERTY_TYPE_INTEGER)
+        return seat_get_integer (seat, index);
+    else
+        return parse_integer (seat_get_string_property (seat, name));
+}
+
+const gchar *
+seat_get_string (Seat *seat, SeatProperty property)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    g_return_val_if_fail (property < N_SCHEMA_PROPERTIES, NULL);
+    return seat->priv->properties->values[property].string;
+}
+
+gchar **
+seat_get_string_list (Seat *seat, SeatProperty property)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    g_return_val_if_fail (property < N_SCHEMA_PROPERTIES && property_schema[property].type == PROPERTY_TYPE_STRING_LIST, NULL);
+    return g_strdupv (seat->priv->properties->values[property].list);
+}
+
+gboolean
+seat_get_boolean (Seat *seat, SeatProperty property)
+{
+    g_return_val_if_fail (seat != NULL, FALSE);
+    g_return_val_if_fail (property < N_SCHEMA_PROPERTIES && property_schema[property].type == PROPERTY_TYPE_BOOLEAN, FALSE);
+    return seat->priv->properties->values[property].boolean;
+}
+
+gint
+seat_get_integer (Seat *seat, SeatProperty property)
+{
+    g_return_val_if_fail (seat != NULL, 0);
+    g_return_val_if_fail (property < N_SCHEMA_PROPERTIES && property_schema[property].type == PROPERTY_TYPE_INTEGER, 0);
+    return seat->priv->properties->values[property].integer;
 }
 
 const gchar *
@@ -206,6 +557,7 @@ seat_start (Seat *seat)
     g_return_val_if_fail (seat != NULL, FALSE);
 
     l_debug (seat, "Starting");
+    trace_begin (seat, "seat", NULL);
 
     SEAT_GET_CLASS (seat)->setup (seat);
     seat->priv->started = SEAT_GET_CLASS (seat)->start (seat);
@@ -241,7 +593,7 @@ seat_set_active_session (Seat *seat, Session *session)
     {
         Session *s = link->data;
 
-        if (s == session || session_get_is_stopping (s))
+        if (s == session || s == SESSION (seat->priv->spare_greeter) || session_get_is_stopping (s))
             continue;
 
         if (IS_GREETER_SESSION (s))
@@ -274,6 +626,10 @@ seat_set_active_session (Seat *seat, Session *session)
     session_activate (session);
     g_clear_object (&seat->priv->active_session);
     seat->priv->active_session = g_object_ref (session);
+
+    /* Have a greeter ready for when this user locks or switches */
+    if (!IS_GREETER_SESSION (session))
+        queue_spare_greeter (seat);
 }
 
 Session *
@@ -341,67 +697,14 @@ gboolean
 seat_get_can_switch (Seat *seat)
 {
     g_return_val_if_fail (seat != NULL, FALSE);
-    return seat_get_boolean_property (seat, "allow-user-switching") && seat->priv->supports_multi_session;
+    return seat_get_boolean (seat, SEAT_PROPERTY_ALLOW_USER_SWITCHING) && seat->priv->supports_multi_session;
 }
 
 gboolean
 seat_get_allow_guest (Seat *seat)
 {
     g_return_val_if_fail (seat != NULL, FALSE);
-    return seat_get_boolean_property (seat, "allow-guest") && guest_account_is_installed ();
-}
-
-static gboolean
-run_script (Seat *seat, DisplayServer *display_server, const gchar *script_name, User *user)
-{
-    Process *script;
-    gboolean result = FALSE;
-
-    script = process_new (NULL, NULL);
-
-    process_set_command (script, script_name);
-
-    /* Set POSIX variables */
-    process_set_clear_environment (script, TRUE);
-    process_set_env (script, "SHELL", "/bin/sh");
-
-    if (g_getenv ("LD_PRELOAD"))
-        process_set_env (script, "LD_PRELOAD", g_getenv ("LD_PRELOAD"));
-    if (g_getenv ("LD_LIBRARY_PATH"))
-        process_set_env (script, "LD_LIBRARY_PATH", g_getenv ("LD_LIBRARY_PATH"));
-    if (g_getenv ("PATH"))
-        process_set_env (script, "PATH", g_getenv ("PATH"));
-
-    /* Variables required for regression tests */
-    if (g_getenv ("LIGHTDM_TEST_ROOT"))
-        process_set_env (script, "LIGHTDM_TEST_ROOT", g_getenv ("LIGHTDM_TEST_ROOT"));
-
-    if (user)
-    {
-        process_set_env (script, "USER", user_get_name (user));
-        process_set_env (script, "LOGNAME", user_get_name (user));
-        process_set_env (script, "HOME", user_get_home_directory (user));
-    }
-    else
-        process_set_env (script, "HOME", "/");
-
-    SEAT_GET_CLASS (seat)->run_script (seat, display_server, script);
-
-    if (process_start (script, TRUE))
-    {
-        int exit_status;
-
-        exit_status = process_get_exit_status (script);
-        if (WIFEXITED (exit_status))
-        {
-            l_debug (seat, "Exit status of %s: %d", script_name, WEXITSTATUS (exit_status));
-            result = WEXITSTATUS (exit_status) == EXIT_SUCCESS;
-        }
-    }
-
-    g_object_unref (script);
-
-    return result;
+    return seat_get_boolean (seat, SEAT_PROPERTY_ALLOW_GUEST) && guest_account_is_installed ();
 }
 
 static void
@@ -430,35 +733,204 @@ check_stopped (Seat *seat)
     if (seat->priv->stopping &&
         !seat->priv->stopped &&
         g_list_length (seat->priv->display_servers) == 0 &&
-        g_list_length (seat->priv->sessions) == 0)
+        g_list_length (seat->priv->sessions) == 0 &&
+        g_list_length (seat->priv->scripts) == 0)
     {
         seat->priv->stopped = TRUE;
         l_debug (seat, "Stopped");
+        trace_end (seat, "seat", NULL);
         g_signal_emit (seat, signals[STOPPED], 0);
     }
 }
 
+/* Called when a script completes, success is FALSE if it failed or timed out */
+typedef void (*ScriptDoneFunc) (Seat *seat, gpointer object, gboolean success);
+
+typedef struct
+{
+    Seat *seat;
+
+    /* Configuration key the script was set by */
+    const gchar *name;
+
+    Process *process;
+
+    /* Object to pass to the continuation */
+    gpointer object;
+    ScriptDoneFunc done_func;
+
+    /* Time the script was started */
+    gint64 start_time;
+
+    /* Timeout to stop the script */
+    guint timeout;
+    gboolean timed_out;
+} SeatScript;
+
+static void
+script_finish (SeatScript *script, gboolean success)
+{
+    Seat *seat = script->seat;
+
+    seat->priv->scripts = g_list_remove (seat->priv->scripts, script);
+    if (script->timeout)
+        g_source_remove (script->timeout);
+    g_signal_handlers_disconnect_matched (script->process, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, script);
+    trace_end (seat, script->name, NULL);
+
+    /* Continue where the seat left off */
+    script->done_func (seat, script->object, success);
+    check_stopped (seat);
+
+    g_object_unref (script->process);
+    if (script->object)
+        g_object_unref (script->object);
+    g_free (script);
+    g_object_unref (seat);
+}
+
+static void
+script_stopped_cb (Process *process, SeatScript *script)
+{
+    int exit_status;
+    gint64 duration;
+    gboolean result = FALSE;
+
+    duration = (g_get_monotonic_time () - script->start_time) / 1000;
+
+    exit_status = process_get_exit_status (process);
+    if (script->timed_out)
+        l_warning (script->seat, "%s timed out after %" G_GINT64_FORMAT "ms", process_get_command (process), duration);
+    else if (WIFEXITED (exit_status))
+    {
+        l_debug (script->seat, "Exit status of %s: %d (took %" G_GINT64_FORMAT "ms)", process_get_command (process), WEXITSTATUS (exit_status), duration);
+        result = WEXITSTATUS (exit_status) == EXIT_SUCCESS;
+    }
+    else if (WIFSIGNALED (exit_status))
+        l_debug (script->seat, "%s terminated with signal %d (took %" G_GINT64_FORMAT "ms)", process_get_command (process), WTERMSIG (exit_status), duration);
+
+    script_finish (script, result);
+}
+
+static gboolean
+script_timeout_cb (gpointer data)
+{
+    SeatScript *script = data;
+
+    script->timeout = 0;
+    script->timed_out = TRUE;
+
+    /* Either kill it outright or ask it to quit, falling back to SIGKILL if it doesn't */
+    if (g_strcmp0 (seat_get_string (script->seat, SEAT_PROPERTY_SCRIPT_KILL_POLICY), "kill") == 0)
+        process_signal (script->process, SIGKILL);
+    else
+        process_stop (script->process);
+
+    return FALSE;
+}
+
+/* Run the script set in the configuration key name without blocking the main loop.
+ * done_func is called once it completes (immediately if no script is set) */
 static void
-display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
+run_script (Seat *seat, DisplayServer *display_server, const gchar *name, User *user, gpointer object, ScriptDoneFunc done_func)
 {
-    const gchar *script;
-    GList *list, *link;
-    Session *active_session;
+    const gchar *command;
+    Process *process;
+    SeatScript *script;
+    gchar *timeout_name;
+    gint timeout;
 
-    l_debug (seat, "Display server stopped");
+    command = seat_get_string_property (seat, name);
+    if (!command)
+    {
+        done_func (seat, object, TRUE);
+        return;
+    }
 
-    /* Run a script right after stopping the display server */
-    script = seat_get_string_property (seat, "display-stopped-script");
-    if (script)
-        run_script (seat, NULL, script, NULL);
+    process = process_new (NULL, NULL);
 
-    g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
-    seat->priv->display_servers = g_list_remove (seat->priv->display_servers, display_server);
+    process_set_command (process, command);
+
+    /* Set POSIX variables */
+    process_set_clear_environment (process, TRUE);
+    process_set_env (process, "SHELL", "/bin/sh");
+
+    if (g_getenv ("LD_PRELOAD"))
+        process_set_env (process, "LD_PRELOAD", g_getenv ("LD_PRELOAD"));
+    if (g_getenv ("LD_LIBRARY_PATH"))
+        process_set_env (process, "LD_LIBRARY_PATH", g_getenv ("LD_LIBRARY_PATH"));
+    if (g_getenv ("PATH"))
+        process_set_env (process, "PATH", g_getenv ("PATH"));
+
+    /* Variables required for regression tests */
+    if (g_getenv ("LIGHTDM_TEST_ROOT"))
+        process_set_env (process, "LIGHTDM_TEST_ROOT", g_getenv ("LIGHTDM_TEST_ROOT"));
+
+    if (user)
+    {
+        process_set_env (process, "USER", user_get_name (user));
+        process_set_env (process, "LOGNAME", user_get_name (user));
+        process_set_env (process, "HOME", user_get_home_directory (user));
+    }
+    else
+        process_set_env (process, "HOME", "/");
+
+    SEAT_GET_CLASS (seat)->run_script (seat, display_server, process);
+
+    script = g_malloc0 (sizeof (SeatScript));
+    script->seat = g_object_ref (seat);
+    script->name = name;
+    script->process = process;
+    script->object = object ? g_object_ref (object) : NULL;
+    script->done_func = done_func;
+    script->start_time = g_get_monotonic_time ();
+    seat->priv->scripts = g_list_append (seat->priv->scripts, script);
+    trace_begin (seat, name, NULL);
+
+    g_signal_connect (process, PROCESS_SIGNAL_STOPPED, G_CALLBACK (script_stopped_cb), script);
+    if (!process_start (process, FALSE))
+    {
+        script_finish (script, FALSE);
+        return;
+    }
+
+    timeout_name = g_strdup_printf ("%s-timeout", name);
+    timeout = seat_get_integer_property (seat, timeout_name);
+    g_free (timeout_name);
+    if (timeout > 0)
+        script->timeout = g_timeout_add_seconds (timeout, script_timeout_cb, script);
+}
+
+/* TRUE if a display server is ready and its setup script has completed */
+static gboolean
+get_display_server_is_set_up (Seat *seat, DisplayServer *display_server)
+{
+    GList *link;
+
+    if (!display_server_get_is_ready (display_server))
+        return FALSE;
+
+    for (link = seat->priv->scripts; link; link = link->next)
+    {
+        SeatScript *script = link->data;
+
+        if (script->object == display_server && strcmp (script->name, "display-setup-script") == 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+display_stopped_script_done_cb (Seat *seat, gpointer object, gboolean success)
+{
+    DisplayServer *display_server = object;
+    GList *list, *link;
+    Session *active_session;
 
     if (seat->priv->stopping || !seat->priv->started)
     {
         check_stopped (seat);
-        g_object_unref (display_server);
         return;
     }
 
@@ -503,6 +975,18 @@ display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
             }
         }
     }
+}
+
+static void
+display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
+{
+    l_debug (seat, "Display server stopped");
+
+    g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
+    seat->priv->display_servers = g_list_remove (seat->priv->display_servers, display_server);
+
+    /* Run a script right after stopping the display server */
+    run_script (seat, NULL, "display-stopped-script", NULL, display_server, display_stopped_script_done_cb);
 
     g_object_unref (display_server);
 }
@@ -521,6 +1005,8 @@ find_greeter_session (Seat *seat)
     for (link = seat->priv->sessions; link; link = link->next)
     {
         Session *session = link->data;
+        if (session == SESSION (seat->priv->spare_greeter))
+            continue;
         if (!session_get_is_stopping (session) && IS_GREETER_SESSION (session))
             return GREETER_SESSION (session);
     }
@@ -536,6 +1022,8 @@ find_resettable_greeter (Seat *seat)
     for (link = seat->priv->sessions; link; link = link->next)
     {
         Session *session = link->data;
+        if (session == SESSION (seat->priv->spare_greeter))
+            continue;
         if (!session_get_is_stopping (session) && IS_GREETER_SESSION (session) &&
             greeter_get_resettable (greeter_session_get_greeter (GREETER_SESSION (session))))
             return GREETER_SESSION (session);
@@ -548,11 +1036,128 @@ static void
 set_greeter_hints (Seat *seat, Greeter *greeter)
 {
     greeter_clear_hints (greeter);
-    greeter_set_hint (greeter, "default-session", seat_get_string_property (seat, "user-session"));
-    greeter_set_hint (greeter, "hide-users", seat_get_boolean_property (seat, "greeter-hide-users") ? "true" : "false");
-    greeter_set_hint (greeter, "show-manual-login", seat_get_boolean_property (seat, "greeter-show-manual-login") ? "true" : "false");
-    greeter_set_hint (greeter, "show-remote-login", seat_get_boolean_property (seat, "greeter-show-remote-login") ? "true" : "false");
-    greeter_set_hint (greeter, "has-guest-account", seat_get_allow_guest (seat) && seat_get_boolean_property (seat, "greeter-allow-guest") ? "true" : "false");
+    greeter_set_hint (greeter, "default-session", seat_get_string (seat, SEAT_PROPERTY_USER_SESSION));
+    greeter_set_hint (greeter, "hide-users", seat_get_boolean (seat, SEAT_PROPERTY_GREETER_HIDE_USERS) ? "true" : "false");
+    greeter_set_hint (greeter, "show-manual-login", seat_get_boolean (seat, SEAT_PROPERTY_GREETER_SHOW_MANUAL_LOGIN) ? "true" : "false");
+    greeter_set_hint (greeter, "show-remote-login", seat_get_boolean (seat, SEAT_PROPERTY_GREETER_SHOW_REMOTE_LOGIN) ? "true" : "false");
+    greeter_set_hint (greeter, "has-guest-account", seat_get_allow_guest (seat) && seat_get_boolean (seat, SEAT_PROPERTY_GREETER_ALLOW_GUEST) ? "true" : "false");
+}
+
+gboolean
+seat_get_spare_greeter_ready (Seat *seat)
+{
+    g_return_val_if_fail (seat != NULL, FALSE);
+    return seat->priv->spare_greeter_ready;
+}
+
+static void
+set_spare_greeter_ready (Seat *seat, gboolean ready)
+{
+    if (seat->priv->spare_greeter_ready == ready)
+        return;
+    seat->priv->spare_greeter_ready = ready;
+    g_signal_emit (seat, signals[SPARE_GREETER_CHANGED], 0);
+}
+
+static gboolean
+start_spare_greeter_cb (gpointer data)
+{
+    Seat *seat = data;
+    GreeterSession *greeter_session;
+    DisplayServer *display_server;
+
+    seat->priv->spare_greeter_idle = 0;
+
+    /* Not needed if there is already a greeter we can switch to */
+    if (seat->priv->spare_greeter || seat->priv->stopping || find_resettable_greeter (seat))
+        return FALSE;
+
+    l_debug (seat, "Starting spare greeter");
+
+    greeter_session = create_greeter_session (seat);
+    if (!greeter_session)
+        return FALSE;
+    seat->priv->spare_greeter = greeter_session;
+
+    /* A display server on its own VT switches to it when it starts, which would pull the user away from their
+     * session. So only keep a spare where it runs on a display server that is already up (e.g. a shared system
+     * compositor) or one that doesn't use a VT */
+    display_server = SEAT_GET_CLASS (seat)->create_display_server (seat, SESSION (greeter_session));
+    if (display_server &&
+        !(g_list_find (seat->priv->display_servers, display_server) && display_server_get_is_ready (display_server)) &&
+        display_server_get_vt (display_server) > 0)
+    {
+        l_debug (seat, "Not keeping a spare greeter, its display server would switch VT");
+        g_object_unref (display_server);
+        seat->priv->spare_greeter_failed = TRUE;
+        session_stop (SESSION (greeter_session));
+        return FALSE;
+    }
+
+    if (display_server)
+        add_display_server (seat, display_server);
+    session_set_display_server (SESSION (greeter_session), display_server);
+    if (!display_server || !start_display_server (seat, display_server))
+    {
+        l_warning (seat, "Failed to start display server for spare greeter");
+        seat->priv->spare_greeter_failed = TRUE;
+        session_stop (SESSION (greeter_session));
+    }
+
+    return FALSE;
+}
+
+/* Start a spare greeter once the current request is handled, if the seat is configured to keep one */
+static void
+queue_spare_greeter (Seat *seat)
+{
+    if (!seat_get_boolean (seat, SEAT_PROPERTY_SPARE_GREETER) ||
+        !seat_get_can_switch (seat) ||
+        seat->priv->spare_greeter_failed ||
+        seat->priv->spare_greeter ||
+        seat->priv->spare_greeter_idle ||
+        seat->priv->stopping)
+        return;
+
+    seat->priv->spare_greeter_idle = g_idle_add_full (G_PRIORITY_LOW, start_spare_greeter_cb, seat, NULL);
+}
+
+static void
+spare_greeter_connected (Seat *seat)
+{
+    Greeter *greeter = greeter_session_get_greeter (seat->priv->spare_greeter);
+
+    /* We need to be able to reset it with new hints when it is handed out */
+    if (!greeter_get_resettable (greeter))
+    {
+        l_warning (seat, "Greeter is not resettable, not keeping a spare greeter");
+        seat->priv->spare_greeter_failed = TRUE;
+        session_stop (SESSION (seat->priv->spare_greeter));
+        return;
+    }
+
+    l_debug (seat, "Spare greeter ready");
+
+    /* Let the greeter release what resources it can while it waits */
+    greeter_idle (greeter);
+
+    set_spare_greeter_ready (seat, TRUE);
+}
+
+/* Take the spare greeter if it is ready, a new one is started when we next return to a user session */
+static GreeterSession *
+take_spare_greeter (Seat *seat)
+{
+    GreeterSession *greeter_session;
+
+    if (!seat->priv->spare_greeter_ready)
+        return NULL;
+
+    greeter_session = seat->priv->spare_greeter;
+    seat->priv->spare_greeter = NULL;
+    set_spare_greeter_ready (seat, FALSE);
+
+    return greeter_session;
 }
 
 static void
@@ -564,6 +1169,8 @@ switch_to_greeter_from_failed_session (Seat *seat, Session *session)
 
     /* Switch to greeter if one open */
     greeter_session = find_resettable_greeter (seat);
+    if (!greeter_session)
+        greeter_session = take_spare_greeter (seat);
     if (greeter_session)
     {
         l_debug (seat, "Switching to existing greeter");
@@ -647,21 +1254,44 @@ start_session (Seat *seat, Session *session)
 }
 
 static void
-run_session (Seat *seat, Session *session)
+record_session_metrics (Seat *seat, Session *session, gint64 start_time)
 {
-    const gchar *script;
+    LoginMetric metric;
 
-    if (IS_GREETER_SESSION (session))
-        script = seat_get_string_property (seat, "greeter-setup-script");
-    else
-        script = seat_get_string_property (seat, "session-setup-script");
-    if (script && !run_script (seat, session_get_display_server (session), script, session_get_user (session)))
+    for (metric = LOGIN_METRIC_PAM_AUTHENTICATE; metric <= LOGIN_METRIC_PAM_OPEN_SESSION; metric++)
+        login_metrics_record (seat->priv->name, metric, session_get_pam_duration (session, metric));
+    login_metrics_record_since (seat->priv->name, LOGIN_METRIC_SESSION_EXEC, start_time);
+}
+
+static void
+record_logout_to_greeter (Seat *seat)
+{
+    if (seat->priv->logout_time == 0)
+        return;
+
+    login_metrics_record_since (seat->priv->name, LOGIN_METRIC_LOGOUT_TO_GREETER, seat->priv->logout_time);
+    seat->priv->logout_time = 0;
+}
+
+static void
+session_setup_script_done_cb (Seat *seat, gpointer object, gboolean success)
+{
+    Session *session = object;
+    gint64 start_time;
+
+    /* Session may have gone away while the script was running */
+    if (!g_list_find (seat->priv->sessions, session) || session_get_is_stopping (session))
+        return;
+
+    if (!success)
     {
         l_debug (seat, "Switching to greeter due to failed setup script");
         switch_to_greeter_from_failed_session (seat, session);
         return;
     }
 
+    start_time = g_get_monotonic_time ();
+
     if (!IS_GREETER_SESSION (session))
     {
         g_signal_emit (seat, signals[RUNNING_USER_SESSION], 0, session);
@@ -669,6 +1299,8 @@ run_session (Seat *seat, Session *session)
     }
 
     session_run (session);
+    if (!IS_GREETER_SESSION (session))
+        record_session_metrics (seat, session, start_time);
 
     // FIXME: Wait until the session is ready
 
@@ -690,6 +1322,14 @@ run_session (Seat *seat, Session *session)
     }
 }
 
+static void
+run_session (Seat *seat, Session *session)
+{
+    run_script (seat, session_get_display_server (session),
+                IS_GREETER_SESSION (session) ? "greeter-setup-script" : "session-setup-script",
+                session_get_user (session), session, session_setup_script_done_cb);
+}
+
 static Session *
 find_user_session (Seat *seat, const gchar *username, Session *ignore_session)
 {
@@ -739,6 +1379,12 @@ session_authentication_complete_cb (Session *session, Seat *seat)
             seat_set_active_session (seat, s);
             session_stop (session);
         }
+        else if (session_get_display_server (session) &&
+                 !get_display_server_is_set_up (seat, session_get_display_server (session)))
+        {
+            /* Authentication was started early, run it once the display server is ready */
+            l_debug (seat, "Session authenticated, waiting for display server");
+        }
         else
         {
             l_debug (seat, "Session authenticated, running command");
@@ -758,36 +1404,12 @@ session_authentication_complete_cb (Session *session, Seat *seat)
 }
 
 static void
-session_stopped_cb (Session *session, Seat *seat)
+session_cleanup_script_done_cb (Seat *seat, gpointer object, gboolean success)
 {
+    Session *session = object;
     DisplayServer *display_server;
 
-    l_debug (seat, "Session stopped");
-
-    g_signal_handlers_disconnect_matched (session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
-    seat->priv->sessions = g_list_remove (seat->priv->sessions, session);
-    if (session == seat->priv->active_session)
-        g_clear_object (&seat->priv->active_session);
-    if (session == seat->priv->next_session)
-        g_clear_object (&seat->priv->next_session);
-    if (session == seat->priv->session_to_activate)
-        g_clear_object (&seat->priv->session_to_activate);
-
     display_server = session_get_display_server (session);
-    if (!display_server)
-    {
-        g_object_unref (session);
-        return;
-    }
-
-    /* Cleanup */
-    if (!IS_GREETER_SESSION (session))
-    {
-        const gchar *script;
-        script = seat_get_string_property (seat, "session-cleanup-script");
-        if (script)
-            run_script (seat, display_server, script, session_get_user (session));
-    }
 
     /* We were waiting for this session, but it didn't start :( */
     // FIXME: Start a greeter on this?
@@ -797,7 +1419,6 @@ session_stopped_cb (Session *session, Seat *seat)
     if (seat->priv->stopping)
     {
         check_stopped (seat);
-        g_object_unref (session);
         return;
     }
     
@@ -861,6 +1482,7 @@ session_stopped_cb (Session *session, Seat *seat)
     else if (!IS_GREETER_SESSION (session) && session == seat_get_active_session (seat))
     {
         l_debug (seat, "Active session stopped, starting greeter");
+        seat->priv->logout_time = g_get_monotonic_time ();
         if (!seat_switch_to_greeter (seat))
         {
             l_debug (seat, "Stopping; failed to start a greeter");
@@ -877,6 +1499,59 @@ session_stopped_cb (Session *session, Seat *seat)
     }
 
     g_signal_emit (seat, signals[SESSION_REMOVED], 0, session);
+}
+
+static void
+session_stopped_cb (Session *session, Seat *seat)
+{
+    DisplayServer *display_server;
+
+    l_debug (seat, "Session stopped");
+
+    g_signal_handlers_disconnect_matched (session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
+    seat->priv->sessions = g_list_remove (seat->priv->sessions, session);
+    if (session == seat->priv->active_session)
+        g_clear_object (&seat->priv->active_session);
+    if (session == seat->priv->next_session)
+        g_clear_object (&seat->priv->next_session);
+    if (session == seat->priv->session_to_activate)
+        g_clear_object (&seat->priv->session_to_activate);
+
+    /* The spare greeter isn't visible so just clean up after it */
+    if (session == SESSION (seat->priv->spare_greeter))
+    {
+        if (!seat->priv->spare_greeter_ready)
+        {
+            l_debug (seat, "Spare greeter failed to start");
+            seat->priv->spare_greeter_failed = TRUE;
+        }
+        seat->priv->spare_greeter = NULL;
+        set_spare_greeter_ready (seat, FALSE);
+
+        display_server = session_get_display_server (session);
+        if (display_server && !display_server_get_is_stopping (display_server) &&
+            !SEAT_GET_CLASS (seat)->display_server_is_used (seat, display_server))
+            display_server_stop (display_server);
+
+        check_stopped (seat);
+        g_signal_emit (seat, signals[SESSION_REMOVED], 0, session);
+        g_object_unref (session);
+        return;
+    }
+
+    display_server = session_get_display_server (session);
+    if (!display_server)
+    {
+        g_object_unref (session);
+        return;
+    }
+
+    /* Cleanup */
+    if (IS_GREETER_SESSION (session))
+        session_cleanup_script_done_cb (seat, session, TRUE);
+    else
+        run_script (seat, display_server, "session-cleanup-script", session_get_user (session), session, session_cleanup_script_done_cb);
+
     g_object_unref (session);
 }
 
@@ -1045,13 +1720,13 @@ create_user_session (Seat *seat, const gchar *username, gboolean autostart)
     /* Override session for autologin if configured */
     if (autostart)
     {
-        const gchar *autologin_session_name = seat_get_string_property (seat, "autologin-session");
+        const gchar *autologin_session_name = seat_get_string (seat, SEAT_PROPERTY_AUTOLOGIN_SESSION);
         if (autologin_session_name)
             session_name = autologin_session_name;
     }
 
     if (!session_name)
-        session_name = seat_get_string_property (seat, "user-session");
+        session_name = seat_get_string (seat, SEAT_PROPERTY_USER_SESSION);
     sessions_dir = config_get_string (config_get_instance (), "LightDM", "sessions-directory");
     session_config = find_session_config (seat, sessions_dir, session_name);
     g_free (sessions_dir);
@@ -1063,7 +1738,7 @@ create_user_session (Seat *seat, const gchar *username, gboolean autostart)
         configure_session (session, session_config, session_name, language);
         session_set_username (session, username);
         session_set_do_authenticate (session, TRUE);
-        argv = get_session_argv (seat, session_config, seat_get_string_property (seat, "session-wrapper"));
+        argv = get_session_argv (seat, session_config, seat_get_string (seat, SEAT_PROPERTY_SESSION_WRAPPER));
         session_set_argv (session, argv);
         g_strfreev (argv);
         g_object_unref (session_config);
@@ -1102,9 +1777,9 @@ create_guest_session (Seat *seat, const gchar *session_name)
     Session *session;
 
     if (!session_name)
-        session_name = seat_get_string_property (seat, "guest-session");
+        session_name = seat_get_string (seat, SEAT_PROPERTY_GUEST_SESSION);
     if (!session_name)
-        session_name = seat_get_string_property (seat, "user-session");
+        session_name = seat_get_string (seat, SEAT_PROPERTY_USER_SESSION);
     sessions_dir = config_get_string (config_get_instance (), "LightDM", "sessions-directory");
     session_config = find_session_config (seat, sessions_dir, session_name);
     g_free (sessions_dir);
@@ -1118,8 +1793,8 @@ create_guest_session (Seat *seat, const gchar *session_name)
     configure_session (session, session_config, session_name, NULL);
     session_set_do_authenticate (session, TRUE);
     session_set_is_guest (session, TRUE);
-    argv = get_session_argv (seat, session_config, seat_get_string_property (seat, "session-wrapper"));
-    guest_wrapper = seat_get_string_property (seat, "guest-wrapper");
+    argv = get_session_argv (seat, session_config, seat_get_string (seat, SEAT_PROPERTY_SESSION_WRAPPER));
+    guest_wrapper = seat_get_string (seat, SEAT_PROPERTY_GUEST_WRAPPER);
     if (guest_wrapper)
     {
         gchar *path;
@@ -1179,7 +1854,7 @@ greeter_start_session_cb (Greeter *greeter, SessionType type, const gchar *sessi
         session = g_object_ref (create_guest_session (seat, session_name));
         if (!session)
             return FALSE;
-        session_set_pam_service (session, seat_get_string_property (seat, "pam-autologin-service"));
+        session_set_pam_service (session, seat_get_string (seat, SEAT_PROPERTY_PAM_AUTOLOGIN_SERVICE));
     }
     else
     {
@@ -1212,7 +1887,7 @@ greeter_start_session_cb (Greeter *greeter, SessionType type, const gchar *sessi
         }
 
         if (!session_name)
-            session_name = seat_get_string_property (seat, "user-session");
+            session_name = seat_get_string (seat, SEAT_PROPERTY_USER_SESSION);
         if (user)
             user_set_xsession (session_get_user (session), session_name);
 
@@ -1225,7 +1900,7 @@ greeter_start_session_cb (Greeter *greeter, SessionType type, const gchar *sessi
         }
 
         configure_session (session, session_config, session_name, language);
-        argv = get_session_argv (seat, session_config, seat_get_string_property (seat, "session-wrapper"));
+        argv = get_session_argv (seat, session_config, seat_get_string (seat, SEAT_PROPERTY_SESSION_WRAPPER));
         session_set_argv (session, argv);
         g_strfreev (argv);
         g_object_unref (session_config);
@@ -1281,6 +1956,25 @@ greeter_start_session_cb (Greeter *greeter, SessionType type, const gchar *sessi
     return TRUE;
 }
 
+static void
+greeter_connected_cb (Greeter *greeter, Seat *seat)
+{
+    Session *greeter_session;
+
+    if (seat->priv->spare_greeter && greeter == greeter_session_get_greeter (seat->priv->spare_greeter))
+    {
+        spare_greeter_connected (seat);
+        return;
+    }
+
+    /* Greeters may send CONNECT again on the same channel; only the first one
+     * marks the end of the greeter start up */
+    greeter_session = get_greeter_session (seat, greeter);
+    if (greeter_session && greeter_get_n_connects (greeter) == 1)
+        login_metrics_record_since (seat->priv->name, LOGIN_METRIC_GREETER_START, session_get_start_time (greeter_session));
+    record_logout_to_greeter (seat);
+}
+
 static GreeterSession *
 create_greeter_session (Seat *seat)
 {
@@ -1296,13 +1990,13 @@ create_greeter_session (Seat *seat)
     l_debug (seat, "Creating greeter session");
 
     sessions_dir = config_get_string (config_get_instance (), "LightDM", "greeters-directory");
-    session_config = find_session_config (seat, sessions_dir, seat_get_string_property (seat, "greeter-session"));
+    session_config = find_session_config (seat, sessions_dir, seat_get_string (seat, SEAT_PROPERTY_GREETER_SESSION));
     g_free (sessions_dir);
     if (!session_config)
         return NULL;
 
     argv = get_session_argv (seat, session_config, NULL);
-    greeter_wrapper = seat_get_string_property (seat, "greeter-wrapper");
+    greeter_wrapper = seat_get_string (seat, SEAT_PROPERTY_GREETER_WRAPPER);
     if (greeter_wrapper)
     {
         gchar *path;
@@ -1315,6 +2009,7 @@ create_greeter_session (Seat *seat)
     greeter = greeter_session_get_greeter (greeter_session);
     session_set_config (SESSION (greeter_session), session_config);
     seat->priv->sessions = g_list_append (seat->priv->sessions, SESSION (greeter_session));
+    g_signal_connect (greeter, GREETER_SIGNAL_CONNECTED, G_CALLBACK (greeter_connected_cb), seat);
     g_signal_connect (greeter, GREETER_SIGNAL_ACTIVE_USERNAME_CHANGED, G_CALLBACK (greeter_active_username_changed_cb), seat);
     g_signal_connect (greeter_session, SESSION_SIGNAL_AUTHENTICATION_COMPLETE, G_CALLBACK (session_authentication_complete_cb), seat);
     g_signal_connect (greeter_session, SESSION_SIGNAL_STOPPED, G_CALLBACK (session_stopped_cb), seat);
@@ -1322,7 +2017,7 @@ create_greeter_session (Seat *seat)
     set_session_env (SESSION (greeter_session));
     session_set_env (SESSION (greeter_session), "XDG_SESSION_CLASS", "greeter");
 
-    session_set_pam_service (SESSION (greeter_session), seat_get_string_property (seat, "pam-greeter-service"));
+    session_set_pam_service (SESSION (greeter_session), seat_get_string (seat, SEAT_PROPERTY_PAM_GREETER_SERVICE));
     if (getuid () == 0)
     {
         gchar *greeter_user;
@@ -1339,8 +2034,8 @@ create_greeter_session (Seat *seat)
     g_strfreev (argv);
 
     greeter_set_pam_services (greeter,
-                              seat_get_string_property (seat, "pam-service"),
-                              seat_get_string_property (seat, "pam-autologin-service"));
+                              seat_get_string (seat, SEAT_PROPERTY_PAM_SERVICE),
+                              seat_get_string (seat, SEAT_PROPERTY_PAM_AUTOLOGIN_SERVICE));
     g_signal_connect (greeter, GREETER_SIGNAL_CREATE_SESSION, G_CALLBACK (greeter_create_session_cb), seat);
     g_signal_connect (greeter, GREETER_SIGNAL_START_SESSION, G_CALLBACK (greeter_start_session_cb), seat);
 
@@ -1349,11 +2044,11 @@ create_greeter_session (Seat *seat)
     set_greeter_hints (seat, greeter);
 
     /* Configure for automatic login */
-    autologin_username = seat_get_string_property (seat, "autologin-user");
+    autologin_username = seat_get_string (seat, SEAT_PROPERTY_AUTOLOGIN_USER);
     if (g_strcmp0 (autologin_username, "") == 0)
         autologin_username = NULL;
-    autologin_timeout = seat_get_integer_property (seat, "autologin-user-timeout");
-    autologin_guest = seat_get_boolean_property (seat, "autologin-guest");
+    autologin_timeout = seat_get_integer (seat, SEAT_PROPERTY_AUTOLOGIN_USER_TIMEOUT);
+    autologin_guest = seat_get_boolean (seat, SEAT_PROPERTY_AUTOLOGIN_GUEST);
     if (autologin_timeout > 0)
     {
         gchar *value;
@@ -1391,14 +2086,22 @@ find_session_for_display_server (Seat *seat, DisplayServer *display_server)
 }
 
 static void
-display_server_ready_cb (DisplayServer *display_server, Seat *seat)
+display_server_started_cb (DisplayServer *display_server, Seat *seat)
+{
+    login_metrics_record_since (seat->priv->name, LOGIN_METRIC_DISPLAY_SERVER_READY, display_server_get_start_time (display_server));
+}
+
+static void
+display_setup_script_done_cb (Seat *seat, gpointer object, gboolean success)
 {
-    const gchar *script;
+    DisplayServer *display_server = object;
     Session *session;
 
-    /* Run setup script */
-    script = seat_get_string_property (seat, "display-setup-script");
-    if (script && !run_script (seat, display_server, script, NULL))
+    /* Display server may have stopped while the script was running */
+    if (!g_list_find (seat->priv->display_servers, display_server) || display_server_get_is_stopping (display_server))
+        return;
+
+    if (!success)
     {
         l_debug (seat, "Stopping display server due to failed setup script");
         display_server_stop (display_server);
@@ -1416,6 +2119,8 @@ display_server_ready_cb (DisplayServer *display_server, Seat *seat)
             l_debug (seat, "Display server ready, running session");
             run_session (seat, session);
         }
+        else if (session_get_is_started (session))
+            l_debug (seat, "Display server ready, waiting for session authentication");
         else
         {
             l_debug (seat, "Display server ready, starting session authentication");
@@ -1429,6 +2134,26 @@ display_server_ready_cb (DisplayServer *display_server, Seat *seat)
     }
 }
 
+static void
+display_server_ready_cb (DisplayServer *display_server, Seat *seat)
+{
+    /* Run setup script */
+    run_script (seat, display_server, "display-setup-script", NULL, display_server, display_setup_script_done_cb);
+}
+
+static void
+add_display_server (Seat *seat, DisplayServer *display_server)
+{
+    /* Remember this display server */
+    if (!g_list_find (seat->priv->display_servers, display_server)) 
+    {
+        seat->priv->display_servers = g_list_append (seat->priv->display_servers, display_server);
+        g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (display_server_started_cb), seat);
+        g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (display_server_ready_cb), seat);
+        g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_STOPPED, G_CALLBACK (display_server_stopped_cb), seat);
+    }
+}
+
 static DisplayServer *
 create_display_server (Seat *seat, Session *session)
 {
@@ -1440,13 +2165,7 @@ create_display_server (Seat *seat, Session *session)
     if (!display_server)
         return NULL;
 
-    /* Remember this display server */
-    if (!g_list_find (seat->priv->display_servers, display_server)) 
-    {
-        seat->priv->display_servers = g_list_append (seat->priv->display_servers, display_server);
-        g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (display_server_ready_cb), seat);
-        g_signal_connect (display_server, DISPLAY_SERVER_SIGNAL_STOPPED, G_CALLBACK (display_server_stopped_cb), seat);
-    }
+    add_display_server (seat, display_server);
 
     return display_server;
 }
@@ -1480,6 +2199,20 @@ seat_switch_to_greeter (Seat *seat)
     {
         l_debug (seat, "Switching to existing greeter");
         seat_set_active_session (seat, SESSION (greeter_session));
+        record_logout_to_greeter (seat);
+        return TRUE;
+    }
+
+    greeter_session = take_spare_greeter (seat);
+    if (greeter_session)
+    {
+        Greeter *greeter = greeter_session_get_greeter (greeter_session);
+
+        l_debug (seat, "Switching to spare greeter");
+        set_greeter_hints (seat, greeter);
+        greeter_reset (greeter);
+        seat_set_active_session (seat, SESSION (greeter_session));
+        record_logout_to_greeter (seat);
         return TRUE;
     }
 
@@ -1589,7 +2322,7 @@ seat_switch_to_user (Seat *seat, const gchar *username, const gchar *session_nam
     /* Attempt to authenticate them */
     session = create_user_session (seat, username, FALSE);
     g_signal_connect (session, SESSION_SIGNAL_AUTHENTICATION_COMPLETE, G_CALLBACK (switch_authentication_complete_cb), seat);
-    session_set_pam_service (session, seat_get_string_property (seat, "pam-service"));
+    session_set_pam_service (session, seat_get_string (seat, SEAT_PROPERTY_PAM_SERVICE));
 
     return session_start (session);
 }
@@ -1637,7 +2370,7 @@ seat_switch_to_guest (Seat *seat, const gchar *session_name)
 
     g_clear_object (&seat->priv->session_to_activate);
     seat->priv->session_to_activate = g_object_ref (session);
-    session_set_pam_service (session, seat_get_string_property (seat, "pam-autologin-service"));
+    session_set_pam_service (session, seat_get_string (seat, SEAT_PROPERTY_PAM_AUTOLOGIN_SERVICE));
     session_set_display_server (session, display_server);
 
     return start_display_server (seat, display_server);
@@ -1669,6 +2402,12 @@ seat_lock (Seat *seat, const gchar *username)
         set_greeter_hints (seat, greeter_session_get_greeter (greeter_session));
         reset_existing = TRUE;
     }
+    else if ((greeter_session = take_spare_greeter (seat)))
+    {
+        l_debug (seat, "Switching to spare greeter");
+        set_greeter_hints (seat, greeter_session_get_greeter (greeter_session));
+        reset_existing = TRUE;
+    }
     else
     {
         /* If the existing greeter can't be reused, stop it and reuse its display server */
@@ -1730,6 +2469,9 @@ seat_stop (Seat *seat)
 
     l_debug (seat, "Stopping");
     seat->priv->stopping = TRUE;
+    if (seat->priv->spare_greeter_idle)
+        g_source_remove (seat->priv->spare_greeter_idle);
+    seat->priv->spare_greeter_idle = 0;
     SEAT_GET_CLASS (seat)->stop (seat);
 }
 
@@ -1752,15 +2494,17 @@ seat_real_start (Seat *seat)
     int autologin_timeout;
     gboolean autologin_guest;
     gboolean autologin_in_background;
+    gboolean autologin_pipelined;
     Session *session = NULL, *background_session = NULL;
 
     /* Get autologin settings */
-    autologin_username = seat_get_string_property (seat, "autologin-user");
+    autologin_username = seat_get_string (seat, SEAT_PROPERTY_AUTOLOGIN_USER);
     if (g_strcmp0 (autologin_username, "") == 0)
         autologin_username = NULL;
-    autologin_timeout = seat_get_integer_property (seat, "autologin-user-timeout");
-    autologin_guest = seat_get_boolean_property (seat, "autologin-guest");
-    autologin_in_background = seat_get_boolean_property (seat, "autologin-in-background");
+    autologin_timeout = seat_get_integer (seat, SEAT_PROPERTY_AUTOLOGIN_USER_TIMEOUT);
+    autologin_guest = seat_get_boolean (seat, SEAT_PROPERTY_AUTOLOGIN_GUEST);
+    autologin_in_background = seat_get_boolean (seat, SEAT_PROPERTY_AUTOLOGIN_IN_BACKGROUND);
+    autologin_pipelined = seat_get_boolean (seat, SEAT_PROPERTY_AUTOLOGIN_PIPELINED);
 
     /* Autologin if configured */
     if (autologin_timeout == 0 || autologin_in_background)
@@ -1771,7 +2515,7 @@ seat_real_start (Seat *seat)
             session = create_user_session (seat, autologin_username, TRUE);
 
         if (session)
-            session_set_pam_service (session, seat_get_string_property (seat, "pam-autologin-service"));
+            session_set_pam_service (session, seat_get_string (seat, SEAT_PROPERTY_PAM_AUTOLOGIN_SERVICE));
 
         /* Load in background if required */
         if (autologin_in_background && session)
@@ -1797,6 +2541,12 @@ seat_real_start (Seat *seat)
                     display_server_stop (display_server);
                 session = NULL;
             }
+            /* Authenticate while the display server starts, the session is run once both complete */
+            else if (autologin_pipelined && !session_get_is_started (session))
+            {
+                l_debug (seat, "Starting automatic login authentication while display server starts");
+                start_session (seat, session);
+            }
         }
     }
 
@@ -1897,8 +2647,8 @@ create_greeter_cb (Session *session, Seat *seat)
     greeter = greeter_new ();
 
     greeter_set_pam_services (greeter,
-                              seat_get_string_property (seat, "pam-service"),
-                              seat_get_string_property (seat, "pam-autologin-service"));
+                              seat_get_string (seat, SEAT_PROPERTY_PAM_SERVICE),
+                              seat_get_string (seat, SEAT_PROPERTY_PAM_AUTOLOGIN_SERVICE));
     g_signal_connect (greeter, GREETER_SIGNAL_CREATE_SESSION, G_CALLBACK (create_session_cb), seat);
     g_signal_connect (greeter, GREETER_SIGNAL_START_SESSION, G_CALLBACK (greeter_start_session_cb), seat);
 
@@ -1973,13 +2723,27 @@ seat_real_stop (Seat *seat)
         }
     }
     g_list_free_full (list, g_object_unref);
+
+    /* Setup scripts have no timeout by default, so stop them or we'd wait for them forever.
+     * Cleanup scripts are left to complete */
+    list = g_list_copy (seat->priv->scripts);
+    for (link = list; link; link = link->next)
+    {
+        SeatScript *script = link->data;
+        if (g_str_has_suffix (script->name, "-setup-script"))
+        {
+            l_debug (seat, "Stopping %s", script->name);
+            process_stop (script->process);
+        }
+    }
+    g_list_free (list);
 }
 
 static void
 seat_init (Seat *seat)
 {
     seat->priv = G_TYPE_INSTANCE_GET_PRIVATE (seat, SEAT_TYPE, SeatPrivate);
-    seat->priv->properties = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    seat->priv->properties = seat_properties_new ();
     seat->priv->share_display_server = TRUE;
 }
 
@@ -1990,7 +2754,7 @@ seat_finalize (GObject *object)
     GList *link;
 
     g_free (self->priv->name);
-    g_hash_table_unref (self->priv->properties);
+    seat_properties_unref (self->priv->properties);
     for (link = self->priv->display_servers; link; link = link->next)
     {
         DisplayServer *display_server = link->data;
@@ -2007,6 +2771,8 @@ seat_finalize (GObject *object)
     g_clear_object (&self->priv->next_session);
     g_clear_object (&self->priv->session_to_activate);
     g_clear_object (&self->priv->replacement_greeter);
+    if (self->priv->spare_greeter_idle)
+        g_source_remove (self->priv->spare_greeter_idle);
 
     G_OBJECT_CLASS (seat_parent_class)->finalize (object);
 }
@@ -2056,6 +2822,14 @@ seat_class_init (SeatClass *klass)
                       NULL, NULL,
                       NULL,
                       G_TYPE_NONE, 1, SESSION_TYPE);
+    signals[SPARE_GREETER_CHANGED] =
+        g_signal_new (SEAT_SIGNAL_SPARE_GREETER_CHANGED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (SeatClass, spare_greeter_changed),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
     signals[STOPPED] =
         g_signal_new (SEAT_SIGNAL_STOPPED,
                       G_TYPE_FROM_CLASS (klass),
@@ -26,13 +26,71 @@ G_BEGIN_DECLS
 #define SEAT_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST ((klass), SEAT_TYPE, SeatClass))
 #define SEAT_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), SEAT_TYPE, SeatClass))
 
-#define SEAT_SIGNAL_SESSION_ADDED        "session-added"
-#define SEAT_SIGNAL_RUNNING_USER_SESSION "running-user-session"
-#define SEAT_SIGNAL_SESSION_REMOVED      "session-removed"
-#define SEAT_SIGNAL_STOPPED              "stopped"
+#define SEAT_SIGNAL_SESSION_ADDED          "session-added"
+#define SEAT_SIGNAL_RUNNING_USER_SESSION   "running-user-session"
+#define SEAT_SIGNAL_SESSION_REMOVED        "session-removed"
+#define SEAT_SIGNAL_SPARE_GREETER_CHANGED  "spare-greeter-changed"
+#define SEAT_SIGNAL_STOPPED                "stopped"
 
 typedef struct SeatPrivate SeatPrivate;
 
+typedef struct SeatProperties SeatProperties;
+
+/* Properties with a known type, these can be read without looking up the name */
+typedef enum
+{
+    SEAT_PROPERTY_ALLOW_GUEST,
+    SEAT_PROPERTY_ALLOW_USER_SWITCHING,
+    SEAT_PROPERTY_AUTOLOGIN_GUEST,
+    SEAT_PROPERTY_AUTOLOGIN_IN_BACKGROUND,
+    SEAT_PROPERTY_AUTOLOGIN_PIPELINED,
+    SEAT_PROPERTY_AUTOLOGIN_SESSION,
+    SEAT_PROPERTY_AUTOLOGIN_USER,
+    SEAT_PROPERTY_AUTOLOGIN_USER_TIMEOUT,
+    SEAT_PROPERTY_DISPLAY_SETUP_SCRIPT,
+    SEAT_PROPERTY_DISPLAY_SETUP_SCRIPT_TIMEOUT,
+    SEAT_PROPERTY_DISPLAY_STOPPED_SCRIPT,
+    SEAT_PROPERTY_DISPLAY_STOPPED_SCRIPT_TIMEOUT,
+    SEAT_PROPERTY_EXIT_ON_FAILURE,
+    SEAT_PROPERTY_GREETER_ALLOW_GUEST,
+    SEAT_PROPERTY_GREETER_HIDE_USERS,
+    SEAT_PROPERTY_GREETER_SESSION,
+    SEAT_PROPERTY_GREETER_SETUP_SCRIPT,
+    SEAT_PROPERTY_GREETER_SETUP_SCRIPT_TIMEOUT,
+    SEAT_PROPERTY_GREETER_SHOW_MANUAL_LOGIN,
+    SEAT_PROPERTY_GREETER_SHOW_REMOTE_LOGIN,
+    SEAT_PROPERTY_GREETER_WRAPPER,
+    SEAT_PROPERTY_GUEST_SESSION,
+    SEAT_PROPERTY_GUEST_WRAPPER,
+    SEAT_PROPERTY_PAM_AUTOLOGIN_SERVICE,
+    SEAT_PROPERTY_PAM_GREETER_SERVICE,
+    SEAT_PROPERTY_PAM_SERVICE,
+    SEAT_PROPERTY_SCRIPT_KILL_POLICY,
+    SEAT_PROPERTY_SESSION_CLEANUP_SCRIPT,
+    SEAT_PROPERTY_SESSION_CLEANUP_SCRIPT_TIMEOUT,
+    SEAT_PROPERTY_SESSION_SETUP_SCRIPT,
+    SEAT_PROPERTY_SESSION_SETUP_SCRIPT_TIMEOUT,
+    SEAT_PROPERTY_SESSION_WRAPPER,
+    SEAT_PROPERTY_SPARE_GREETER,
+    SEAT_PROPERTY_TYPE,
+    SEAT_PROPERTY_UNITY_COMPOSITOR_COMMAND,
+    SEAT_PROPERTY_UNITY_COMPOSITOR_TIMEOUT,
+    SEAT_PROPERTY_USER_SESSION,
+    SEAT_PROPERTY_XDMCP_KEY,
+    SEAT_PROPERTY_XDMCP_MANAGER,
+    SEAT_PROPERTY_XDMCP_PORT,
+    SEAT_PROPERTY_XMIR_COMMAND,
+    SEAT_PROPERTY_XSERVER_ALLOW_TCP,
+    SEAT_PROPERTY_XSERVER_BACKEND,
+    SEAT_PROPERTY_XSERVER_COMMAND,
+    SEAT_PROPERTY_XSERVER_CONFIG,
+    SEAT_PROPERTY_XSERVER_DISPLAY_NUMBER,
+    SEAT_PROPERTY_XSERVER_HOSTNAME,
+    SEAT_PROPERTY_XSERVER_LAYOUT,
+    SEAT_PROPERTY_XSERVER_SHARE,
+    SEAT_N_PROPERTIES
+} SeatProperty;
+
 typedef struct
 {
     GObject      parent_instance;
@@ -58,6 +116,7 @@ typedef struct
     void (*session_added)(Seat *seat, Session *session);
     void (*running_user_session)(Seat *seat, Session *session);
     void (*session_removed)(Seat *seat, Session *session);
+    void (*spare_greeter_changed)(Seat *seat);
     void (*stopped)(Seat *seat);
 } SeatClass;
 
@@ -67,6 +126,16 @@ void seat_register_module (const gchar *name, GType type);
 
 Seat *seat_new (const gchar *module_name, const gchar *name);
 
+SeatProperties *seat_properties_new (void);
+
+SeatProperties *seat_properties_ref (SeatProperties *properties);
+
+void seat_properties_unref (SeatProperties *properties);
+
+void seat_properties_set (SeatProperties *properties, const gchar *name, const gchar *value);
+
+void seat_set_properties (Seat *seat, SeatProperties *properties);
+
 void seat_set_property (Seat *seat, const gchar *name, const gchar *value);
 
 const gchar *seat_get_string_property (Seat *seat, const gchar *name);
@@ -77,6 +146,14 @@ gboolean seat_get_boolean_property (Seat *seat, const gchar *name);
 
 gint seat_get_integer_property (Seat *seat, const gchar *name);
 
+const gchar *seat_get_string (Seat *seat, SeatProperty property);
+
+gchar **seat_get_string_list (Seat *seat, SeatProperty property);
+
+gboolean seat_get_boolean (Seat *seat, SeatProperty property);
+
+gint seat_get_integer (Seat *seat, SeatProperty property);
+
 const gchar *seat_get_name (Seat *seat);
 
 void seat_set_supports_multi_session (Seat *seat, gboolean supports_multi_session);
@@ -101,6 +178,8 @@ Session *seat_find_session_by_login1_id (Seat *seat, const gchar *login1_session
 
 gboolean seat_get_can_switch (Seat *seat);
 
+gboolean seat_get_spare_greeter_ready (Seat *seat);
+
 gboolean seat_get_allow_guest (Seat *seat);
 
 gboolean seat_get_greeter_allow_guest (Seat *seat);
@@ -16,6 +16,7 @@
 #include <utmp.h>
 #include <utmpx.h>
 #include <sys/mman.h>
+#include <dirent.h>
 
 #if HAVE_LIBAUDIT
 #include <libaudit.h>
@@ -43,6 +44,9 @@ static gboolean do_authenticate;
 static gboolean authentication_complete = FALSE;
 static pam_handle_t *pam_handle;
 
+/* Time spent waiting for the user to answer PAM prompts, not counted in the PAM timings */
+static gint64 prompt_wait_time = 0;
+
 /* Maximum length of a string to pass between daemon and session */
 #define MAX_STRING_LENGTH 65535
 
@@ -105,6 +109,38 @@ read_string (void)
     return read_string_full (g_malloc);
 }
 
+/* Close everything except stdio and the daemon pipes, a child started in advance
+ * holds whatever the daemon had open when it was forked */
+static void
+close_inherited_fds (void)
+{
+    DIR *dir;
+    struct dirent *entry;
+    GArray *fds;
+    guint i;
+
+    dir = opendir ("/proc/self/fd");
+    if (!dir)
+        return;
+
+    fds = g_array_new (FALSE, FALSE, sizeof (int));
+    while ((entry = readdir (dir)) != NULL)
+    {
+        int fd;
+
+        if (entry->d_name[0] == '.')
+            continue;
+        fd = atoi (entry->d_name);
+        if (fd > STDERR_FILENO && fd != dirfd (dir) && fd != from_daemon_output && fd != to_daemon_input)
+            g_array_append_val (fds, fd);
+    }
+    closedir (dir);
+
+    for (i = 0; i < fds->len; i++)
+        close (g_array_index (fds, int, i));
+    g_array_free (fds, TRUE);
+}
+
 static int
 pam_conv_cb (int msg_length, const struct pam_message **msg, struct pam_response **resp, void *app_data)
 {
@@ -112,6 +148,7 @@ pam_conv_cb (int msg_length, const struct pam_message **msg, struct pam_response
     gboolean auth_complete = FALSE;
     struct pam_response *response;
     gchar *username = NULL;
+    gint64 wait_start;
 
     /* FIXME: We don't support communication after pam_authenticate completes */
     if (authentication_complete)
@@ -148,9 +185,13 @@ pam_conv_cb (int msg_length, const struct pam_message **msg, struct pam_response
     }
 
     /* Get response */
+    wait_start = g_get_monotonic_time ();
     read_data (&error, sizeof (error));
     if (error != PAM_SUCCESS)
+    {
+        prompt_wait_time += g_get_monotonic_time () - wait_start;
         return error;
+    }
     response = calloc (msg_length, sizeof (struct pam_response));
     for (i = 0; i < msg_length; i++)
     {
@@ -160,6 +201,7 @@ pam_conv_cb (int msg_length, const struct pam_message **msg, struct pam_response
         r->resp = read_string_full (malloc);
         read_data (&r->resp_retcode, sizeof (r->resp_retcode));
     }
+    prompt_wait_time += g_get_monotonic_time () - wait_start;
 
     *resp = response;
     return PAM_SUCCESS;
@@ -277,6 +319,7 @@ session_child_run (int argc, char **argv)
     GDBusConnection *bus;
     const gchar *login1_session_id = NULL;
     gchar *console_kit_cookie = NULL;
+    gint64 start_time, authenticate_duration = -1, acct_mgmt_duration = -1, setcred_duration, open_session_duration;
     const gchar *locale_value;
     gchar *locale_var;
     static const gchar * const locale_var_names[] = {
@@ -322,9 +365,9 @@ session_child_run (int argc, char **argv)
     close (fd);
 
     /* Get the pipe from the daemon */
-    if (argc != 4)
+    if (argc != 4 && !(argc == 5 && strcmp (argv[4], "pooled") == 0))
     {
-        g_printerr ("Usage: lightdm --session-child INPUTFD OUTPUTFD\n");
+        g_printerr ("Usage: lightdm --session-child INPUTFD OUTPUTFD [pooled]\n");
         return EXIT_FAILURE;
     }
     from_daemon_output = atoi (argv[2]);
@@ -340,7 +383,29 @@ session_child_run (int argc, char **argv)
     fcntl (to_daemon_input, F_SETFD, FD_CLOEXEC);
 
     /* Read a version number so we can handle upgrades (i.e. a newer version of session child is run for an old daemon */
-    read_data (&version, sizeof (version));
+    if (read_data (&version, sizeof (version)) != sizeof (version))
+    {
+        /* Daemon went away before using us (e.g. we were waiting in the session child pool) */
+        return EXIT_FAILURE;
+    }
+
+    /* If we were waiting in the pool use the daemon's current environment and drop anything it had open when we were started */
+    if (argc == 5)
+    {
+        int n_env;
+
+        if (read_data (&n_env, sizeof (n_env)) != sizeof (n_env))
+            return EXIT_FAILURE;
+        clearenv ();
+        for (i = 0; i < n_env; i++)
+        {
+            gchar *value = read_string ();
+            if (value)
+                putenv (value);
+        }
+
+        close_inherited_fds ();
+    }
 
     service = read_string ();
     username = read_string ();
@@ -387,7 +452,10 @@ session_child_run (int argc, char **argv)
     {
         const gchar *new_username;
 
+        start_time = g_get_monotonic_time ();
+        prompt_wait_time = 0;
         authentication_result = pam_authenticate (pam_handle, 0);
+        authenticate_duration = g_get_monotonic_time () - start_time - prompt_wait_time;
 
         /* See what user we ended up as */
         if (pam_get_item (pam_handle, PAM_USER, (const void **) &new_username) != PAM_SUCCESS)
@@ -429,7 +497,12 @@ session_child_run (int argc, char **argv)
 
         /* Check account is valid */
         if (authentication_result == PAM_SUCCESS)
+        {
+            start_time = g_get_monotonic_time ();
+            prompt_wait_time = 0;
             authentication_result = pam_acct_mgmt (pam_handle, 0);
+            acct_mgmt_duration = g_get_monotonic_time () - start_time - prompt_wait_time;
+        }
         if (authentication_result == PAM_NEW_AUTHTOK_REQD)
             authentication_result = pam_chauthtok (pam_handle, PAM_CHANGE_EXPIRED_AUTHTOK);
     }
@@ -475,6 +548,11 @@ session_child_run (int argc, char **argv)
     write_data (&auth_complete, sizeof (auth_complete));
     write_data (&authentication_result, sizeof (authentication_result));
     write_string (authentication_result_string);
+    if (version >= 4)
+    {
+        write_data (&authenticate_duration, sizeof (authenticate_duration));
+        write_data (&acct_mgmt_duration, sizeof (acct_mgmt_duration));
+    }
 
     /* Check we got a valid user */
     if (!username)
@@ -556,7 +634,9 @@ session_child_run (int argc, char **argv)
     }
 
     /* Set credentials */
+    start_time = g_get_monotonic_time ();
     result = pam_setcred (pam_handle, PAM_ESTABLISH_CRED);
+    setcred_duration = g_get_monotonic_time () - start_time;
     if (result != PAM_SUCCESS)
     {
         g_printerr ("Failed to establish PAM credentials: %s\n", pam_strerror (pam_handle, result));
@@ -565,7 +645,9 @@ session_child_run (int argc, char **argv)
     }
 
     /* Open the session */
+    start_time = g_get_monotonic_time ();
     result = pam_open_session (pam_handle, 0);
+    open_session_duration = g_get_monotonic_time () - start_time;
     if (result != PAM_SUCCESS)
     {
         g_printerr ("Failed to open PAM session: %s\n", pam_strerror (pam_handle, result));
@@ -635,6 +717,13 @@ session_child_run (int argc, char **argv)
         }
     }
 
+    /* Report how long the session took to set up */
+    if (version >= 4)
+    {
+        write_data (&setcred_duration, sizeof (setcred_duration));
+        write_data (&open_session_duration, sizeof (open_session_duration));
+    }
+
     /* Write X authority */
     if (x_authority)
     {
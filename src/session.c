@@ -22,12 +22,14 @@
 #include <pwd.h>
 
 #include "session.h"
+#include "child-watch.h"
 #include "configuration.h"
 #include "console-kit.h"
 #include "login1.h"
 #include "guest-account.h"
 #include "shared-data-manager.h"
 #include "greeter-socket.h"
+#include "trace.h"
 
 enum {
     CREATE_GREETER,
@@ -54,7 +56,7 @@ struct SessionPrivate
     int from_child_output;
     GIOChannel *from_child_channel;
     guint from_child_watch;
-    guint child_watch;
+    ChildWatch *child_watch;
 
     /* User to authenticate as */
     gchar *username;
@@ -84,6 +86,13 @@ struct SessionPrivate
     int authentication_result;
     gchar *authentication_result_string;
 
+    /* Time session was started and how long each PAM phase took (-1 if not run) */
+    gint64 start_time;
+    gint64 authenticate_duration;
+    gint64 acct_mgmt_duration;
+    gint64 setcred_duration;
+    gint64 open_session_duration;
+
     /* File to log to */
     gchar *log_filename;
     LogMode log_mode;
@@ -111,6 +120,9 @@ struct SessionPrivate
     /* Environment to set in child */
     GList *env;
 
+    /* TRUE if the child uses file descriptors opened by the daemon */
+    gboolean inherit_fds;
+
     /* Command to run in child */
     gchar **argv;
 
@@ -124,6 +136,24 @@ struct SessionPrivate
 /* Maximum length of a string to pass between daemon and session */
 #define MAX_STRING_LENGTH 65535
 
+/* Session child process that has been started in advance and is waiting for its configuration */
+typedef struct
+{
+    GPid pid;
+    int to_child_input;
+    int from_child_output;
+    ChildWatch *child_watch;
+} SessionChild;
+
+/* Number of session child processes to keep waiting */
+static guint child_pool_size = 0;
+
+/* Waiting session child processes */
+static GQueue child_pool = G_QUEUE_INIT;
+
+/* Idle source to start session child processes */
+static guint child_pool_fill_idle = 0;
+
 static void session_logger_iface_init (LoggerInterface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (Session, session, G_TYPE_OBJECT,
@@ -203,6 +233,15 @@ session_get_is_guest (Session *session)
     return session->priv->is_guest;
 }
 
+/* Set if file descriptors opened by the daemon are passed to the session, which
+ * means it can't use a child started in advance as it wouldn't have them */
+void
+session_set_inherit_fds (Session *session, gboolean inherit_fds)
+{
+    g_return_if_fail (session != NULL);
+    session->priv->inherit_fds = inherit_fds;
+}
+
 void
 session_set_log_file (Session *session, const gchar *filename, LogMode log_mode)
 {
@@ -438,13 +477,18 @@ session_watch_cb (GPid pid, gint status, gpointer data)
 {
     Session *session = data;
 
-    session->priv->child_watch = 0;
+    child_watch_free (session->priv->child_watch);
+    session->priv->child_watch = NULL;
 
     if (WIFEXITED (status))
         l_debug (session, "Exited with return value %d", WEXITSTATUS (status));
     else if (WIFSIGNALED (status))
         l_debug (session, "Terminated with signal %d", WTERMSIG (status));
 
+    if (session->priv->authentication_started && !session->priv->authentication_complete)
+        trace_end (session, "authenticate", NULL);
+    trace_end (session, "session", NULL);
+
     /* do this as late as possible for log messages prefix */
     session->priv->pid = 0;
 
@@ -511,8 +555,11 @@ from_child_cb (GIOChannel *source, GIOCondition condition, gpointer data)
         read_from_child (session, &session->priv->authentication_result, sizeof (session->priv->authentication_result));
         g_free (session->priv->authentication_result_string);
         session->priv->authentication_result_string = read_string_from_child (session);
+        read_from_child (session, &session->priv->authenticate_duration, sizeof (session->priv->authenticate_duration));
+        read_from_child (session, &session->priv->acct_mgmt_duration, sizeof (session->priv->acct_mgmt_duration));
 
         l_debug (session, "Authentication complete with return value %d: %s", session->priv->authentication_result, session->priv->authentication_result_string);
+        trace_end (session, "authenticate", NULL);
 
         /* No longer expect any more messages */
         session->priv->from_child_watch = 0;
@@ -546,8 +593,19 @@ from_child_cb (GIOChannel *source, GIOCondition condition, gpointer data)
 gboolean
 session_start (Session *session)
 {
+    gboolean result;
+
     g_return_val_if_fail (session != NULL, FALSE);
-    return SESSION_GET_CLASS (session)->start (session);
+
+    session->priv->start_time = g_get_monotonic_time ();
+    result = SESSION_GET_CLASS (session)->start (session);
+    if (result)
+    {
+        trace_begin (session, "session", NULL);
+        trace_begin (session, "authenticate", NULL);
+    }
+
+    return result;
 }
 
 gboolean
@@ -556,6 +614,33 @@ session_get_is_started (Session *session)
     return session->priv->pid != 0;
 }
 
+gint64
+session_get_start_time (Session *session)
+{
+    g_return_val_if_fail (session != NULL, 0);
+    return session->priv->start_time;
+}
+
+gint64
+session_get_pam_duration (Session *session, LoginMetric metric)
+{
+    g_return_val_if_fail (session != NULL, -1);
+
+    switch (metric)
+    {
+    case LOGIN_METRIC_PAM_AUTHENTICATE:
+        return session->priv->authenticate_duration;
+    case LOGIN_METRIC_PAM_ACCT_MGMT:
+        return session->priv->acct_mgmt_duration;
+    case LOGIN_METRIC_PAM_SETCRED:
+        return session->priv->setcred_duration;
+    case LOGIN_METRIC_PAM_OPEN_SESSION:
+        return session->priv->open_session_duration;
+    default:
+        return -1;
+    }
+}
+
 static Greeter *
 create_greeter_cb (GreeterSocket *socket, Session *session)
 {
@@ -565,65 +650,175 @@ create_greeter_cb (GreeterSocket *socket, Session *session)
 }
 
 static gboolean
-session_real_start (Session *session)
+spawn_session_child (gboolean pooled, GPid *pid, int *to_child_input, int *from_child_output)
 {
-    int version;
     int to_child_pipe[2], from_child_pipe[2];
-    int to_child_output, from_child_input;
     gchar *arg0, *arg1;
 
-    g_return_val_if_fail (session->priv->pid == 0, FALSE);
-
-    if (session->priv->display_server)
-        display_server_connect_session (session->priv->display_server, session);
-
     /* Create pipes to talk to the child */
-    if (pipe (to_child_pipe) < 0 || pipe (from_child_pipe) < 0)
+    if (pipe (to_child_pipe) < 0)
     {
         g_warning ("Failed to create pipe to communicate with session process: %s", strerror (errno));
         return FALSE;
     }
-    to_child_output = to_child_pipe[0];
-    session->priv->to_child_input = to_child_pipe[1];
-    session->priv->from_child_output = from_child_pipe[0];
-    from_child_input = from_child_pipe[1];
-    session->priv->from_child_channel = g_io_channel_unix_new (session->priv->from_child_output);
-    session->priv->from_child_watch = g_io_add_watch (session->priv->from_child_channel, G_IO_IN | G_IO_HUP, from_child_cb, session);
-
-    /* Don't allow the daemon end of the pipes to be accessed in child processes */
-    fcntl (session->priv->to_child_input, F_SETFD, FD_CLOEXEC);
-    fcntl (session->priv->from_child_output, F_SETFD, FD_CLOEXEC);
-
-    /* Create the guest account if it is one */
-    if (session->priv->is_guest && session->priv->username == NULL)
+    if (pipe (from_child_pipe) < 0)
     {
-        session->priv->username = guest_account_setup ();
-        if (!session->priv->username)
-            return FALSE;
+        g_warning ("Failed to create pipe to communicate with session process: %s", strerror (errno));
+        close (to_child_pipe[0]);
+        close (to_child_pipe[1]);
+        return FALSE;
     }
 
+    /* Don't allow the daemon end of the pipes to be accessed in child processes */
+    fcntl (to_child_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl (from_child_pipe[0], F_SETFD, FD_CLOEXEC);
+
     /* Run the child */
-    arg0 = g_strdup_printf ("%d", to_child_output);
-    arg1 = g_strdup_printf ("%d", from_child_input);
-    session->priv->pid = fork ();
-    if (session->priv->pid == 0)
+    arg0 = g_strdup_printf ("%d", to_child_pipe[0]);
+    arg1 = g_strdup_printf ("%d", from_child_pipe[1]);
+    *pid = fork ();
+    if (*pid == 0)
     {
         /* Run us again in session child mode */
         execlp ("lightdm",
                 "lightdm",
                 "--session-child",
-                arg0, arg1, NULL);
+                arg0, arg1,
+                pooled ? "pooled" : NULL, NULL);
         _exit (EXIT_FAILURE);
     }
     g_free (arg0);
     g_free (arg1);
 
-    if (session->priv->pid < 0)
+    /* Close the ends of the pipes we don't need */
+    close (to_child_pipe[0]);
+    close (from_child_pipe[1]);
+
+    if (*pid < 0)
     {
         g_debug ("Failed to fork session child process: %s", strerror (errno));
+        close (to_child_pipe[1]);
+        close (from_child_pipe[0]);
         return FALSE;
     }
 
+    *to_child_input = to_child_pipe[1];
+    *from_child_output = from_child_pipe[0];
+
+    return TRUE;
+}
+
+static void
+pooled_child_watch_cb (GPid pid, gint status, gpointer data)
+{
+    SessionChild *child = data;
+
+    /* Waiting children should only exit if we have dropped them from the pool */
+    if (g_queue_find (&child_pool, child))
+    {
+        g_warning ("Waiting session child process %d exited unexpectedly", pid);
+        g_queue_remove (&child_pool, child);
+    }
+
+    if (child->to_child_input >= 0)
+        close (child->to_child_input);
+    if (child->from_child_output >= 0)
+        close (child->from_child_output);
+    child_watch_free (child->child_watch);
+    g_free (child);
+}
+
+static gboolean
+fill_child_pool_cb (gpointer data)
+{
+    child_pool_fill_idle = 0;
+
+    while (g_queue_get_length (&child_pool) < child_pool_size)
+    {
+        SessionChild *child;
+
+        child = g_malloc0 (sizeof (SessionChild));
+        if (!spawn_session_child (TRUE, &child->pid, &child->to_child_input, &child->from_child_output))
+        {
+            g_free (child);
+            break;
+        }
+        child->child_watch = child_watch_new (child->pid, pooled_child_watch_cb, child);
+        g_queue_push_tail (&child_pool, child);
+    }
+
+    return FALSE;
+}
+
+static void
+fill_child_pool (void)
+{
+    /* Start new children once the current request is handled so they don't add to its latency */
+    if (child_pool_fill_idle == 0 && g_queue_get_length (&child_pool) < child_pool_size)
+        child_pool_fill_idle = g_idle_add_full (G_PRIORITY_LOW, fill_child_pool_cb, NULL, NULL);
+}
+
+void
+session_set_child_pool_size (guint size)
+{
+    child_pool_size = size;
+
+    /* Drop any extra children, they exit when their pipes close and are freed when they are reaped */
+    while (g_queue_get_length (&child_pool) > child_pool_size)
+    {
+        SessionChild *child = g_queue_pop_tail (&child_pool);
+
+        close (child->to_child_input);
+        child->to_child_input = -1;
+        close (child->from_child_output);
+        child->from_child_output = -1;
+    }
+
+    fill_child_pool ();
+}
+
+static gboolean
+session_real_start (Session *session)
+{
+    int version;
+    SessionChild *child = NULL;
+    gboolean pooled = FALSE;
+
+    g_return_val_if_fail (session->priv->pid == 0, FALSE);
+
+    if (session->priv->display_server)
+        display_server_connect_session (session->priv->display_server, session);
+
+    /* Create the guest account if it is one */
+    if (session->priv->is_guest && session->priv->username == NULL)
+    {
+        session->priv->username = guest_account_setup ();
+        if (!session->priv->username)
+            return FALSE;
+    }
+
+    /* Use a child that has already been started if one is available, otherwise start a new one */
+    if (!session->priv->inherit_fds)
+        child = g_queue_pop_head (&child_pool);
+    if (child)
+    {
+        child_watch_free (child->child_watch);
+        session->priv->pid = child->pid;
+        session->priv->to_child_input = child->to_child_input;
+        session->priv->from_child_output = child->from_child_output;
+        g_free (child);
+        pooled = TRUE;
+    }
+    else if (!spawn_session_child (FALSE, &session->priv->pid, &session->priv->to_child_input, &session->priv->from_child_output))
+    {
+        session->priv->pid = 0;
+        return FALSE;
+    }
+    fill_child_pool ();
+
+    session->priv->from_child_channel = g_io_channel_unix_new (session->priv->from_child_output);
+    session->priv->from_child_watch = g_io_add_watch (session->priv->from_child_channel, G_IO_IN | G_IO_HUP, from_child_cb, session);
+
     /* Hold a reference on this object until the child process terminates so we
      * can handle the watch callback even if it is no longer used. Otherwise a
      * zombie process will remain */
@@ -631,16 +826,26 @@ session_real_start (Session *session)
 
     /* Listen for session termination */
     session->priv->authentication_started = TRUE;
-    session->priv->child_watch = g_child_watch_add (session->priv->pid, session_watch_cb, session);
-
-    /* Close the ends of the pipes we don't need */
-    close (to_child_output);
-    close (from_child_input);
+    session->priv->child_watch = child_watch_new (session->priv->pid, session_watch_cb, session);
 
     /* Indicate what version of the protocol we are using */
-    version = 3;
+    version = 4;
     write_data (session, &version, sizeof (version));
 
+    /* Children started in advance replace the environment they were started with by the current one */
+    if (pooled)
+    {
+        gchar **env;
+        int i, n_env;
+
+        env = g_get_environ ();
+        n_env = g_strv_length (env);
+        write_data (session, &n_env, sizeof (n_env));
+        for (i = 0; i < n_env; i++)
+            write_string (session, env[i]);
+        g_strfreev (env);
+    }
+
     /* Send configuration */
     write_string (session, session->priv->pam_service);
     write_string (session, session->priv->username);
@@ -750,6 +955,7 @@ session_run (Session *session)
 {
     g_return_if_fail (session != NULL);
     g_return_if_fail (session->priv->display_server != NULL);
+    trace_instant (session, "run", NULL);
     return SESSION_GET_CLASS (session)->run (session);
 }
 
@@ -867,6 +1073,8 @@ session_real_run (Session *session)
 
     session->priv->login1_session_id = read_string_from_child (session);
     session->priv->console_kit_cookie = read_string_from_child (session);
+    read_from_child (session, &session->priv->setcred_duration, sizeof (session->priv->setcred_duration));
+    read_from_child (session, &session->priv->open_session_duration, sizeof (session->priv->open_session_duration));
 }
 
 void
@@ -951,7 +1159,7 @@ session_real_stop (Session *session)
     if (session->priv->pid > 0)
     {
         l_debug (session, "Sending SIGTERM");
-        kill (session->priv->pid, SIGTERM);
+        child_watch_signal (session->priv->child_watch, SIGTERM);
         // FIXME: Handle timeout
     }
     else
@@ -973,6 +1181,10 @@ session_init (Session *session)
     session->priv->log_mode = LOG_MODE_BACKUP_AND_TRUNCATE;
     session->priv->to_child_input = -1;
     session->priv->from_child_output = -1;
+    session->priv->authenticate_duration = -1;
+    session->priv->acct_mgmt_duration = -1;
+    session->priv->setcred_duration = -1;
+    session->priv->open_session_duration = -1;
 }
 
 static void
@@ -983,16 +1195,15 @@ session_finalize (GObject *object)
 
     g_clear_object (&self->priv->config);
     g_clear_object (&self->priv->display_server);
-    if (self->priv->pid)
-        kill (self->priv->pid, SIGKILL);
+    if (self->priv->child_watch)
+        child_watch_signal (self->priv->child_watch, SIGKILL);
     close (self->priv->to_child_input);
     close (self->priv->from_child_output);
     if (self->priv->from_child_channel)
         g_io_channel_unref (self->priv->from_child_channel);
     if (self->priv->from_child_watch)
         g_source_remove (self->priv->from_child_watch);
-    if (self->priv->child_watch)
-        g_source_remove (self->priv->child_watch);
+    child_watch_free (self->priv->child_watch);
     g_free (self->priv->username);
     g_clear_object (&self->priv->user);
     g_free (self->priv->pam_service);
@@ -30,6 +30,7 @@ typedef enum
 #include "x-authority.h"
 #include "logger.h"
 #include "log-file.h"
+#include "login-metrics.h"
 #include "greeter.h"
 
 G_BEGIN_DECLS
@@ -68,6 +69,8 @@ typedef struct
 
 GType session_get_type (void);
 
+void session_set_child_pool_size (guint size);
+
 Session *session_new (void);
 
 void session_set_config (Session *session, SessionConfig *config);
@@ -88,6 +91,8 @@ void session_set_is_guest (Session *session, gboolean is_guest);
 
 gboolean session_get_is_guest (Session *session);
 
+void session_set_inherit_fds (Session *session, gboolean inherit_fds);
+
 void session_set_log_file (Session *session, const gchar *filename, LogMode log_mode);
 
 void session_set_display_server (Session *session, DisplayServer *display_server);
@@ -117,6 +122,10 @@ gboolean session_start (Session *session);
 
 gboolean session_get_is_started (Session *session);
 
+gint64 session_get_start_time (Session *session);
+
+gint64 session_get_pam_duration (Session *session, LoginMetric metric);
+
 const gchar *session_get_username (Session *session);
 
 const gchar *session_get_login1_session_id (Session *session);
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include "timer-wheel.h"
+
+/* Each level has 64 slots and covers 64 times the range of the level below */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+
+/* Longest timeout in ticks, later timers are clamped to this */
+#define MAX_TICKS ((G_GUINT64_CONSTANT (1) << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+struct TimerWheel
+{
+    /* Length of a tick in microseconds */
+    gint64 tick_us;
+
+    /* Time ticks are counted from */
+    gint64 start_time;
+
+    /* Next tick to process */
+    guint64 now;
+
+    /* Timers waiting in each slot */
+    TimerWheelLink slots[WHEEL_LEVELS][WHEEL_SIZE];
+
+    /* Number of timers scheduled */
+    guint n_timers;
+
+    /* Source that turns the wheel while timers are scheduled */
+    guint source;
+};
+
+static void
+list_init (TimerWheelLink *head)
+{
+    head->next = head->prev = head;
+}
+
+static void
+list_append (TimerWheelLink *head, TimerWheelLink *link)
+{
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void
+list_remove (TimerWheelLink *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->next = link->prev = NULL;
+}
+
+/* Move all the entries from one list to an empty one */
+static void
+list_move (TimerWheelLink *from, TimerWheelLink *to)
+{
+    list_init (to);
+    if (from->next == from)
+        return;
+
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    list_init (from);
+}
+
+static guint64
+get_current_tick (TimerWheel *wheel)
+{
+    return (g_get_monotonic_time () - wheel->start_time) / wheel->tick_us;
+}
+
+static void
+insert_timer (TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    guint64 delta = timer->expiry - wheel->now;
+    guint level;
+
+    /* Put timers on the lowest level that reaches them, they move down as the higher levels come round */
+    for (level = 0; level < WHEEL_LEVELS - 1; level++)
+        if (delta < (G_GUINT64_CONSTANT (1) << (WHEEL_BITS * (level + 1))))
+            break;
+
+    list_append (&wheel->slots[level][(timer->expiry >> (WHEEL_BITS * level)) & WHEEL_MASK], &timer->link);
+}
+
+/* Redistribute the timers in a slot to the levels below */
+static void
+cascade (TimerWheel *wheel, guint level, guint index)
+{
+    TimerWheelLink timers;
+
+    list_move (&wheel->slots[level][index], &timers);
+    while (timers.next != &timers)
+    {
+        TimerWheelTimer *timer = (TimerWheelTimer *) timers.next;
+
+        list_remove (&timer->link);
+        insert_timer (wheel, timer);
+    }
+}
+
+static void
+run_tick (TimerWheel *wheel)
+{
+    TimerWheelLink expired;
+    guint index, level;
+
+    /* Each time a level wraps around bring down the timers from the next slot of the level above */
+    index = wheel->now & WHEEL_MASK;
+    for (level = 1; level < WHEEL_LEVELS && index == 0; level++)
+    {
+        index = (wheel->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        cascade (wheel, level, index);
+    }
+
+    list_move (&wheel->slots[0][wheel->now & WHEEL_MASK], &expired);
+    wheel->now++;
+
+    /* Note callbacks may add and remove timers, including others that have expired */
+    while (expired.next != &expired)
+    {
+        TimerWheelTimer *timer = (TimerWheelTimer *) expired.next;
+
+        list_remove (&timer->link);
+        wheel->n_timers--;
+        timer->func (timer->data);
+    }
+}
+
+static gboolean
+tick_cb (gpointer data)
+{
+    TimerWheel *wheel = data;
+    guint64 tick;
+
+    /* Catch up if the main loop was busy */
+    tick = get_current_tick (wheel);
+    while (wheel->n_timers > 0 && wheel->now <= tick)
+        run_tick (wheel);
+
+    if (wheel->n_timers > 0)
+        return G_SOURCE_CONTINUE;
+
+    wheel->source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+TimerWheel *
+timer_wheel_new (guint tick_ms)
+{
+    TimerWheel *wheel;
+    guint level, i;
+
+    g_return_val_if_fail (tick_ms > 0, NULL);
+
+    wheel = g_malloc0 (sizeof (TimerWheel));
+    wheel->tick_us = (gint64) tick_ms * 1000;
+    wheel->start_time = g_get_monotonic_time ();
+    for (level = 0; level < WHEEL_LEVELS; level++)
+        for (i = 0; i < WHEEL_SIZE; i++)
+            list_init (&wheel->slots[level][i]);
+
+    return wheel;
+}
+
+void
+timer_wheel_timer_init (TimerWheelTimer *timer, TimerWheelFunc func, gpointer data)
+{
+    g_return_if_fail (timer != NULL);
+
+    timer->link.next = timer->link.prev = NULL;
+    timer->expiry = 0;
+    timer->func = func;
+    timer->data = data;
+}
+
+void
+timer_wheel_add (TimerWheel *wheel, TimerWheelTimer *timer, guint timeout_ms)
+{
+    guint64 ticks, tick;
+
+    g_return_if_fail (wheel != NULL);
+    g_return_if_fail (timer != NULL);
+    g_return_if_fail (timer->func != NULL);
+
+    /* Adding a scheduled timer moves it */
+    if (timer_wheel_timer_is_pending (timer))
+    {
+        list_remove (&timer->link);
+        wheel->n_timers--;
+    }
+
+    /* Nothing is waiting so the wheel can skip forward to the current time */
+    tick = get_current_tick (wheel) + 1;
+    if (wheel->n_timers == 0)
+        wheel->now = tick;
+
+    /* Round up so timers never fire early */
+    ticks = ((guint64) timeout_ms * 1000 + wheel->tick_us - 1) / wheel->tick_us;
+    timer->expiry = tick + MIN (ticks, MAX_TICKS - (tick - wheel->now));
+    insert_timer (wheel, timer);
+    wheel->n_timers++;
+
+    if (!wheel->source)
+        wheel->source = g_timeout_add (wheel->tick_us / 1000, tick_cb, wheel);
+}
+
+void
+timer_wheel_remove (TimerWheel *wheel, TimerWheelTimer *timer)
+{
+    g_return_if_fail (wheel != NULL);
+    g_return_if_fail (timer != NULL);
+
+    if (!timer_wheel_timer_is_pending (timer))
+        return;
+
+    list_remove (&timer->link);
+    wheel->n_timers--;
+
+    if (wheel->n_timers == 0 && wheel->source)
+    {
+        g_source_remove (wheel->source);
+        wheel->source = 0;
+    }
+}
+
+gboolean
+timer_wheel_timer_is_pending (TimerWheelTimer *timer)
+{
+    g_return_val_if_fail (timer != NULL, FALSE);
+    return timer->link.next != NULL;
+}
+
+guint
+timer_wheel_get_n_timers (TimerWheel *wheel)
+{
+    g_return_val_if_fail (wheel != NULL, 0);
+    return wheel->n_timers;
+}
+
+void
+timer_wheel_free (TimerWheel *wheel)
+{
+    guint level, i;
+
+    if (!wheel)
+        return;
+
+    if (wheel->source)
+        g_source_remove (wheel->source);
+
+    /* Leave the timers unscheduled so their owners don't refer to the freed wheel */
+    for (level = 0; level < WHEEL_LEVELS; level++)
+        for (i = 0; i < WHEEL_SIZE; i++)
+            while (wheel->slots[level][i].next != &wheel->slots[level][i])
+                list_remove (wheel->slots[level][i].next);
+
+    g_free (wheel);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct TimerWheel TimerWheel;
+
+typedef struct TimerWheelLink TimerWheelLink;
+
+struct TimerWheelLink
+{
+    TimerWheelLink *next, *prev;
+};
+
+typedef void (*TimerWheelFunc) (gpointer data);
+
+/* Timer to be embedded in the object being timed, so scheduling doesn't allocate */
+typedef struct
+{
+    /* Private */
+    TimerWheelLink link;
+    guint64 expiry;
+    TimerWheelFunc func;
+    gpointer data;
+} TimerWheelTimer;
+
+TimerWheel *timer_wheel_new (guint tick_ms);
+
+void timer_wheel_timer_init (TimerWheelTimer *timer, TimerWheelFunc func, gpointer data);
+
+void timer_wheel_add (TimerWheel *wheel, TimerWheelTimer *timer, guint timeout_ms);
+
+void timer_wheel_remove (TimerWheel *wheel, TimerWheelTimer *timer);
+
+gboolean timer_wheel_timer_is_pending (TimerWheelTimer *timer);
+
+guint timer_wheel_get_n_timers (TimerWheel *wheel);
+
+void timer_wheel_free (TimerWheel *wheel);
+
+G_END_DECLS
+
+#endif /* TIMER_WHEEL_H_ */
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <unistd.h>
+
+/* Use static probes if the system supports them, with a semaphore so the
+ * probe arguments are only worked out while a tracer is attached */
+#ifdef HAVE_SYS_SDT_H
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+unsigned short lightdm_trace_semaphore __attribute__ ((unused)) __attribute__ ((section (".probes")));
+#define LIGHTDM_TRACE_ENABLED() __builtin_expect (lightdm_trace_semaphore, 0)
+#endif
+
+#include "trace.h"
+#include "logger.h"
+
+/* Maximum length of the label describing the object (e.g. "Seat seat0") */
+#define MAX_LABEL_LENGTH 48
+
+typedef struct
+{
+    /* Position in the event stream this slot was written for, zero while being written */
+    volatile gint sequence;
+
+    gint64 timestamp;
+    gchar phase;
+    const gchar *category;
+    const gchar *name;
+    gconstpointer id;
+    gchar label[MAX_LABEL_LENGTH];
+} TraceEvent;
+
+/* Ring buffer of recent events, NULL if tracing is disabled */
+static TraceEvent *events = NULL;
+static guint n_events = 0;
+
+/* Number of events recorded (wraps) */
+static volatile gint n_recorded = 0;
+
+void
+trace_init (guint size)
+{
+    if (events || size == 0)
+        return;
+
+    /* Use a power of two so the index still works when the counter wraps */
+    n_events = 1;
+    while (n_events < size && n_events < G_MAXINT / 2)
+        n_events <<= 1;
+    events = g_malloc0 (sizeof (TraceEvent) * n_events);
+
+    g_debug ("Tracing enabled with %u events", n_events);
+}
+
+gboolean
+trace_get_enabled (void)
+{
+    return events != NULL;
+}
+
+static void
+get_label (gpointer object, const gchar *label, gchar *buf, gsize buflen)
+{
+    gsize length;
+
+    if (label)
+    {
+        g_strlcpy (buf, label, buflen);
+        return;
+    }
+
+    buf[0] = '\0';
+    if (!IS_LOGGER (object))
+        return;
+
+    /* Use the log prefix without the trailing ": " */
+    logger_logprefix (LOGGER (object), buf, buflen);
+    length = strlen (buf);
+    if (length >= 2 && strcmp (buf + length - 2, ": ") == 0)
+        buf[length - 2] = '\0';
+}
+
+static void
+record (gchar phase, gpointer object, const gchar *name, const gchar *label)
+{
+    TraceEvent *event;
+    guint sequence;
+
+#ifdef LIGHTDM_TRACE_ENABLED
+    if (LIGHTDM_TRACE_ENABLED ())
+    {
+        gchar probe_label[MAX_LABEL_LENGTH];
+
+        get_label (object, label, probe_label, sizeof (probe_label));
+        DTRACE_PROBE4 (lightdm, trace, phase, G_OBJECT_TYPE_NAME (object), name, probe_label);
+    }
+#endif
+
+    if (!events)
+        return;
+
+    /* Claim a slot, writers never block each other */
+    sequence = (guint) g_atomic_int_add (&n_recorded, 1) + 1;
+    event = &events[(sequence - 1) & (n_events - 1)];
+
+    g_atomic_int_set (&event->sequence, 0);
+    event->timestamp = g_get_monotonic_time ();
+    event->phase = phase;
+    event->category = G_OBJECT_TYPE_NAME (object);
+    event->name = name;
+    event->id = object;
+    get_label (object, label, event->label, sizeof (event->label));
+    g_atomic_int_set (&event->sequence, (gint) sequence);
+}
+
+void
+trace_begin (gpointer object, const gchar *name, const gchar *label)
+{
+    g_return_if_fail (G_IS_OBJECT (object));
+    record ('b', object, name, label);
+}
+
+void
+trace_end (gpointer object, const gchar *name, const gchar *label)
+{
+    g_return_if_fail (G_IS_OBJECT (object));
+    record ('e', object, name, label);
+}
+
+void
+trace_instant (gpointer object, const gchar *name, const gchar *label)
+{
+    g_return_if_fail (G_IS_OBJECT (object));
+    record ('n', object, name, label);
+}
+
+static void
+append_json_string (GString *json, const gchar *value)
+{
+    const gchar *c;
+
+    g_string_append_c (json, '"');
+    for (c = value; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            g_string_append_printf (json, "\\%c", *c);
+        else if ((guchar) *c < 0x20)
+            g_string_append_printf (json, "\\u%04x", *c);
+        else
+            g_string_append_c (json, *c);
+    }
+    g_string_append_c (json, '"');
+}
+
+/* Write events in the Chrome trace event format, as understood by chrome://tracing and similar tools */
+gchar *
+trace_to_json (void)
+{
+    GString *json;
+    guint end, start, i;
+    gboolean first = TRUE;
+
+    json = g_string_new ("{\"traceEvents\":[");
+
+    if (events)
+    {
+        end = (guint) g_atomic_int_get (&n_recorded);
+        start = end > n_events ? end - n_events : 0;
+        for (i = start; i != end; i++)
+        {
+            TraceEvent *event = &events[i & (n_events - 1)];
+            TraceEvent copy;
+
+            /* Skip events that are being written or have been overwritten since */
+            copy = *event;
+            if ((guint) g_atomic_int_get (&event->sequence) != i + 1 || (guint) copy.sequence != i + 1)
+                continue;
+
+            if (!first)
+                g_string_append_c (json, ',');
+            first = FALSE;
+
+            g_string_append (json, "{\"name\":");
+            append_json_string (json, copy.name);
+            g_string_append (json, ",\"cat\":");
+            append_json_string (json, copy.category);
+            g_string_append_printf (json, ",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":0,\"id\":\"%p\",\"args\":{\"object\":",
+                                    copy.phase, copy.timestamp, getpid (), copy.id);
+            append_json_string (json, copy.label);
+            g_string_append (json, "}}");
+        }
+    }
+
+    g_string_append (json, "],\"displayTimeUnit\":\"ms\"}");
+
+    return g_string_free (json, FALSE);
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+void trace_init (guint n_events);
+
+gboolean trace_get_enabled (void);
+
+void trace_begin (gpointer object, const gchar *name, const gchar *label);
+
+void trace_end (gpointer object, const gchar *name, const gchar *label);
+
+void trace_instant (gpointer object, const gchar *name, const gchar *label);
+
+gchar *trace_to_json (void);
+
+G_END_DECLS
+
+#endif /* TRACE_H_ */
@@ -335,17 +335,6 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
     return TRUE;
 }
 
-static void
-run_cb (Process *process, gpointer user_data)
-{
-    int fd;
-
-    /* Make input non-blocking */
-    fd = open ("/dev/null", O_RDONLY);
-    dup2 (fd, STDIN_FILENO);
-    close (fd);
-}
-
 static gboolean
 timeout_cb (gpointer data)
 {
@@ -414,7 +403,9 @@ unity_system_compositor_start (DisplayServer *server)
     g_free (dir);
 
     /* Setup environment */
-    compositor->priv->process = process_new (run_cb, compositor);
+    compositor->priv->process = process_new (NULL, NULL);
+    /* Make input non-blocking */
+    process_set_stdin (compositor->priv->process, -1);
     backup_logs = config_get_boolean (config_get_instance (), "LightDM", "backup-logs");
     process_set_log_file (compositor->priv->process, log_file, TRUE, backup_logs ? LOG_MODE_BACKUP_AND_TRUNCATE : LOG_MODE_APPEND);
     g_free (log_file);
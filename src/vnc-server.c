@@ -29,10 +29,14 @@ struct VNCServerPrivate
 
     /* Listening sockets */
     GSocket *socket, *socket6;
+    GSource *socket_source, *socket6_source;
 };
 
 G_DEFINE_TYPE (VNCServer, vnc_server, G_TYPE_OBJECT);
 
+/* Standard port for VNC display 0 */
+#define VNC_PORT 5900
+
 VNCServer *
 vnc_server_new (void)
 {
@@ -43,7 +47,8 @@ void
 vnc_server_set_port (VNCServer *server, guint port)
 {
     g_return_if_fail (server != NULL);
-    server->priv->port = port;
+    /* Zero means use the standard port */
+    server->priv->port = port > 0 ? port : VNC_PORT;
 }
 
 guint
@@ -134,7 +139,6 @@ open_tcp_socket (GSocketFamily family, guint port, const gchar *listen_address,
 gboolean
 vnc_server_start (VNCServer *server)
 {
-    GSource *source;
     GError *error = NULL;
 
     g_return_val_if_fail (server != NULL, FALSE);
@@ -146,9 +150,9 @@ vnc_server_start (VNCServer *server)
 
     if (server->priv->socket)
     {
-        source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->socket_source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->socket_source, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->socket_source, NULL);
     }
 
     server->priv->socket6 = open_tcp_socket (G_SOCKET_FAMILY_IPV6, server->priv->port, server->priv->listen_address, &error);
@@ -158,9 +162,9 @@ vnc_server_start (VNCServer *server)
 
     if (server->priv->socket6)
     {
-        source = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->socket6_source = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->socket6_source, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->socket6_source, NULL);
     }
 
     if (!server->priv->socket && !server->priv->socket6)
@@ -169,11 +173,32 @@ vnc_server_start (VNCServer *server)
     return TRUE;
 }
 
+void
+vnc_server_stop (VNCServer *server)
+{
+    g_return_if_fail (server != NULL);
+
+    if (server->priv->socket_source)
+    {
+        g_source_destroy (server->priv->socket_source);
+        g_source_unref (server->priv->socket_source);
+        server->priv->socket_source = NULL;
+    }
+    if (server->priv->socket6_source)
+    {
+        g_source_destroy (server->priv->socket6_source);
+        g_source_unref (server->priv->socket6_source);
+        server->priv->socket6_source = NULL;
+    }
+    g_clear_object (&server->priv->socket);
+    g_clear_object (&server->priv->socket6);
+}
+
 static void
 vnc_server_init (VNCServer *server)
 {
     server->priv = G_TYPE_INSTANCE_GET_PRIVATE (server, VNC_SERVER_TYPE, VNCServerPrivate);
-    server->priv->port = 5900;
+    vnc_server_set_port (server, 0);
 }
 
 static void
@@ -182,8 +207,7 @@ vnc_server_finalize (GObject *object)
     VNCServer *self = VNC_SERVER (object);
 
     g_free (self->priv->listen_address);
-    g_clear_object (&self->priv->socket);
-    g_clear_object (&self->priv->socket6);
+    vnc_server_stop (self);
 
     G_OBJECT_CLASS (vnc_server_parent_class)->finalize (object);
 }
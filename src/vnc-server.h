@@ -50,6 +50,8 @@ const gchar *vnc_server_get_listen_address (VNCServer *server);
 
 gboolean vnc_server_start (VNCServer *server);
 
+void vnc_server_stop (VNCServer *server);
+
 G_END_DECLS
 
 #endif /* VNC_SERVER_H_ */
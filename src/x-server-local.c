@@ -14,7 +14,9 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <unistd.h>
 #include <glib/gstdio.h>
+#include <glib-unix.h>
 #include <stdlib.h>
 
 #include "x-server-local.h"
@@ -60,6 +62,12 @@ struct XServerLocalPrivate
     /* TRUE when received ready signal */
     gboolean got_signal;
 
+    /* Pipe the X server reports its display number on when ready (-displayfd) */
+    int displayfd;
+    guint displayfd_watch;
+    gchar displayfd_data[16];
+    gsize displayfd_length;
+
     /* VT to run on */
     gint vt;
     gboolean have_vt_ref;
@@ -73,12 +81,27 @@ static void x_server_local_logger_iface_init (LoggerInterface *iface);
 G_DEFINE_TYPE_WITH_CODE (XServerLocal, x_server_local, X_SERVER_TYPE,
                          G_IMPLEMENT_INTERFACE (LOGGER_TYPE, x_server_local_logger_iface_init));
 
-static gchar *version = NULL;
-static guint version_major = 0, version_minor = 0;
-static GList *display_numbers = NULL;
+typedef struct
+{
+    gchar *version;
+    guint major, minor;
+} XServerVersion;
+
+/* Versions of the X server binaries we have checked, keyed by path */
+static GHashTable *versions = NULL;
+
+/* Bitmap of the display numbers of X servers we are running */
+static guint32 *display_numbers = NULL;
+static guint display_numbers_length = 0;
 
 #define XORG_VERSION_PREFIX "X.Org X Server "
 
+/* File in the cache directory to store versions of X servers we have checked */
+#define VERSION_CACHE_FILE "xserver-version"
+
+/* Servers run by wrappers such as Debian's Xwrapper, the wrapper isn't changed when these are upgraded */
+static const gchar *wrapped_servers[] = { "/usr/lib/xorg/Xorg", "/usr/libexec/Xorg", NULL };
+
 static gchar *
 find_version (const gchar *line)
 {
@@ -88,66 +111,303 @@ find_version (const gchar *line)
     return g_strdup (line + strlen (XORG_VERSION_PREFIX));
 }
 
-const gchar *
-x_server_local_get_version (void)
+static gchar *
+parse_version_output (const gchar *text)
+{
+    gchar **lines;
+    gchar *value = NULL;
+    int i;
+
+    lines = g_strsplit (text, "\n", -1);
+    for (i = 0; lines[i] && !value; i++)
+        value = find_version (lines[i]);
+    g_strfreev (lines);
+
+    return value;
+}
+
+static void
+set_version (XServerVersion *version, const gchar *value)
 {
-    gchar *stderr_text;
-    gint exit_status;
     gchar **tokens;
     guint n_tokens;
 
-    if (version)
-        return version;
+    g_free (version->version);
+    version->version = g_strdup (value);
+
+    tokens = g_strsplit (value, ".", 3);
+    n_tokens = g_strv_length (tokens);
+    version->major = n_tokens > 0 ? atoi (tokens[0]) : 0;
+    version->minor = n_tokens > 1 ? atoi (tokens[1]) : 0;
+    g_strfreev (tokens);
+}
+
+static void
+x_server_version_free (XServerVersion *version)
+{
+    g_free (version->version);
+    g_free (version);
+}
+
+static gchar *
+get_version_cache_path (void)
+{
+    gchar *dir, *path;
+
+    dir = config_get_string (config_get_instance (), "LightDM", "cache-directory");
+    path = g_build_filename (dir, VERSION_CACHE_FILE, NULL);
+    g_free (dir);
+
+    return path;
+}
+
+/* Get a string that changes when the binary or the server it wraps is replaced */
+static gchar *
+get_binary_stamp (const gchar *binary)
+{
+    GString *stamp;
+    GStatBuf info;
+    int i;
 
-    if (!g_spawn_command_line_sync ("X -version", NULL, &stderr_text, &exit_status, NULL))
+    if (g_stat (binary, &info) != 0)
         return NULL;
-    if (exit_status == EXIT_SUCCESS)
+
+    stamp = g_string_new ("");
+    g_string_append_printf (stamp, "%lu:%ld", (gulong) info.st_ino, (glong) info.st_mtime);
+    for (i = 0; wrapped_servers[i]; i++)
+        if (g_stat (wrapped_servers[i], &info) == 0)
+            g_string_append_printf (stamp, " %lu:%ld", (gulong) info.st_ino, (glong) info.st_mtime);
+
+    return g_string_free (stamp, FALSE);
+}
+
+static gchar *
+load_cached_version (const gchar *binary, const gchar *stamp)
+{
+    GKeyFile *cache;
+    gchar *path, *cached_stamp, *value = NULL;
+
+    cache = g_key_file_new ();
+    path = get_version_cache_path ();
+    /* Only trust the cached version if the binary hasn't changed since */
+    if (g_key_file_load_from_file (cache, path, G_KEY_FILE_NONE, NULL))
     {
-        gchar **lines;
-        int i;
+        cached_stamp = g_key_file_get_string (cache, binary, "stamp", NULL);
+        if (g_strcmp0 (cached_stamp, stamp) == 0)
+            value = g_key_file_get_string (cache, binary, "version", NULL);
+        g_free (cached_stamp);
+    }
+    g_free (path);
+    g_key_file_free (cache);
 
-        lines = g_strsplit (stderr_text, "\n", -1);
-        for (i = 0; lines[i] && !version; i++)
-            version = find_version (lines[i]);
-        g_strfreev (lines);
+    return value;
+}
+
+static void
+save_cached_version (const gchar *binary, const gchar *stamp, const gchar *value)
+{
+    GKeyFile *cache;
+    gchar *path;
+    GError *error = NULL;
+
+    cache = g_key_file_new ();
+    path = get_version_cache_path ();
+    g_key_file_load_from_file (cache, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+    g_key_file_remove_key (cache, binary, "inode", NULL);
+    g_key_file_remove_key (cache, binary, "mtime", NULL);
+    g_key_file_set_string (cache, binary, "stamp", stamp);
+    g_key_file_set_string (cache, binary, "version", value);
+    if (!g_key_file_save_to_file (cache, path, &error))
+        g_warning ("Failed to write X server version cache %s: %s", path, error->message);
+    g_clear_error (&error);
+    g_free (path);
+    g_key_file_free (cache);
+}
+
+static void
+version_probe_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    GSubprocess *probe = G_SUBPROCESS (object);
+    gchar *binary = data;
+    gchar *stderr_text = NULL, *value = NULL, *stamp;
+    XServerVersion *version;
+    GError *error = NULL;
+
+    if (!g_subprocess_communicate_utf8_finish (probe, result, NULL, &stderr_text, &error))
+        g_warning ("Failed to check X server version: %s", error->message);
+    else if (g_subprocess_get_successful (probe))
+        value = parse_version_output (stderr_text);
+    g_clear_error (&error);
+
+    stamp = get_binary_stamp (binary);
+    version = g_hash_table_lookup (versions, binary);
+    if (value && stamp && version)
+    {
+        if (g_strcmp0 (value, version->version) != 0)
+        {
+            g_debug ("X server %s version changed from %s to %s", binary, version->version, value);
+            set_version (version, value);
+            save_cached_version (binary, stamp, value);
+        }
     }
+
+    g_free (stamp);
+    g_free (value);
     g_free (stderr_text);
+    g_free (binary);
+    g_object_unref (probe);
+}
 
-    tokens = g_strsplit (version, ".", 3);
-    n_tokens = g_strv_length (tokens);
-    version_major = n_tokens > 0 ? atoi (tokens[0]) : 0;
-    version_minor = n_tokens > 1 ? atoi (tokens[1]) : 0;
+/* Get the version of an X server binary, checking each binary only once */
+static XServerVersion *
+get_binary_version (const gchar *binary)
+{
+    XServerVersion *version;
+    gchar *stamp, *value;
+    GSubprocess *probe;
+    GError *error = NULL;
+
+    if (!versions)
+        versions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) x_server_version_free);
+
+    version = g_hash_table_lookup (versions, binary);
+    if (version)
+        return version;
+
+    version = g_new0 (XServerVersion, 1);
+    g_hash_table_insert (versions, g_strdup (binary), version);
+
+    stamp = get_binary_stamp (binary);
+    if (!stamp)
+        return version;
+
+    /* Use the cached version without blocking and confirm it in the background,
+     * in case the server was replaced in a way the stamp doesn't show */
+    value = load_cached_version (binary, stamp);
+    if (value)
+    {
+        set_version (version, value);
+        probe = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_PIPE, &error, binary, "-version", NULL);
+        if (probe)
+            g_subprocess_communicate_utf8_async (probe, NULL, NULL, version_probe_cb, g_strdup (binary));
+        else
+            g_warning ("Failed to check X server version: %s", error->message);
+        g_clear_error (&error);
+        g_free (value);
+        g_free (stamp);
+        return version;
+    }
+
+    probe = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_PIPE, &error, binary, "-version", NULL);
+    if (probe)
+    {
+        gchar *stderr_text = NULL;
+
+        if (!g_subprocess_communicate_utf8 (probe, NULL, NULL, NULL, &stderr_text, &error))
+            g_warning ("Failed to check X server version: %s", error->message);
+        else if (g_subprocess_get_successful (probe))
+            value = parse_version_output (stderr_text);
+        g_free (stderr_text);
+        g_object_unref (probe);
+    }
+    else
+        g_warning ("Failed to check X server version: %s", error->message);
+    g_clear_error (&error);
+
+    if (value)
+    {
+        set_version (version, value);
+        save_cached_version (binary, stamp, value);
+    }
+    g_free (value);
+    g_free (stamp);
+
+    return version;
+}
+
+/* Get the version of the binary this server runs, or NULL if unknown */
+static XServerVersion *
+get_server_version (XServerLocal *server)
+{
+    XServerVersion *version = NULL;
+    gchar **tokens, *binary;
+
+    tokens = g_strsplit (server->priv->command, " ", 2);
+    binary = g_find_program_in_path (tokens[0]);
+    if (binary)
+        version = get_binary_version (binary);
+    g_free (binary);
     g_strfreev (tokens);
 
     return version;
 }
 
+const gchar *
+x_server_local_get_version (XServerLocal *server)
+{
+    XServerVersion *version;
+
+    g_return_val_if_fail (server != NULL, NULL);
+
+    version = get_server_version (server);
+    return version ? version->version : NULL;
+}
+
 gint
-x_server_local_version_compare (guint major, guint minor)
+x_server_local_version_compare (XServerLocal *server, guint major, guint minor)
 {
-    x_server_local_get_version ();
+    XServerVersion *version;
+    guint version_major = 0, version_minor = 0;
+
+    g_return_val_if_fail (server != NULL, 0);
+
+    version = get_server_version (server);
+    if (version)
+    {
+        version_major = version->major;
+        version_minor = version->minor;
+    }
+
     if (major == version_major)
         return version_minor - minor;
     else
         return version_major - major;
 }
 
+static gboolean
+display_number_is_ours (guint display_number)
+{
+    guint index = display_number / 32;
+    return index < display_numbers_length && (display_numbers[index] & (1u << (display_number % 32))) != 0;
+}
+
+static void
+set_display_number_is_ours (guint display_number, gboolean is_ours)
+{
+    guint index = display_number / 32;
+
+    if (index >= display_numbers_length)
+    {
+        if (!is_ours)
+            return;
+        display_numbers = g_renew (guint32, display_numbers, index + 1);
+        memset (display_numbers + display_numbers_length, 0, (index + 1 - display_numbers_length) * sizeof (guint32));
+        display_numbers_length = index + 1;
+    }
+
+    if (is_ours)
+        display_numbers[index] |= 1u << (display_number % 32);
+    else
+        display_numbers[index] &= ~(1u << (display_number % 32));
+}
+
 static gboolean
 display_number_in_use (guint display_number)
 {
-    GList *link;
     gchar *path;
     gboolean in_use;
     gchar *data;
 
-    /* See if we know we are managing a server with that number */
-    for (link = display_numbers; link; link = link->next)
-    {
-        guint number = GPOINTER_TO_UINT (link->data);
-        if (number == display_number)
-            return TRUE;
-    }
-
     /* See if an X server that we don't know of has a lock on that number */
     path = g_strdup_printf ("/tmp/.X%d-lock", display_number);
     in_use = g_file_test (path, G_FILE_TEST_EXISTS);
@@ -170,16 +430,30 @@ display_number_in_use (guint display_number)
     return in_use;
 }
 
+/* The number is chosen before the X server is launched rather than letting it pick
+ * one with -displayfd, as the log file, authority and address all depend on it */
 guint
 x_server_local_get_unused_display_number (void)
 {
     guint number;
 
     number = config_get_integer (config_get_instance (), "LightDM", "minimum-display-number");
-    while (display_number_in_use (number))
+    while (TRUE)
+    {
+        /* Skip over blocks of numbers we are already using without looking at them individually */
+        if (number % 32 == 0 && number / 32 < display_numbers_length && display_numbers[number / 32] == G_MAXUINT32)
+        {
+            number += 32;
+            continue;
+        }
+
+        /* Only check the filesystem for numbers we aren't using */
+        if (!display_number_is_ours (number) && !display_number_in_use (number))
+            break;
         number++;
+    }
 
-    display_numbers = g_list_append (display_numbers, GUINT_TO_POINTER (number));
+    set_display_number_is_ours (number, TRUE);
 
     return number;
 }
@@ -187,16 +461,7 @@ x_server_local_get_unused_display_number (void)
 void
 x_server_local_release_display_number (guint display_number)
 {
-    GList *link;
-    for (link = display_numbers; link; link = link->next)
-    {
-        guint number = GPOINTER_TO_UINT (link->data);
-        if (number == display_number)
-        {
-            display_numbers = g_list_delete_link (display_numbers, link);
-            return;
-        }
-    }
+    set_display_number_is_ours (display_number, FALSE);
 }
 
 XServerLocal *
@@ -348,29 +613,88 @@ get_absolute_command (const gchar *command)
 }
 
 static void
-x_server_local_run (Process *process, gpointer user_data)
+x_server_local_prepare_process (XServerLocal *server, Process *process)
 {
-    int fd;
-
     /* Make input non-blocking */
-    fd = open ("/dev/null", O_RDONLY);
-    dup2 (fd, STDIN_FILENO);
-    close (fd);
+    process_set_stdin (process, -1);
 
     /* Set SIGUSR1 to ignore so the X server can indicate it when it is ready */
-    signal (SIGUSR1, SIG_IGN);
+    process_set_ignore_signal (process, SIGUSR1);
 }
 
-static ProcessRunFunc
-x_server_local_get_run_function (XServerLocal *server)
+static gboolean
+x_server_local_get_log_stdout (XServerLocal *server)
 {
-    return x_server_local_run;
+    return TRUE;
 }
 
 static gboolean
-x_server_local_get_log_stdout (XServerLocal *server)
+x_server_local_get_supports_displayfd (XServerLocal *server)
 {
-    return TRUE;
+    /* -displayfd was added in X.Org 1.13, check the server we will run rather than whatever X is */
+    return x_server_local_version_compare (server, 1, 13) >= 0;
+}
+
+static void
+x_server_ready (XServerLocal *server)
+{
+    if (server->priv->got_signal)
+        return;
+    server->priv->got_signal = TRUE;
+
+    // FIXME: Check return value
+    DISPLAY_SERVER_CLASS (x_server_local_parent_class)->start (DISPLAY_SERVER (server));
+}
+
+static void
+close_displayfd (XServerLocal *server)
+{
+    if (server->priv->displayfd_watch)
+        g_source_remove (server->priv->displayfd_watch);
+    server->priv->displayfd_watch = 0;
+    if (server->priv->displayfd >= 0)
+        close (server->priv->displayfd);
+    server->priv->displayfd = -1;
+    server->priv->displayfd_length = 0;
+}
+
+static gboolean
+displayfd_cb (gint fd, GIOCondition condition, gpointer data)
+{
+    XServerLocal *server = data;
+    gchar *end;
+    gssize n_read;
+
+    n_read = read (fd, server->priv->displayfd_data + server->priv->displayfd_length, sizeof (server->priv->displayfd_data) - server->priv->displayfd_length - 1);
+    if (n_read < 0 && (errno == EINTR || errno == EAGAIN))
+        return G_SOURCE_CONTINUE;
+
+    /* Closed without reporting, wait for the signal or the process to stop */
+    if (n_read <= 0)
+    {
+        server->priv->displayfd_watch = 0;
+        close_displayfd (server);
+        return G_SOURCE_REMOVE;
+    }
+
+    server->priv->displayfd_length += n_read;
+    server->priv->displayfd_data[server->priv->displayfd_length] = '\0';
+
+    /* The display number is written followed by a newline */
+    end = strchr (server->priv->displayfd_data, '\n');
+    if (!end && server->priv->displayfd_length < sizeof (server->priv->displayfd_data) - 1)
+        return G_SOURCE_CONTINUE;
+
+    if (end && atoi (server->priv->displayfd_data) == (gint) server->priv->display_number)
+        l_debug (server, "X server :%d reported ready", server->priv->display_number);
+    else
+        l_warning (server, "X server reported unexpected display number %s", g_strstrip (server->priv->displayfd_data));
+
+    server->priv->displayfd_watch = 0;
+    close_displayfd (server);
+    x_server_ready (server);
+
+    return G_SOURCE_REMOVE;
 }
 
 static void
@@ -378,11 +702,8 @@ got_signal_cb (Process *process, int signum, XServerLocal *server)
 {
     if (signum == SIGUSR1 && !server->priv->got_signal)
     {
-        server->priv->got_signal = TRUE;
         l_debug (server, "Got signal from X server :%d", server->priv->display_number);
-
-        // FIXME: Check return value
-        DISPLAY_SERVER_CLASS (x_server_local_parent_class)->start (DISPLAY_SERVER (server));
+        x_server_ready (server);
     }
 }
 
@@ -391,6 +712,8 @@ stopped_cb (Process *process, XServerLocal *server)
 {
     l_debug (server, "X server stopped");
 
+    close_displayfd (server);
+
     /* Release VT and display number for re-use */
     if (server->priv->have_vt_ref)
     {
@@ -449,7 +772,6 @@ static gboolean
 x_server_local_start (DisplayServer *display_server)
 {
     XServerLocal *server = X_SERVER_LOCAL (display_server);
-    ProcessRunFunc run_cb;
     gboolean result, backup_logs;
     gchar *filename, *dir, *log_file, *absolute_command;
     GString *command;
@@ -460,8 +782,8 @@ x_server_local_start (DisplayServer *display_server)
 
     g_return_val_if_fail (server->priv->command != NULL, FALSE);
 
-    run_cb = X_SERVER_LOCAL_GET_CLASS (server)->get_run_function (server);
-    server->priv->x_server_process = process_new (run_cb, server);
+    server->priv->x_server_process = process_new (NULL, NULL);
+    X_SERVER_LOCAL_GET_CLASS (server)->prepare_process (server, server->priv->x_server_process);
     process_set_clear_environment (server->priv->x_server_process, TRUE);
     g_signal_connect (server->priv->x_server_process, PROCESS_SIGNAL_GOT_SIGNAL, G_CALLBACK (got_signal_cb), server);
     g_signal_connect (server->priv->x_server_process, PROCESS_SIGNAL_STOPPED, G_CALLBACK (stopped_cb), server);
@@ -513,7 +835,7 @@ x_server_local_start (DisplayServer *display_server)
     }
     else if (server->priv->allow_tcp)
     {
-        if (x_server_local_version_compare (1, 17) >= 0)
+        if (x_server_local_version_compare (server, 1, 17) >= 0)
             g_string_append (command, " -listen tcp");
     }
     else
@@ -522,6 +844,26 @@ x_server_local_start (DisplayServer *display_server)
     if (server->priv->vt >= 0)
         g_string_append_printf (command, " vt%d -novtswitch", server->priv->vt);
 
+    /* Have the X server report when it is ready on a pipe rather than racing it with SIGUSR1 */
+    if (X_SERVER_LOCAL_GET_CLASS (server)->get_supports_displayfd (server))
+    {
+        int fds[2];
+        GError *error = NULL;
+
+        if (!g_unix_open_pipe (fds, FD_CLOEXEC, &error))
+            l_warning (display_server, "Failed to create pipe for -displayfd: %s", error->message);
+        else
+        {
+            g_string_append_printf (command, " -displayfd %d", process_set_pass_fd (server->priv->x_server_process, fds[1]));
+            close (fds[1]);
+            g_unix_set_fd_nonblocking (fds[0], TRUE, NULL);
+            server->priv->displayfd = fds[0];
+            server->priv->displayfd_length = 0;
+            server->priv->displayfd_watch = g_unix_fd_add (fds[0], G_IO_IN | G_IO_HUP | G_IO_ERR, displayfd_cb, server);
+        }
+        g_clear_error (&error);
+    }
+
     if (server->priv->background)
         g_string_append_printf (command, " -background %s", server->priv->background);
 
@@ -583,6 +925,7 @@ x_server_local_init (XServerLocal *server)
 {
     server->priv = G_TYPE_INSTANCE_GET_PRIVATE (server, X_SERVER_LOCAL_TYPE, XServerLocalPrivate);
     server->priv->vt = -1;
+    server->priv->displayfd = -1;
     server->priv->command = g_strdup ("X");
     server->priv->display_number = x_server_local_get_unused_display_number ();
 }
@@ -597,6 +940,7 @@ x_server_local_finalize (GObject *object)
         g_signal_handlers_disconnect_matched (self->priv->x_server_process, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
         g_object_unref (self->priv->x_server_process);
     }
+    close_displayfd (self);
     g_free (self->priv->command);
     g_free (self->priv->config_file);
     g_free (self->priv->layout);
@@ -618,8 +962,9 @@ x_server_local_class_init (XServerLocalClass *klass)
     XServerClass *x_server_class = X_SERVER_CLASS (klass);
     DisplayServerClass *display_server_class = DISPLAY_SERVER_CLASS (klass);
 
-    klass->get_run_function = x_server_local_get_run_function;
+    klass->prepare_process = x_server_local_prepare_process;
     klass->get_log_stdout = x_server_local_get_log_stdout;
+    klass->get_supports_displayfd = x_server_local_get_supports_displayfd;
     x_server_class->get_display_number = x_server_local_get_display_number;
     display_server_class->get_vt = x_server_local_get_vt;
     display_server_class->start = klass->start = x_server_local_start;
@@ -34,16 +34,13 @@ typedef struct
 typedef struct
 {
     XServerClass parent_class;
-    ProcessRunFunc (*get_run_function)(XServerLocal *server);
+    void (*prepare_process)(XServerLocal *server, Process *process);
     gboolean (*get_log_stdout)(XServerLocal *server);  
+    gboolean (*get_supports_displayfd)(XServerLocal *server);
     void (*add_args)(XServerLocal *server, GString *command);
     gboolean (*start)(DisplayServer *server);
 } XServerLocalClass;
 
-const gchar *x_server_local_get_version (void);
-
-gint x_server_local_version_compare (guint major, guint minor);
-
 guint x_server_local_get_unused_display_number (void);
 
 void x_server_local_release_display_number (guint display_number);
@@ -54,6 +51,10 @@ XServerLocal *x_server_local_new (void);
 
 void x_server_local_set_command (XServerLocal *server, const gchar *command);
 
+const gchar *x_server_local_get_version (XServerLocal *server);
+
+gint x_server_local_version_compare (XServerLocal *server, guint major, guint minor);
+
 void x_server_local_set_vt (XServerLocal *server, gint vt);
 
 void x_server_local_set_config (XServerLocal *server, const gchar *path);
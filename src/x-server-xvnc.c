@@ -70,28 +70,28 @@ x_server_xvnc_set_depth (XServerXVNC *server, gint depth)
 }
 
 static void
-x_server_xvnc_run (Process *process, gpointer user_data)
+x_server_xvnc_prepare_process (XServerLocal *server, Process *process)
 {
-    XServerXVNC *server = user_data;
+    XServerXVNC *xvnc = X_SERVER_XVNC (server);
 
     /* Connect input */
-    dup2 (server->priv->socket_fd, STDIN_FILENO);
-    dup2 (server->priv->socket_fd, STDOUT_FILENO);
-    close (server->priv->socket_fd);
+    process_set_stdin (process, xvnc->priv->socket_fd);
+    process_set_stdout (process, xvnc->priv->socket_fd);
 
     /* Set SIGUSR1 to ignore so the X server can indicate it when it is ready */
-    signal (SIGUSR1, SIG_IGN);
+    process_set_ignore_signal (process, SIGUSR1);
 }
 
-static ProcessRunFunc
-x_server_xvnc_get_run_function (XServerLocal *server)
+static gboolean
+x_server_xvnc_get_log_stdout (XServerLocal *server)
 {
-    return x_server_xvnc_run;
+    return FALSE;
 }
 
 static gboolean
-x_server_xvnc_get_log_stdout (XServerLocal *server)
+x_server_xvnc_get_supports_displayfd (XServerLocal *server)
 {
+    /* Xvnc doesn't report an X.Org version to check for -displayfd, so signal readiness the traditional way */
     return FALSE;
 }
 
@@ -130,8 +130,9 @@ x_server_xvnc_class_init (XServerXVNCClass *klass)
     XServerLocalClass *x_server_local_class = X_SERVER_LOCAL_CLASS (klass);
     DisplayServerClass *display_server_class = DISPLAY_SERVER_CLASS (klass);
 
-    x_server_local_class->get_run_function = x_server_xvnc_get_run_function;
+    x_server_local_class->prepare_process = x_server_xvnc_prepare_process;
     x_server_local_class->get_log_stdout = x_server_xvnc_get_log_stdout;
+    x_server_local_class->get_supports_displayfd = x_server_xvnc_get_supports_displayfd;
     x_server_local_class->add_args = x_server_xvnc_add_args;
     display_server_class->get_can_share = x_server_xvnc_get_can_share;
 
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2026 agent.
+ * Author: agent <agent@local>
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+/* Measures how many XDMCP packets per second can be decoded and answered */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+
+#include "xdmcp-protocol.h"
+#include "xdmcp-server.h"
+#include "x-authority.h"
+
+static GMainLoop *loop = NULL;
+static guint n_replies = 0, n_expected = 0;
+
+static gssize
+encode_request (guint8 *data, gsize length)
+{
+    XDMCPPacket *packet;
+    XDMCPConnection connection;
+    guint8 address[4] = { 127, 0, 0, 1 };
+    gchar *authorization_names[] = { (gchar *) "MIT-MAGIC-COOKIE-1", NULL };
+    gssize n_written;
+
+    packet = xdmcp_packet_alloc (XDMCP_Request);
+    connection.type = XAUTH_FAMILY_INTERNET;
+    connection.address.length = 4;
+    connection.address.data = address;
+    packet->Request.display_number = 1;
+    packet->Request.n_connections = 1;
+    packet->Request.connections = &connection;
+    packet->Request.authentication_name = (gchar *) "";
+    packet->Request.authorization_names = authorization_names;
+    packet->Request.manufacturer_display_id = (gchar *) "BENCHMARK";
+    n_written = xdmcp_packet_encode (packet, data, length);
+
+    /* Fields point to the stack */
+    g_free (packet);
+
+    return n_written;
+}
+
+static gdouble
+packets_per_second (guint n_packets, gint64 start_time)
+{
+    gint64 duration = g_get_monotonic_time () - start_time;
+    return duration > 0 ? n_packets * 1000000.0 / duration : 0;
+}
+
+static void
+benchmark_decode (guint n_packets)
+{
+    guint8 data[1024];
+    gssize length;
+    XDMCPArena arena;
+    gint64 start_time;
+    guint i;
+
+    length = encode_request (data, sizeof (data));
+
+    start_time = g_get_monotonic_time ();
+    for (i = 0; i < n_packets; i++)
+        xdmcp_packet_free (xdmcp_packet_decode (data, length));
+    g_print ("Decode (allocating): %.0f packets/s\n", packets_per_second (n_packets, start_time));
+
+    xdmcp_arena_init (&arena, 16384);
+    start_time = g_get_monotonic_time ();
+    for (i = 0; i < n_packets; i++)
+    {
+        xdmcp_arena_reset (&arena);
+        xdmcp_packet_decode_in_arena (data, length, &arena);
+    }
+    g_print ("Decode (arena): %.0f packets/s\n", packets_per_second (n_packets, start_time));
+    xdmcp_arena_clear (&arena);
+
+    start_time = g_get_monotonic_time ();
+    for (i = 0; i < n_packets; i++)
+    {
+        XDMCPPacket *packet = xdmcp_packet_decode (data, length);
+        g_free (xdmcp_packet_tostring (packet));
+        xdmcp_packet_free (packet);
+    }
+    g_print ("Decode and log: %.0f packets/s\n", packets_per_second (n_packets, start_time));
+}
+
+static gboolean
+reply_cb (GSocket *socket, GIOCondition condition, gpointer data)
+{
+    gchar buffer[1024];
+
+    while (g_socket_receive (socket, buffer, sizeof (buffer), NULL, NULL) > 0)
+        n_replies++;
+
+    if (n_replies >= n_expected)
+        g_main_loop_quit (loop);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+timeout_cb (gpointer data)
+{
+    g_printerr ("Timed out waiting for replies, got %u of %u\n", n_replies, n_expected);
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+benchmark_server (guint n_packets, guint port, gboolean log_packets)
+{
+    XDMCPServer *server;
+    XDMCPPacket *query;
+    GSocket *socket;
+    GSocketAddress *address;
+    GSource *source;
+    guint8 data[1024];
+    gssize length;
+    gint64 start_time;
+    guint timeout, i;
+    GError *error = NULL;
+
+    server = xdmcp_server_new ();
+    xdmcp_server_set_port (server, port);
+    xdmcp_server_set_listen_address (server, "127.0.0.1");
+    xdmcp_server_set_hostname (server, "benchmark");
+    xdmcp_server_set_log_packets (server, log_packets);
+    if (!xdmcp_server_start (server))
+    {
+        g_printerr ("Failed to start XDMCP server on port %u\n", port);
+        g_object_unref (server);
+        return;
+    }
+
+    socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, &error);
+    if (!socket)
+    {
+        g_printerr ("Failed to create socket: %s\n", error->message);
+        g_clear_error (&error);
+        g_object_unref (server);
+        return;
+    }
+    g_socket_set_blocking (socket, FALSE);
+    address = g_inet_socket_address_new_from_string ("127.0.0.1", port);
+
+    query = xdmcp_packet_alloc (XDMCP_Query);
+    query->Query.authentication_names = g_new0 (gchar *, 1);
+    length = xdmcp_packet_encode (query, data, sizeof (data));
+    xdmcp_packet_free (query);
+
+    source = g_socket_create_source (socket, G_IO_IN, NULL);
+    g_source_set_callback (source, (GSourceFunc) reply_cb, NULL, NULL);
+    g_source_attach (source, NULL);
+
+    /* Send everything up front like a room full of clients starting together */
+    n_replies = 0;
+    n_expected = n_packets;
+    start_time = g_get_monotonic_time ();
+    for (i = 0; i < n_packets; i++)
+    {
+        if (g_socket_send_to (socket, address, (gchar *) data, length, NULL, NULL) < 0)
+            n_expected--;
+
+        /* Collect replies as we go so the socket buffers don't overflow */
+        if (i % 64 == 63)
+            while (g_main_context_iteration (NULL, FALSE));
+    }
+    if (n_replies < n_expected)
+    {
+        timeout = g_timeout_add_seconds (5, timeout_cb, NULL);
+        g_main_loop_run (loop);
+        g_source_remove (timeout);
+    }
+    g_print ("Query/Willing%s: %.0f packets/s (%u of %u answered)\n", log_packets ? " (logged)" : "", packets_per_second (n_replies, start_time), n_replies, n_packets);
+
+    g_source_destroy (source);
+    g_source_unref (source);
+    g_object_unref (address);
+    g_object_unref (socket);
+    xdmcp_server_stop (server);
+    g_object_unref (server);
+}
+
+static void
+log_cb (const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer data)
+{
+    /* Format the message but don't print it, so we measure the cost of logging without the terminal */
+}
+
+int
+main (int argc, char **argv)
+{
+    guint n_packets = 100000, port = 17700;
+
+    if (argc > 1 && (g_strcmp0 (argv[1], "--help") == 0 || g_strcmp0 (argv[1], "-h") == 0))
+    {
+        g_printerr ("Usage: %s [N-PACKETS] [PORT]\n", argv[0]);
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1)
+        n_packets = atoi (argv[1]);
+    if (argc > 2)
+        port = atoi (argv[2]);
+
+#if !defined(GLIB_VERSION_2_36)
+    g_type_init ();
+#endif
+
+    loop = g_main_loop_new (NULL, FALSE);
+    g_log_set_handler (NULL, G_LOG_LEVEL_DEBUG, log_cb, NULL);
+
+    benchmark_decode (n_packets);
+    benchmark_server (n_packets, port, FALSE);
+    benchmark_server (n_packets, port, TRUE);
+
+    g_main_loop_unref (loop);
+
+    return EXIT_SUCCESS;
+}
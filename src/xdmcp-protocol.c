@@ -20,8 +20,66 @@ typedef struct
     const guint8 *data;
     guint16 remaining;
     gboolean overflow;
+
+    /* Memory to decode into, or NULL to allocate each field */
+    XDMCPArena *arena;
 } PacketReader;
 
+void
+xdmcp_arena_init (XDMCPArena *arena, gsize size)
+{
+    arena->data = g_malloc (size);
+    arena->size = size;
+    arena->used = 0;
+}
+
+void
+xdmcp_arena_reset (XDMCPArena *arena)
+{
+    arena->used = 0;
+}
+
+void
+xdmcp_arena_clear (XDMCPArena *arena)
+{
+    g_free (arena->data);
+    arena->data = NULL;
+    arena->size = arena->used = 0;
+}
+
+static gpointer
+xdmcp_arena_alloc (XDMCPArena *arena, gsize size)
+{
+    gpointer data;
+    gsize offset;
+
+    /* Keep allocations aligned for pointers */
+    offset = (arena->used + sizeof (gpointer) - 1) & ~(sizeof (gpointer) - 1);
+    if (offset > arena->size || size > arena->size - offset)
+        return NULL;
+
+    data = arena->data + offset;
+    arena->used = offset + size;
+
+    return data;
+}
+
+static gpointer
+reader_alloc (PacketReader *reader, gsize size)
+{
+    gpointer data;
+
+    if (!reader->arena)
+        return g_malloc (size);
+
+    /* Treat running out of space like running out of packet, the packet is rejected */
+    data = xdmcp_arena_alloc (reader->arena, size);
+    if (!data)
+        reader->overflow = TRUE;
+
+    return data;
+}
+
 static guint8
 read_card8 (PacketReader *reader)
 {
@@ -58,6 +116,23 @@ read_data (PacketReader *reader, XDMCPData *data)
     guint16 i;
 
     data->length = read_card16 (reader);
+
+    /* Point into the packet when decoding into an arena */
+    if (reader->arena)
+    {
+        if (reader->remaining < data->length)
+        {
+            reader->overflow = TRUE;
+            data->length = 0;
+            data->data = NULL;
+            return;
+        }
+        data->data = (guint8 *) reader->data;
+        reader->data += data->length;
+        reader->remaining -= data->length;
+        return;
+    }
+
     data->data = g_malloc (sizeof (guint8) * data->length);
     for (i = 0; i < data->length; i++)
         data->data[i] = read_card8 (reader);
@@ -70,7 +145,14 @@ read_string (PacketReader *reader)
     gchar *string;
 
     length = read_card16 (reader);
-    string = g_malloc (sizeof (gchar) * (length + 1));
+    if (reader->arena && reader->remaining < length)
+        reader->overflow = TRUE;
+    if (reader->arena && reader->overflow)
+        return (gchar *) "";
+
+    string = reader_alloc (reader, sizeof (gchar) * (length + 1));
+    if (!string)
+        return (gchar *) "";
     for (i = 0; i < length; i++)
         string[i] = (gchar) read_card8 (reader);
     string[i] = '\0';
@@ -81,11 +163,14 @@ read_string (PacketReader *reader)
 static gchar **
 read_string_array (PacketReader *reader)
 {
+    static gchar *empty_array[] = { NULL };
     guint8 n_strings, i;
     gchar **strings;
 
     n_strings = read_card8 (reader);
-    strings = g_malloc (sizeof (gchar *) * (n_strings + 1));
+    strings = reader_alloc (reader, sizeof (gchar *) * (n_strings + 1));
+    if (!strings)
+        return empty_array;
     for (i = 0; i < n_strings; i++)
         strings[i] = read_string (reader);
     strings[i] = NULL;
@@ -171,8 +256,8 @@ xdmcp_packet_alloc (XDMCPOpcode opcode)
     return packet;
 }
 
-XDMCPPacket *
-xdmcp_packet_decode (const guint8 *data, gsize data_length)
+static XDMCPPacket *
+decode_packet (const guint8 *data, gsize data_length, XDMCPArena *arena)
 {
     XDMCPPacket *packet;
     guint16 version, opcode, length;
@@ -183,6 +268,7 @@ xdmcp_packet_decode (const guint8 *data, gsize data_length)
     reader.data = data;
     reader.remaining = data_length;
     reader.overflow = FALSE;
+    reader.arena = arena;
 
     version = read_card16 (&reader);
     opcode = read_card16 (&reader);
@@ -204,7 +290,16 @@ xdmcp_packet_decode (const guint8 *data, gsize data_length)
         return NULL;
     }
 
-    packet = xdmcp_packet_alloc (opcode);
+    if (arena)
+    {
+        packet = xdmcp_arena_alloc (arena, sizeof (XDMCPPacket));
+        if (!packet)
+            return NULL;
+        memset (packet, 0, sizeof (XDMCPPacket));
+        packet->opcode = opcode;
+    }
+    else
+        packet = xdmcp_packet_alloc (opcode);
     switch (packet->opcode)
     {
     case XDMCP_BroadcastQuery:
@@ -229,7 +324,12 @@ xdmcp_packet_decode (const guint8 *data, gsize data_length)
     case XDMCP_Request:
         packet->Request.display_number = read_card16 (&reader);
         packet->Request.n_connections = read_card8 (&reader);
-        packet->Request.connections = g_malloc (sizeof (XDMCPConnection) * packet->Request.n_connections);
+        packet->Request.connections = reader_alloc (&reader, sizeof (XDMCPConnection) * packet->Request.n_connections);
+        if (!packet->Request.connections)
+        {
+            packet->Request.n_connections = 0;
+            break;
+        }
         for (i = 0; i < packet->Request.n_connections; i++)
             packet->Request.connections[i].type = read_card16 (&reader);
         if (read_card8 (&reader) != packet->Request.n_connections)
@@ -297,13 +397,27 @@ xdmcp_packet_decode (const guint8 *data, gsize data_length)
     }
     if (failed)
     {
-        xdmcp_packet_free (packet);
+        if (!arena)
+            xdmcp_packet_free (packet);
         return NULL;
     }
 
     return packet;
 }
 
+XDMCPPacket *
+xdmcp_packet_decode (const guint8 *data, gsize data_length)
+{
+    return decode_packet (data, data_length, NULL);
+}
+
+XDMCPPacket *
+xdmcp_packet_decode_in_arena (const guint8 *data, gsize data_length, XDMCPArena *arena)
+{
+    g_return_val_if_fail (arena != NULL, NULL);
+    return decode_packet (data, data_length, arena);
+}
+
 gssize
 xdmcp_packet_encode (XDMCPPacket *packet, guint8 *data, gsize max_length)
 {
@@ -136,10 +136,27 @@ typedef struct
     };
 } XDMCPPacket;
 
+/* Memory decoded packets are placed in so decoding doesn't need to allocate */
+typedef struct
+{
+    guint8 *data;
+    gsize size;
+    gsize used;
+} XDMCPArena;
+
 XDMCPPacket *xdmcp_packet_alloc (XDMCPOpcode opcode);
 
 XDMCPPacket *xdmcp_packet_decode (const guchar *data, gsize length);
 
+void xdmcp_arena_init (XDMCPArena *arena, gsize size);
+
+void xdmcp_arena_reset (XDMCPArena *arena);
+
+void xdmcp_arena_clear (XDMCPArena *arena);
+
+/* Packets decoded this way point into the data and arena and must not be freed */
+XDMCPPacket *xdmcp_packet_decode_in_arena (const guchar *data, gsize length, XDMCPArena *arena);
+
 gssize xdmcp_packet_encode (XDMCPPacket *packet, guchar *data, gsize length);
 
 gchar *xdmcp_packet_tostring (XDMCPPacket *packet);
@@ -9,8 +9,14 @@
  * license.
  */
 
+/* for recvmmsg() and sendmmsg() */
+#define _GNU_SOURCE
+
+#include <config.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
 #include <X11/X.h>
 #define HASXDMAUTH
 #include <X11/Xdmcp.h>
@@ -20,6 +26,7 @@
 #include "xdmcp-protocol.h"
 #include "xdmcp-session-private.h"
 #include "x-authority.h"
+#include "timer-wheel.h"
 
 enum {
     NEW_SESSION,
@@ -27,6 +34,37 @@ enum {
 };
 static guint signals[LAST_SIGNAL] = { 0 };
 
+/* Largest packet we handle */
+#define MAX_PACKET_LENGTH 1024
+
+typedef struct
+{
+    GSocketAddress *address;
+    guint8 data[MAX_PACKET_LENGTH];
+    gsize length;
+} OutgoingPacket;
+
+/* Token bucket limiting the rate of requests from one address */
+typedef struct
+{
+    /* Address, owned by the rate limit table */
+    const gchar *key;
+
+    gdouble tokens;
+    gint64 time;
+
+    /* Link in the least recently used queue */
+    GList link;
+} RateLimit;
+
+/* Response to a query, encoded once and reused until the configuration changes */
+typedef struct
+{
+    XDMCPPacket *packet;
+    guint8 data[MAX_PACKET_LENGTH];
+    gsize length;
+} CachedResponse;
+
 struct XDMCPServerPrivate
 {
     /* Port to listen on */
@@ -37,6 +75,7 @@ struct XDMCPServerPrivate
 
     /* Listening sockets */
     GSocket *socket, *socket6;
+    GSource *socket_source, *socket6_source;
 
     /* Hostname to report to client */
     gchar *hostname;
@@ -49,13 +88,86 @@ struct XDMCPServerPrivate
 
     /* Active XDMCP sessions */
     GHashTable *sessions;
+
+    /* Timeouts for sessions */
+    TimerWheel *timers;
+
+    /* Number of seconds a managed session can go without a KeepAlive or 0 for no limit */
+    guint keep_alive_timeout;
+
+    /* TRUE if packets are written to the debug log */
+    gboolean log_packets;
+
+    /* Buffer to receive a batch of packets into */
+    guint8 *receive_data;
+
+    /* Memory received packets are decoded into */
+    XDMCPArena arena;
+
+    /* Responses waiting to be sent at the end of the batch */
+    OutgoingPacket *outgoing;
+    guint n_outgoing;
+
+    /* Responses to queries or NULL if not yet encoded */
+    CachedResponse *willing_response;
+    CachedResponse *unwilling_response;
+    CachedResponse *full_response;
+
+    /* Maximum number of sessions to accept or 0 for no limit */
+    guint capacity;
+
+    /* Number of sessions currently running */
+    guint n_sessions;
+
+    /* TRUE if the system load is reported in the Willing status */
+    gboolean report_load;
+
+    /* Time the load in the Willing response was measured */
+    gint64 load_time;
+
+    /* Sessions that have been accepted but not yet managed */
+    guint n_pending_sessions;
+
+    /* Maximum number of pending sessions or 0 for no limit */
+    guint max_pending_sessions;
+
+    /* Requests allowed per second from each address or 0 for no limit */
+    guint request_rate_limit;
+
+    /* Rate limits keyed by address */
+    GHashTable *rate_limits;
+
+    /* Rate limits, least recently used first */
+    GQueue rate_limit_queue;
+
+    /* Requests dropped due to rate limiting and declined */
+    guint n_dropped_requests;
+    guint n_declined_requests;
 };
 
 G_DEFINE_TYPE (XDMCPServer, xdmcp_server, G_TYPE_OBJECT);
 
+/* Maximum number of packets to receive or send in one system call */
+#define BATCH_SIZE 32
+
+/* Memory required to decode any packet that fits in the receive buffer */
+#define ARENA_SIZE 16384
+
+/* Number of microseconds before the reported load is measured again */
+#define LOAD_UPDATE_INTERVAL (5 * G_USEC_PER_SEC)
+
+/* Minimum number of requests an address can send in a burst */
+#define RATE_LIMIT_BURST 10
+
+/* Maximum number of addresses to track, the least recently used is forgotten to make space */
+#define MAX_RATE_LIMITS 1024
+
 /* Maximum number of milliseconds client will resend manage requests before giving up */
 #define MANAGE_TIMEOUT 126000
 
+/* Resolution of session timeouts in milliseconds */
+#define TIMER_TICK 1000
+
 /* Address sort support structure */
 typedef struct
 {
@@ -73,7 +185,8 @@ void
 xdmcp_server_set_port (XDMCPServer *server, guint port)
 {
     g_return_if_fail (server != NULL);
-    server->priv->port = port;
+    /* Zero means use the standard port */
+    server->priv->port = port > 0 ? port : XDM_UDP_PORT;
 }
 
 guint
@@ -99,6 +212,24 @@ xdmcp_server_get_listen_address (XDMCPServer *server)
     return server->priv->listen_address;
 }
 
+static void
+cached_response_free (CachedResponse *response)
+{
+    if (!response)
+        return;
+
+    xdmcp_packet_free (response->packet);
+    g_free (response);
+}
+
+static void
+invalidate_responses (XDMCPServer *server)
+{
+    g_clear_pointer (&server->priv->willing_response, cached_response_free);
+    g_clear_pointer (&server->priv->unwilling_response, cached_response_free);
+    g_clear_pointer (&server->priv->full_response, cached_response_free);
+}
+
 void
 xdmcp_server_set_hostname (XDMCPServer *server, const gchar *hostname)
 {
@@ -106,6 +237,7 @@ xdmcp_server_set_hostname (XDMCPServer *server, const gchar *hostname)
 
     g_free (server->priv->hostname);
     server->priv->hostname = g_strdup (hostname);
+    invalidate_responses (server);
 }
 
 const gchar *
@@ -122,6 +254,7 @@ xdmcp_server_set_status (XDMCPServer *server, const gchar *status)
 
     g_free (server->priv->status);
     server->priv->status = g_strdup (status);
+    invalidate_responses (server);
 }
 
 const gchar *
@@ -131,22 +264,124 @@ xdmcp_server_get_status (XDMCPServer *server)
     return server->priv->status;
 }
 
+void
+xdmcp_server_set_log_packets (XDMCPServer *server, gboolean log_packets)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->log_packets = log_packets;
+}
+
+void
+xdmcp_server_set_capacity (XDMCPServer *server, guint capacity)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->capacity = capacity;
+    invalidate_responses (server);
+}
+
+guint
+xdmcp_server_get_capacity (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->capacity;
+}
+
+void
+xdmcp_server_set_report_load (XDMCPServer *server, gboolean report_load)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->report_load = report_load;
+    invalidate_responses (server);
+}
+
+void
+xdmcp_server_set_n_sessions (XDMCPServer *server, guint n_sessions)
+{
+    g_return_if_fail (server != NULL);
+
+    if (server->priv->n_sessions == n_sessions)
+        return;
+    server->priv->n_sessions = n_sessions;
+
+    /* The session count is in the Willing status */
+    if (server->priv->report_load)
+        g_clear_pointer (&server->priv->willing_response, cached_response_free);
+}
+
+guint
+xdmcp_server_get_n_sessions (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->n_sessions;
+}
+
+void
+xdmcp_server_set_max_pending_sessions (XDMCPServer *server, guint max_pending_sessions)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->max_pending_sessions = max_pending_sessions;
+}
+
+void
+xdmcp_server_set_request_rate_limit (XDMCPServer *server, guint request_rate_limit)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->request_rate_limit = request_rate_limit;
+    g_hash_table_remove_all (server->priv->rate_limits);
+    g_queue_init (&server->priv->rate_limit_queue);
+}
+
+void
+xdmcp_server_set_keep_alive_timeout (XDMCPServer *server, guint keep_alive_timeout)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->keep_alive_timeout = keep_alive_timeout;
+}
+
 void
 xdmcp_server_set_key (XDMCPServer *server, const gchar *key)
 {
     g_return_if_fail (server != NULL);
     g_free (server->priv->key);
     server->priv->key = g_strdup (key);
+    invalidate_responses (server);
 }
 
-static gboolean
-session_timeout_cb (XDMCPSession *session)
+static void
+remove_session (XDMCPServer *server, XDMCPSession *session)
 {
-    session->priv->inactive_timeout = 0;
+    timer_wheel_remove (server->priv->timers, &session->priv->timer);
+    g_signal_handlers_disconnect_matched (session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, server);
+    g_hash_table_remove (server->priv->sessions, GINT_TO_POINTER ((gint) session->priv->id));
+}
 
-    g_debug ("Timing out unmanaged session %d", session->priv->id);
-    g_hash_table_remove (session->priv->server->priv->sessions, GINT_TO_POINTER ((gint) session->priv->id));
-    return FALSE;
+static void
+session_timeout_cb (gpointer data)
+{
+    XDMCPSession *session = data;
+    XDMCPServer *server = session->priv->server;
+
+    if (!session->priv->started)
+    {
+        g_debug ("Timing out unmanaged session %d", session->priv->id);
+        server->priv->n_pending_sessions--;
+        remove_session (server, session);
+        return;
+    }
+
+    /* Hold a reference while the seat using this session stops */
+    g_debug ("Timing out session %d, no KeepAlive received", session->priv->id);
+    g_object_ref (session);
+    remove_session (server, session);
+    g_signal_emit_by_name (session, XDMCP_SESSION_SIGNAL_EXPIRED);
+    g_object_unref (session);
+}
+
+static void
+session_stopped_cb (XDMCPSession *session, XDMCPServer *server)
+{
+    g_debug ("XDMCP session %d stopped", session->priv->id);
+    remove_session (server, session);
 }
 
 static XDMCPSession *
@@ -163,7 +398,9 @@ add_session (XDMCPServer *server)
     session = xdmcp_session_new (id);
     session->priv->server = server;
     g_hash_table_insert (server->priv->sessions, GINT_TO_POINTER ((gint) id), g_object_ref (session));
-    session->priv->inactive_timeout = g_timeout_add (MANAGE_TIMEOUT, (GSourceFunc) session_timeout_cb, session);
+    timer_wheel_timer_init (&session->priv->timer, session_timeout_cb, session);
+    timer_wheel_add (server->priv->timers, &session->priv->timer, MANAGE_TIMEOUT);
+    server->priv->n_pending_sessions++;
 
     return session;
 }
@@ -187,28 +424,148 @@ socket_address_to_string (GSocketAddress *address)
 }
 
 static void
-send_packet (GSocket *socket, GSocketAddress *address, XDMCPPacket *packet)
+log_packet (const gchar *format, XDMCPPacket *packet, GSocketAddress *address)
 {
-    gchar *address_string;
-    guint8 data[1024];
-    gssize n_written;
+    gchar *packet_string, *address_string;
 
+    packet_string = xdmcp_packet_tostring (packet);
     address_string = socket_address_to_string (address);
-    g_debug ("Send %s to %s", xdmcp_packet_tostring (packet), address_string);
+    g_debug (format, packet_string, address_string);
+    g_free (packet_string);
     g_free (address_string);
+}
 
-    n_written = xdmcp_packet_encode (packet, data, 1024);
-    if (n_written < 0)
-      g_critical ("Failed to encode XDMCP packet");
-    else
+static void
+flush_packets (XDMCPServer *server, GSocket *socket)
+{
+    guint i;
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr messages[BATCH_SIZE];
+    struct iovec iov[BATCH_SIZE];
+    struct sockaddr_storage native_addresses[BATCH_SIZE];
+    guint n_messages = 0, n_sent = 0;
+
+    memset (messages, 0, sizeof (messages));
+    for (i = 0; i < server->priv->n_outgoing; i++)
     {
+        OutgoingPacket *packet = &server->priv->outgoing[i];
         GError *error = NULL;
 
-        g_socket_send_to (socket, address, (gchar *) data, n_written, NULL, &error);
+        if (!g_socket_address_to_native (packet->address, &native_addresses[n_messages], sizeof (native_addresses[n_messages]), &error))
+        {
+            g_warning ("Error sending packet: %s", error->message);
+            g_clear_error (&error);
+            continue;
+        }
+
+        iov[n_messages].iov_base = packet->data;
+        iov[n_messages].iov_len = packet->length;
+        messages[n_messages].msg_hdr.msg_name = &native_addresses[n_messages];
+        messages[n_messages].msg_hdr.msg_namelen = g_socket_address_get_native_size (packet->address);
+        messages[n_messages].msg_hdr.msg_iov = &iov[n_messages];
+        messages[n_messages].msg_hdr.msg_iovlen = 1;
+        n_messages++;
+    }
+
+    /* Send all the responses in as few system calls as possible */
+    while (n_sent < n_messages)
+    {
+        int result;
+
+        result = sendmmsg (g_socket_get_fd (socket), messages + n_sent, n_messages - n_sent, 0);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            g_warning ("Error sending packet: %s", strerror (errno));
+
+            /* Skip the packet that failed and carry on */
+            n_sent++;
+        }
+        else
+            n_sent += result;
+    }
+#else
+    for (i = 0; i < server->priv->n_outgoing; i++)
+    {
+        OutgoingPacket *packet = &server->priv->outgoing[i];
+        GError *error = NULL;
+
+        g_socket_send_to (socket, packet->address, (gchar *) packet->data, packet->length, NULL, &error);
         if (error)
             g_warning ("Error sending packet: %s", error->message);
         g_clear_error (&error);
     }
+#endif
+
+    for (i = 0; i < server->priv->n_outgoing; i++)
+        g_clear_object (&server->priv->outgoing[i].address);
+    server->priv->n_outgoing = 0;
+}
+
+/* Queue a response, these are sent once all the packets in the current batch are handled */
+static void
+send_packet (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XDMCPPacket *packet)
+{
+    OutgoingPacket *outgoing;
+    gssize n_written;
+
+    if (server->priv->log_packets)
+        log_packet ("Send %s to %s", packet, address);
+
+    if (server->priv->n_outgoing >= BATCH_SIZE)
+        flush_packets (server, socket);
+
+    outgoing = &server->priv->outgoing[server->priv->n_outgoing];
+    n_written = xdmcp_packet_encode (packet, outgoing->data, MAX_PACKET_LENGTH);
+    if (n_written < 0)
+    {
+        g_critical ("Failed to encode XDMCP packet");
+        return;
+    }
+
+    outgoing->address = g_object_ref (address);
+    outgoing->length = n_written;
+    server->priv->n_outgoing++;
+}
+
+static CachedResponse *
+cache_response (XDMCPPacket *packet)
+{
+    CachedResponse *response;
+    gssize n_written;
+
+    response = g_malloc (sizeof (CachedResponse));
+    response->packet = packet;
+    n_written = xdmcp_packet_encode (packet, response->data, MAX_PACKET_LENGTH);
+    if (n_written < 0)
+    {
+        g_critical ("Failed to encode XDMCP packet");
+        cached_response_free (response);
+        return NULL;
+    }
+    response->length = n_written;
+
+    return response;
+}
+
+/* Queue a copy of an already encoded response */
+static void
+send_cached_response (XDMCPServer *server, GSocket *socket, GSocketAddress *address, CachedResponse *response)
+{
+    OutgoingPacket *outgoing;
+
+    if (server->priv->log_packets)
+        log_packet ("Send %s to %s", response->packet, address);
+
+    if (server->priv->n_outgoing >= BATCH_SIZE)
+        flush_packets (server, socket);
+
+    outgoing = &server->priv->outgoing[server->priv->n_outgoing];
+    memcpy (outgoing->data, response->data, response->length);
+    outgoing->address = g_object_ref (address);
+    outgoing->length = response->length;
+    server->priv->n_outgoing++;
 }
 
 static const gchar *
@@ -220,46 +577,106 @@ get_authentication_name (XDMCPServer *server)
         return "";
 }
 
+static gchar *
+get_willing_status (XDMCPServer *server)
+{
+    GString *status;
+    double load;
+
+    if (!server->priv->report_load)
+        return g_strdup (server->priv->status);
+
+    status = g_string_new (server->priv->status);
+    if (status->len > 0)
+        g_string_append (status, ", ");
+    if (getloadavg (&load, 1) == 1)
+    {
+        gchar text[G_ASCII_DTOSTR_BUF_SIZE];
+        g_string_append_printf (status, "load %s, ", g_ascii_formatd (text, sizeof (text), "%.2f", load));
+    }
+    if (server->priv->capacity > 0)
+        g_string_append_printf (status, "%u/%u sessions", server->priv->n_sessions, server->priv->capacity);
+    else
+        g_string_append_printf (status, "%u sessions", server->priv->n_sessions);
+    server->priv->load_time = g_get_monotonic_time ();
+
+    return g_string_free (status, FALSE);
+}
+
 static void
-handle_query (XDMCPServer *server, GSocket *socket, GSocketAddress *address, gchar **authentication_names)
+handle_query (XDMCPServer *server, GSocket *socket, GSocketAddress *address, gchar **authentication_names, gboolean broadcast)
 {
     XDMCPPacket *response;
+    CachedResponse *cached_response;
     gchar **i;
-    gchar *authentication_name = NULL;
+    gboolean willing = FALSE;
 
     /* If no authentication requested and we are configured for none then allow */
     if (authentication_names[0] == NULL && server->priv->key == NULL)
-        authentication_name = "";
+        willing = TRUE;
 
     for (i = authentication_names; *i; i++)
     {
         if (strcmp (*i, get_authentication_name (server)) == 0 && server->priv->key != NULL)
         {
-            authentication_name = *i;
+            willing = TRUE;
             break;
         }
     }
 
-    if (authentication_name)
+    /* Refuse new sessions when full. Don't answer broadcasts so terminals pick a server with room */
+    if (willing && server->priv->capacity > 0 && server->priv->n_sessions >= server->priv->capacity)
     {
-        response = xdmcp_packet_alloc (XDMCP_Willing);
-        response->Willing.authentication_name = g_strdup (authentication_name);
-        response->Willing.hostname = g_strdup (server->priv->hostname);
-        response->Willing.status = g_strdup (server->priv->status);
+        if (broadcast)
+            return;
+
+        if (!server->priv->full_response)
+        {
+            response = xdmcp_packet_alloc (XDMCP_Unwilling);
+            response->Unwilling.hostname = g_strdup (server->priv->hostname);
+            response->Unwilling.status = g_strdup ("Maximum number of sessions reached");
+            server->priv->full_response = cache_response (response);
+        }
+        if (server->priv->full_response)
+            send_cached_response (server, socket, address, server->priv->full_response);
+        return;
+    }
+
+    /* Keep the reported load recent */
+    if (server->priv->report_load && server->priv->willing_response &&
+        g_get_monotonic_time () - server->priv->load_time >= LOAD_UPDATE_INTERVAL)
+        g_clear_pointer (&server->priv->willing_response, cached_response_free);
+
+    /* The response only depends on the configuration and load, so encode it once */
+    if (willing)
+    {
+        if (!server->priv->willing_response)
+        {
+            response = xdmcp_packet_alloc (XDMCP_Willing);
+            response->Willing.authentication_name = g_strdup (get_authentication_name (server));
+            response->Willing.hostname = g_strdup (server->priv->hostname);
+            response->Willing.status = get_willing_status (server);
+            server->priv->willing_response = cache_response (response);
+        }
+        cached_response = server->priv->willing_response;
     }
     else
     {
-        response = xdmcp_packet_alloc (XDMCP_Unwilling);
-        response->Unwilling.hostname = g_strdup (server->priv->hostname);
-        if (server->priv->key)
-            response->Unwilling.status = g_strdup_printf ("No matching authentication, server requires %s", get_authentication_name (server));
-        else
-            response->Unwilling.status = g_strdup ("No matching authentication");
+        if (!server->priv->unwilling_response)
+        {
+            response = xdmcp_packet_alloc (XDMCP_Unwilling);
+            response->Unwilling.hostname = g_strdup (server->priv->hostname);
+            if (server->priv->key)
+                response->Unwilling.status = g_strdup_printf ("No matching authentication, server requires %s", get_authentication_name (server));
+            else
+                response->Unwilling.status = g_strdup ("No matching authentication");
+            server->priv->unwilling_response = cache_response (response);
+        }
+        cached_response = server->priv->unwilling_response;
     }
 
-    send_packet (socket, address, response);
-
-    xdmcp_packet_free (response);
+    if (cached_response)
+        send_cached_response (server, socket, address, cached_response);
 }
 
 static void
@@ -300,7 +717,7 @@ handle_forward_query (XDMCPServer *server, GSocket *socket, GSocketAddress *addr
     client_address = g_inet_socket_address_new (client_inet_address, port);
     g_object_unref (client_inet_address);
 
-    handle_query (server, socket, client_address, packet->ForwardQuery.authentication_names);
+    handle_query (server, socket, client_address, packet->ForwardQuery.authentication_names, FALSE);
 
     g_object_unref (client_address);
 }
@@ -460,6 +877,84 @@ has_string (gchar **list, const gchar *text)
     return FALSE;
 }
 
+static void
+refill_rate_limit (XDMCPServer *server, RateLimit *limit, gint64 now)
+{
+    gdouble burst = MAX (server->priv->request_rate_limit, RATE_LIMIT_BURST);
+
+    limit->tokens = MIN (burst, limit->tokens + (now - limit->time) * server->priv->request_rate_limit / (gdouble) G_USEC_PER_SEC);
+    limit->time = now;
+}
+
+/* Forget the least recently used address so the table never grows beyond MAX_RATE_LIMITS,
+ * however many (possibly spoofed) addresses send requests */
+static void
+evict_rate_limit (XDMCPServer *server)
+{
+    GList *link;
+    RateLimit *limit;
+
+    link = g_queue_peek_head_link (&server->priv->rate_limit_queue);
+    limit = link->data;
+    g_queue_unlink (&server->priv->rate_limit_queue, link);
+    g_hash_table_remove (server->priv->rate_limits, limit->key);
+}
+
+/* Returns TRUE if a request from this address is allowed */
+static gboolean
+check_rate_limit (XDMCPServer *server, GSocketAddress *address)
+{
+    RateLimit *limit;
+    gchar *key;
+    gint64 now;
+
+    if (server->priv->request_rate_limit == 0)
+        return TRUE;
+
+    now = g_get_monotonic_time ();
+    key = g_inet_address_to_string (g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (address)));
+    limit = g_hash_table_lookup (server->priv->rate_limits, key);
+    if (limit)
+    {
+        g_free (key);
+        refill_rate_limit (server, limit, now);
+        g_queue_unlink (&server->priv->rate_limit_queue, &limit->link);
+    }
+    else
+    {
+        if (g_hash_table_size (server->priv->rate_limits) >= MAX_RATE_LIMITS)
+            evict_rate_limit (server);
+
+        limit = g_malloc0 (sizeof (RateLimit));
+        limit->key = key;
+        limit->tokens = MAX (server->priv->request_rate_limit, RATE_LIMIT_BURST);
+        limit->time = now;
+        limit->link.data = limit;
+        g_hash_table_insert (server->priv->rate_limits, key, limit);
+    }
+    g_queue_push_tail_link (&server->priv->rate_limit_queue, &limit->link);
+
+    if (limit->tokens < 1)
+        return FALSE;
+    limit->tokens--;
+
+    return TRUE;
+}
+
+/* Decline a request before doing any authentication work, echoing back the authentication the terminal offered */
+static void
+decline_request (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XDMCPPacket *packet, const gchar *status)
+{
+    XDMCPPacket *response;
+
+    server->priv->n_declined_requests++;
+    response = xdmcp_packet_alloc (XDMCP_Decline);
+    response->Decline.status = g_strdup (status);
+    response->Decline.authentication_name = g_strdup (packet->Request.authentication_name);
+    send_packet (server, socket, address, response);
+    xdmcp_packet_free (response);
+}
+
 static void
 handle_request (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XDMCPPacket *packet)
 {
@@ -471,6 +966,33 @@ handle_request (XDMCPServer *server, GSocket *socket, GSocketAddress *address, X
     XDMCPConnection *connection;
     XdmAuthKeyRec rho;
 
+    /* Ignore addresses sending too many requests, well behaved clients will resend later */
+    if (!check_rate_limit (server, address))
+    {
+        server->priv->n_dropped_requests++;
+        if (server->priv->log_packets)
+        {
+            gchar *address_string = socket_address_to_string (address);
+            g_debug ("Dropping Request from %s, too many requests", address_string);
+            g_free (address_string);
+        }
+        return;
+    }
+
+    /* Decline before doing any work if too many sessions are waiting to be managed */
+    if (server->priv->max_pending_sessions > 0 && server->priv->n_pending_sessions >= server->priv->max_pending_sessions)
+    {
+        decline_request (server, socket, address, packet, "Too many pending sessions");
+        return;
+    }
+
+    /* Decline if we already have as many sessions as we can take, counting those about to start */
+    if (server->priv->capacity > 0 && server->priv->n_sessions + server->priv->n_pending_sessions >= server->priv->capacity)
+    {
+        decline_request (server, socket, address, packet, "Maximum number of sessions reached");
+        return;
+    }
+
     /* Check authentication */
     if (strcmp (packet->Request.authentication_name, "") == 0)
     {
@@ -529,12 +1051,13 @@ handle_request (XDMCPServer *server, GSocket *socket, GSocketAddress *address, X
     /* Decline if request was not valid */
     if (decline_status)
     {
+        server->priv->n_declined_requests++;
         response = xdmcp_packet_alloc (XDMCP_Decline);
         response->Decline.status = decline_status;
         response->Decline.authentication_name = authentication_name;
         response->Decline.authentication_data.data = authentication_data;
         response->Decline.authentication_data.length = authentication_data_length;
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
         return;
     }
@@ -621,7 +1144,7 @@ handle_request (XDMCPServer *server, GSocket *socket, GSocketAddress *address, X
     response->Accept.authorization_name = authorization_name;
     response->Accept.authorization_data.data = authorization_data;
     response->Accept.authorization_data.length = authorization_data_length;
-    send_packet (socket, address, response);
+    send_packet (server, socket, address, response);
     xdmcp_packet_free (response);
 }
 
@@ -638,7 +1161,7 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
 
         response = xdmcp_packet_alloc (XDMCP_Refuse);
         response->Refuse.session_id = packet->Manage.session_id;
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
 
         return;
@@ -661,7 +1184,7 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
         g_debug ("Received Manage for display number %d, but Request was %d", packet->Manage.display_number, session->priv->display_number);
         response = xdmcp_packet_alloc (XDMCP_Refuse);
         response->Refuse.session_id = packet->Manage.session_id;
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
     }
 
@@ -670,11 +1193,14 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
     g_signal_emit (server, signals[NEW_SESSION], 0, session, &result);
     if (result)
     {
-        /* Cancel the inactive timer */
-        if (session->priv->inactive_timeout)
-            g_source_remove (session->priv->inactive_timeout);
+        /* Stop waiting for Manage and start waiting for KeepAlives */
+        timer_wheel_remove (server->priv->timers, &session->priv->timer);
+        if (server->priv->keep_alive_timeout > 0)
+            timer_wheel_add (server->priv->timers, &session->priv->timer, server->priv->keep_alive_timeout * 1000);
+        g_signal_connect (session, XDMCP_SESSION_SIGNAL_STOPPED, G_CALLBACK (session_stopped_cb), server);
 
         session->priv->started = TRUE;
+        server->priv->n_pending_sessions--;
     }
     else
     {
@@ -683,7 +1209,7 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
         response = xdmcp_packet_alloc (XDMCP_Failed);
         response->Failed.session_id = packet->Manage.session_id;
         response->Failed.status = g_strdup_printf ("Failed to connect to display :%d", packet->Manage.display_number);
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
     }
 }
@@ -695,73 +1221,152 @@ handle_keep_alive (XDMCPServer *server, GSocket *socket, GSocketAddress *address
     XDMCPSession *session;
     gboolean alive = FALSE;
 
+    /* Sessions are removed once their display stops */
     session = get_session (server, packet->KeepAlive.session_id);
-    if (session)
-        alive = TRUE; // FIXME: xdmcp_session_get_alive (session);
+    if (session && session->priv->started && session->priv->display_number == packet->KeepAlive.display_number)
+    {
+        alive = TRUE;
+
+        /* The terminal is still there, wait for the next one */
+        if (server->priv->keep_alive_timeout > 0)
+            timer_wheel_add (server->priv->timers, &session->priv->timer, server->priv->keep_alive_timeout * 1000);
+    }
 
     response = xdmcp_packet_alloc (XDMCP_Alive);
     response->Alive.session_running = alive;
     response->Alive.session_id = alive ? packet->KeepAlive.session_id : 0;
-    send_packet (socket, address, response);
+    send_packet (server, socket, address, response);
     xdmcp_packet_free (response);
 }
 
-static gboolean
-read_cb (GSocket *socket, GIOCondition condition, XDMCPServer *server)
+static void
+handle_packet (XDMCPServer *server, GSocket *socket, GSocketAddress *address, const guint8 *data, gsize length)
 {
-    GSocketAddress *address;
-    gchar data[1024];
+    XDMCPPacket *packet;
+
+    /* Decode without allocating, the packet is only valid until the next one is decoded */
+    xdmcp_arena_reset (&server->priv->arena);
+    packet = xdmcp_packet_decode_in_arena (data, length, &server->priv->arena);
+    if (!packet)
+        return;
+
+    if (server->priv->log_packets)
+        log_packet ("Got %s from %s", packet, address);
+
+    switch (packet->opcode)
+    {
+    case XDMCP_BroadcastQuery:
+    case XDMCP_Query:
+    case XDMCP_IndirectQuery:
+        handle_query (server, socket, address, packet->Query.authentication_names, packet->opcode == XDMCP_BroadcastQuery);
+        break;
+    case XDMCP_ForwardQuery:
+        handle_forward_query (server, socket, address, packet);
+        break;
+    case XDMCP_Request:
+        handle_request (server, socket, address, packet);
+        break;
+    case XDMCP_Manage:
+        handle_manage (server, socket, address, packet);
+        break;
+    case XDMCP_KeepAlive:
+        handle_keep_alive (server, socket, address, packet);
+        break;
+    default:
+        g_warning ("Got unexpected XDMCP packet %d", packet->opcode);
+        break;
+    }
+}
+
+/* Receive as many waiting packets as fit in a batch, returns the number received */
+static guint
+receive_packets (XDMCPServer *server, GSocket *socket, GSocketAddress **addresses, gsize *lengths)
+{
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr messages[BATCH_SIZE];
+    struct iovec iov[BATCH_SIZE];
+    struct sockaddr_storage native_addresses[BATCH_SIZE];
+    guint i, n_packets = 0;
+    int n_read;
+
+    memset (messages, 0, sizeof (messages));
+    for (i = 0; i < BATCH_SIZE; i++)
+    {
+        iov[i].iov_base = server->priv->receive_data + i * MAX_PACKET_LENGTH;
+        iov[i].iov_len = MAX_PACKET_LENGTH;
+        messages[i].msg_hdr.msg_name = &native_addresses[i];
+        messages[i].msg_hdr.msg_namelen = sizeof (native_addresses[i]);
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    do
+        n_read = recvmmsg (g_socket_get_fd (socket), messages, BATCH_SIZE, MSG_DONTWAIT, NULL);
+    while (n_read < 0 && errno == EINTR);
+    if (n_read < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            g_warning ("Failed to read from XDMCP socket: %s", strerror (errno));
+        return 0;
+    }
+
+    for (i = 0; i < (guint) n_read; i++)
+    {
+        GSocketAddress *address;
+
+        address = g_socket_address_new_from_native (&native_addresses[i], messages[i].msg_hdr.msg_namelen);
+        if (!address)
+            continue;
+
+        /* Keep the data in the same slot as its address */
+        if (n_packets != i)
+            memmove (server->priv->receive_data + n_packets * MAX_PACKET_LENGTH, server->priv->receive_data + i * MAX_PACKET_LENGTH, messages[i].msg_len);
+        addresses[n_packets] = address;
+        lengths[n_packets] = messages[i].msg_len;
+        n_packets++;
+    }
+
+    return n_packets;
+#else
     GError *error = NULL;
     gssize n_read;
 
-    n_read = g_socket_receive_from (socket, &address, data, 1024, NULL, &error);
+    addresses[0] = NULL;
+    n_read = g_socket_receive_from (socket, &addresses[0], (gchar *) server->priv->receive_data, MAX_PACKET_LENGTH, NULL, &error);
     if (error)
         g_warning ("Failed to read from XDMCP socket: %s", error->message);
     g_clear_error (&error);
 
-    if (n_read > 0)
+    if (n_read <= 0)
     {
-        XDMCPPacket *packet;
-
-        packet = xdmcp_packet_decode ((guint8 *)data, n_read);
-        if (packet)
-        {
-            gchar *packet_string, *address_string;
-
-            packet_string = xdmcp_packet_tostring (packet);
-            address_string = socket_address_to_string (address);
-            g_debug ("Got %s from %s", packet_string, address_string);
-            g_free (packet_string);
-            g_free (address_string);
+        g_clear_object (&addresses[0]);
+        return 0;
+    }
 
-            switch (packet->opcode)
-            {
-            case XDMCP_BroadcastQuery:
-            case XDMCP_Query:
-            case XDMCP_IndirectQuery:
-                handle_query (server, socket, address, packet->Query.authentication_names);
-                break;
-            case XDMCP_ForwardQuery:
-                handle_forward_query (server, socket, address, packet);
-                break;
-            case XDMCP_Request:
-                handle_request (server, socket, address, packet);
-                break;
-            case XDMCP_Manage:
-                handle_manage (server, socket, address, packet);
-                break;
-            case XDMCP_KeepAlive:
-                handle_keep_alive (server, socket, address, packet);
-                break;
-            default:
-                g_warning ("Got unexpected XDMCP packet %d", packet->opcode);
-                break;
-            }
+    lengths[0] = n_read;
+    return 1;
+#endif
+}
 
-            xdmcp_packet_free (packet);
-        }
+static gboolean
+read_cb (GSocket *socket, GIOCondition condition, XDMCPServer *server)
+{
+    GSocketAddress *addresses[BATCH_SIZE];
+    gsize lengths[BATCH_SIZE];
+    guint n_packets, i;
+
+    n_packets = receive_packets (server, socket, addresses, lengths);
+    if (server->priv->log_packets && n_packets > 1)
+        g_debug ("Handling %u XDMCP packets received together", n_packets);
+    for (i = 0; i < n_packets; i++)
+    {
+        handle_packet (server, socket, addresses[i], server->priv->receive_data + i * MAX_PACKET_LENGTH, lengths[i]);
+        g_object_unref (addresses[i]);
     }
 
+    /* Send all the responses together */
+    flush_packets (server, socket);
+
     return TRUE;
 }
 
@@ -804,7 +1409,6 @@ open_udp_socket (GSocketFamily family, guint port, const gchar *listen_address,
 gboolean
 xdmcp_server_start (XDMCPServer *server)
 {
-    GSource *source;
     GError *error = NULL;
 
     g_return_val_if_fail (server != NULL, FALSE);
@@ -816,9 +1420,9 @@ xdmcp_server_start (XDMCPServer *server)
 
     if (server->priv->socket)
     {
-        source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->socket_source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->socket_source, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->socket_source, NULL);
     }
 
     server->priv->socket6 = open_udp_socket (G_SOCKET_FAMILY_IPV6, server->priv->port, server->priv->listen_address, &error);
@@ -828,9 +1432,9 @@ xdmcp_server_start (XDMCPServer *server)
 
     if (server->priv->socket6)
     {
-        source = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        server->priv->socket6_source = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
+        g_source_set_callback (server->priv->socket6_source, (GSourceFunc) read_cb, server, NULL);
+        g_source_attach (server->priv->socket6_source, NULL);
     }
 
     if (!server->priv->socket && !server->priv->socket6)
@@ -839,29 +1443,69 @@ xdmcp_server_start (XDMCPServer *server)
     return TRUE;
 }
 
+void
+xdmcp_server_stop (XDMCPServer *server)
+{
+    g_return_if_fail (server != NULL);
+
+    if ((server->priv->socket || server->priv->socket6) &&
+        (server->priv->n_dropped_requests > 0 || server->priv->n_declined_requests > 0))
+        g_debug ("XDMCP server dropped %u and declined %u requests", server->priv->n_dropped_requests, server->priv->n_declined_requests);
+
+    if (server->priv->socket_source)
+    {
+        g_source_destroy (server->priv->socket_source);
+        g_source_unref (server->priv->socket_source);
+        server->priv->socket_source = NULL;
+    }
+    if (server->priv->socket6_source)
+    {
+        g_source_destroy (server->priv->socket6_source);
+        g_source_unref (server->priv->socket6_source);
+        server->priv->socket6_source = NULL;
+    }
+    g_clear_object (&server->priv->socket);
+    g_clear_object (&server->priv->socket6);
+}
+
 static void
 xdmcp_server_init (XDMCPServer *server)
 {
     server->priv = G_TYPE_INSTANCE_GET_PRIVATE (server, XDMCP_SERVER_TYPE, XDMCPServerPrivate);
 
-    server->priv->port = XDM_UDP_PORT;
+    xdmcp_server_set_port (server, 0);
     server->priv->hostname = g_strdup ("");
     server->priv->status = g_strdup ("");
     server->priv->sessions = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
+    server->priv->rate_limits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    server->priv->timers = timer_wheel_new (TIMER_TICK);
+    server->priv->receive_data = g_malloc (BATCH_SIZE * MAX_PACKET_LENGTH);
+    xdmcp_arena_init (&server->priv->arena, ARENA_SIZE);
+    server->priv->outgoing = g_new0 (OutgoingPacket, BATCH_SIZE);
 }
 
 static void
 xdmcp_server_finalize (GObject *object)
 {
     XDMCPServer *self = XDMCP_SERVER (object);
+    GHashTableIter iter;
+    gpointer value;
 
-    g_clear_object (&self->priv->socket);
-    g_clear_object (&self->priv->socket6);
+    xdmcp_server_stop (self);
     g_free (self->priv->listen_address);
     g_free (self->priv->hostname);
     g_free (self->priv->status);
     g_free (self->priv->key);
+    timer_wheel_free (self->priv->timers);
+    g_hash_table_iter_init (&iter, self->priv->sessions);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        g_signal_handlers_disconnect_matched (value, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
     g_hash_table_unref (self->priv->sessions);
+    g_hash_table_unref (self->priv->rate_limits);
+    g_free (self->priv->receive_data);
+    xdmcp_arena_clear (&self->priv->arena);
+    g_free (self->priv->outgoing);
+    invalidate_responses (self);
 
     G_OBJECT_CLASS (xdmcp_server_parent_class)->finalize (object);
 }
@@ -60,8 +60,28 @@ const gchar *xdmcp_server_get_status (XDMCPServer *server);
 
 void xdmcp_server_set_key (XDMCPServer *server, const gchar *key);
 
+void xdmcp_server_set_keep_alive_timeout (XDMCPServer *server, guint keep_alive_timeout);
+
+void xdmcp_server_set_log_packets (XDMCPServer *server, gboolean log_packets);
+
+void xdmcp_server_set_capacity (XDMCPServer *server, guint capacity);
+
+guint xdmcp_server_get_capacity (XDMCPServer *server);
+
+void xdmcp_server_set_report_load (XDMCPServer *server, gboolean report_load);
+
+void xdmcp_server_set_n_sessions (XDMCPServer *server, guint n_sessions);
+
+guint xdmcp_server_get_n_sessions (XDMCPServer *server);
+
+void xdmcp_server_set_max_pending_sessions (XDMCPServer *server, guint max_pending_sessions);
+
+void xdmcp_server_set_request_rate_limit (XDMCPServer *server, guint request_rate_limit);
+
 gboolean xdmcp_server_start (XDMCPServer *server);
 
+void xdmcp_server_stop (XDMCPServer *server);
+
 G_END_DECLS
 
 #endif /* XDMCP_SERVER_H_ */
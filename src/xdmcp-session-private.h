@@ -14,6 +14,7 @@
 
 #include "xdmcp-server.h"
 #include "x-authority.h"
+#include "timer-wheel.h"
 
 struct XDMCPSessionPrivate
 {
@@ -25,7 +26,8 @@ struct XDMCPSessionPrivate
 
     GInetAddress *address;
 
-    guint inactive_timeout;
+    /* Timer for Manage to be received or the next KeepAlive */
+    TimerWheelTimer timer;
 
     XAuthority *authority;
 
@@ -12,6 +12,13 @@
 #include "xdmcp-session.h"
 #include "xdmcp-session-private.h"
 
+enum {
+    EXPIRED,
+    STOPPED,
+    LAST_SIGNAL
+};
+static guint signals[LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE (XDMCPSession, xdmcp_session, G_TYPE_OBJECT);
 
 XDMCPSession *
@@ -66,6 +73,14 @@ xdmcp_session_get_display_class (XDMCPSession *session)
     return session->priv->display_class;
 }
 
+/* Called when the display using this session has finished */
+void
+xdmcp_session_stop (XDMCPSession *session)
+{
+    g_return_if_fail (session != NULL);
+    g_signal_emit (session, signals[STOPPED], 0);
+}
+
 static void
 xdmcp_session_init (XDMCPSession *session)
 {
@@ -95,4 +110,21 @@ xdmcp_session_class_init (XDMCPSessionClass *klass)
     object_class->finalize = xdmcp_session_finalize;
 
     g_type_class_add_private (klass, sizeof (XDMCPSessionPrivate));
+
+    signals[EXPIRED] =
+        g_signal_new (XDMCP_SESSION_SIGNAL_EXPIRED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XDMCPSessionClass, expired),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
+    signals[STOPPED] =
+        g_signal_new (XDMCP_SESSION_SIGNAL_STOPPED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (XDMCPSessionClass, stopped),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
 }
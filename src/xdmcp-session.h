@@ -19,6 +19,9 @@
 
 G_BEGIN_DECLS
 
+#define XDMCP_SESSION_SIGNAL_EXPIRED "expired"
+#define XDMCP_SESSION_SIGNAL_STOPPED "stopped"
+
 #define XDMCP_SESSION_TYPE (xdmcp_session_get_type())
 #define XDMCP_SESSION(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), XDMCP_SESSION_TYPE, XDMCPSession));
 
@@ -33,6 +36,9 @@ typedef struct
 typedef struct
 {
     GObjectClass parent_class;
+
+    void (*expired)(XDMCPSession *session);
+    void (*stopped)(XDMCPSession *session);
 } XDMCPSessionClass;
 
 GType xdmcp_session_get_type (void);
@@ -51,6 +57,8 @@ guint16 xdmcp_session_get_display_number (XDMCPSession *session);
 
 const gchar *xdmcp_session_get_display_class (XDMCPSession *session);
 
+void xdmcp_session_stop (XDMCPSession *session);
+
 G_END_DECLS
 
 #endif /* XDMCP_SESSION_H_ */
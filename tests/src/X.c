@@ -49,6 +49,12 @@ static int display_number = 0;
 /* VT being run on */
 static int vt_number = -1;
 
+/* File descriptor to write display number to when ready */
+static int display_fd = -1;
+
+/* TRUE if should signal the parent process when ready */
+static gboolean signal_ready = TRUE;
+
 /* X server */
 static XServer *xserver = NULL;
 
@@ -62,6 +68,10 @@ static guint32 xdmcp_session_id = 0;
 static guint16 xdmcp_cookie_length = 0;
 static guint8 *xdmcp_cookie = NULL;
 
+/* Willing responses expected for a flood of queries and when it was sent */
+static guint xdmcp_n_queries = 0, xdmcp_n_willing = 0;
+static gint64 xdmcp_query_time = 0;
+
 static void
 cleanup (void)
 {
@@ -106,6 +116,18 @@ sigterm_cb (gpointer user_data)
 static void
 xdmcp_willing_cb (XDMCPClient *client, XDMCPWilling *message)
 {
+    /* Only report once all the queries are answered */
+    if (xdmcp_n_queries > 0)
+    {
+        xdmcp_n_willing++;
+        if (xdmcp_n_willing < xdmcp_n_queries)
+            return;
+
+        status_notify ("%s GOT-WILLING COUNT=%u AUTHENTICATION-NAME=\"%s\" HOSTNAME=\"%s\" STATUS=\"%s\" TIME=%" G_GINT64_FORMAT "us", id, xdmcp_n_willing, message->authentication_name, message->hostname, message->status, g_get_monotonic_time () - xdmcp_query_time);
+        xdmcp_n_queries = 0;
+        return;
+    }
+
     status_notify ("%s GOT-WILLING AUTHENTICATION-NAME=\"%s\" HOSTNAME=\"%s\" STATUS=\"%s\"", id, message->authentication_name, message->hostname, message->status);
 }
 
@@ -221,18 +243,28 @@ request_cb (const gchar *name, GHashTable *params)
         void *handler;
 
         handler = signal (SIGUSR1, SIG_IGN);
-        if (handler == SIG_IGN)
-        {
+        if ((handler == SIG_IGN && signal_ready) || display_fd >= 0)
             status_notify ("%s INDICATE-READY", id);
+        if (handler == SIG_IGN && signal_ready)
             kill (getppid (), SIGUSR1);
-        }
         signal (SIGUSR1, handler);
+
+        if (display_fd >= 0)
+        {
+            gchar *text = g_strdup_printf ("%d\n", display_number);
+            if (write (display_fd, text, strlen (text)) < 0)
+                g_printerr ("Failed to write display number: %s\n", strerror (errno));
+            g_free (text);
+            close (display_fd);
+            display_fd = -1;
+        }
     }
 
     else if (strcmp (name, "SEND-QUERY") == 0)
     {
-        const gchar *authentication_names_list;
+        const gchar *authentication_names_list, *text;
         gchar **authentication_names;
+        guint count = 1, i;
 
         if (!xdmcp_client_start (xdmcp_client))
             quit (EXIT_FAILURE);
@@ -242,7 +274,18 @@ request_cb (const gchar *name, GHashTable *params)
             authentication_names_list = "";
         authentication_names = g_strsplit (authentication_names_list, " ", -1);
 
-        xdmcp_client_send_query (xdmcp_client, authentication_names);
+        /* Send a burst of queries to load the server */
+        text = g_hash_table_lookup (params, "COUNT");
+        if (text)
+        {
+            count = atoi (text);
+            xdmcp_n_queries = count;
+            xdmcp_n_willing = 0;
+            xdmcp_query_time = g_get_monotonic_time ();
+        }
+
+        for (i = 0; i < count; i++)
+            xdmcp_client_send_query (xdmcp_client, authentication_names);
         g_strfreev (authentication_names);
     }
 
@@ -387,6 +430,9 @@ main (int argc, char **argv)
     /* TCP listening default changed in 1.17.0 */
     listen_tcp = version_compare (1, 17) < 0;
 
+    if (g_key_file_has_key (config, "test-xserver-config", "signal-ready", NULL))
+        signal_ready = g_key_file_get_boolean (config, "test-xserver-config", "signal-ready", NULL);
+
     for (i = 1; i < argc; i++)
     {
         char *arg = argv[i];
@@ -431,6 +477,11 @@ main (int argc, char **argv)
         else if (strcmp (arg, "-nr") == 0)
         {
         }
+        else if (strcmp (arg, "-displayfd") == 0 && version_compare (1, 13) >= 0)
+        {
+            display_fd = atoi (argv[i+1]);
+            i++;
+        }
         else if (strcmp (arg, "-background") == 0)
         {
             /* Ignore arg */
@@ -490,6 +541,7 @@ main (int argc, char **argv)
                         "-auth file             Select authorization file\n"
                         "-nolisten protocol     Don't listen on protocol\n"
                         "-listen protocol       Listen on protocol\n"
+                        "-displayfd fd          file descriptor to write display number to when ready\n"
                         "-background [none]     Create root window with no background\n"
                         "-nr                    (Ubuntu-specific) Synonym for -background none\n"
                         "-query host-name       Contact named host for XDMCP\n"
@@ -33,6 +33,9 @@ static int display_number = 0;
 /* VT being run on */
 static int vt_number = -1;
 
+/* File descriptor to write display number to when ready */
+static int display_fd = -1;
+
 /* X server */
 static XServer *xserver = NULL;
 
@@ -108,6 +111,16 @@ request_cb (const gchar *name, GHashTable *params)
             kill (getppid (), SIGUSR1);
         }
         signal (SIGUSR1, handler);
+
+        if (display_fd >= 0)
+        {
+            gchar *text = g_strdup_printf ("%d\n", display_number);
+            if (write (display_fd, text, strlen (text)) < 0)
+                g_printerr ("Failed to write display number: %s\n", strerror (errno));
+            g_free (text);
+            close (display_fd);
+            display_fd = -1;
+        }
     }
 }
 
@@ -157,6 +170,11 @@ main (int argc, char **argv)
         else if (strcmp (arg, "-nr") == 0)
         {
         }
+        else if (strcmp (arg, "-displayfd") == 0)
+        {
+            display_fd = atoi (argv[i+1]);
+            i++;
+        }
         else if (strcmp (arg, "-background") == 0)
         {
             /* Ignore arg */
@@ -185,17 +203,24 @@ main (int argc, char **argv)
             /* FIXME */
             i++;
         }
+        else if (strcmp (arg, "-version") == 0)
+        {
+            fprintf (stderr, "\nX.Org X Server 1.17.0\nBlah blah blah\n");
+            return EXIT_SUCCESS;
+        }
         else
         {
             g_printerr ("Unrecognized option: %s\n"
                         "Use: %s [:<display>] [option]\n"
                         "-auth file             Select authorization file\n"
                         "-nolisten protocol     Don't listen on protocol\n"
+                        "-displayfd fd          file descriptor to write display number to when ready\n"
                         "-background [none]     Create root window with no background\n"
                         "-nr                    (Ubuntu-specific) Synonym for -background none\n"
                         "-seat string           seat to run on\n"
                         "-mir id                Mir ID to use\n"
                         "-mirSocket name        Mir socket to use\n"
+                        "-version               show the server version\n"
                         "vtxx                   Use virtual terminal xx instead of the next available\n",
                         arg, argv[0]);
             return EXIT_FAILURE;
@@ -185,6 +185,19 @@ read_shared_data_finished (GObject *object, GAsyncResult *result, gpointer data)
     g_clear_error (&error);
 }
 
+static void
+user_list_loaded_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    LightDMUserList *user_list = LIGHTDM_USER_LIST (object);
+    GError *error = NULL;
+
+    if (lightdm_user_list_load_finish (user_list, result, &error))
+        status_notify ("%s LOAD-USER-LIST N=%d", greeter_id, lightdm_user_list_get_length (user_list));
+    else
+        status_notify ("%s LOAD-USER-LIST ERROR=%s", greeter_id, error->message);
+    g_clear_error (&error);
+}
+
 static void
 request_cb (const gchar *name, GHashTable *params)
 {
@@ -256,9 +269,30 @@ request_cb (const gchar *name, GHashTable *params)
     else if (strcmp (name, "START-SESSION") == 0)
         lightdm_greeter_start_session (greeter, g_hash_table_lookup (params, "SESSION"), NULL, start_session_finished, NULL);
 
+    else if (strcmp (name, "SET-LANGUAGE") == 0)
+    {
+        const gchar *v;
+        int i, repeat;
+
+        v = g_hash_table_lookup (params, "REPEAT");
+        repeat = v ? atoi (v) : 1;
+        for (i = 0; i < repeat; i++)
+        {
+            if (!lightdm_greeter_set_language (greeter, g_hash_table_lookup (params, "LANGUAGE"), &error))
+            {
+                status_notify ("%s FAIL-SET-LANGUAGE ERROR=%s", greeter_id, error->message);
+                g_clear_error (&error);
+                break;
+            }
+        }
+    }
+
     else if (strcmp (name, "LOG-DEFAULT-SESSION") == 0)
         status_notify ("%s LOG-DEFAULT-SESSION SESSION=%s", greeter_id, lightdm_greeter_get_default_session_hint (greeter));
 
+    else if (strcmp (name, "LOAD-USER-LIST") == 0)
+        lightdm_user_list_load (lightdm_user_list_get_instance (), NULL, user_list_loaded_cb, NULL);
+
     else if (strcmp (name, "LOG-USER-LIST-LENGTH") == 0)
         status_notify ("%s LOG-USER-LIST-LENGTH N=%d", greeter_id, lightdm_user_list_get_length (lightdm_user_list_get_instance ()));
 
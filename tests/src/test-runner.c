@@ -731,6 +731,169 @@ handle_command (const gchar *command)
         check_status (status->str);
         g_string_free (status, TRUE);
     }
+    else if (strcmp (name, "LOGIN-LATENCY") == 0)
+    {
+        GVariant *result, *value;
+        GString *status;
+        GError *error = NULL;
+
+        result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                              "org.freedesktop.DisplayManager",
+                                              "/org/freedesktop/DisplayManager",
+                                              "org.freedesktop.DBus.Properties",
+                                              "Get",
+                                              g_variant_new ("(ss)", "org.freedesktop.DisplayManager", "LoginLatency"),
+                                              G_VARIANT_TYPE ("(v)"),
+                                              G_DBUS_CALL_FLAGS_NONE,
+                                              G_MAXINT,
+                                              NULL,
+                                              &error);
+
+        status = g_string_new ("RUNNER LOGIN-LATENCY");
+        if (result)
+        {
+            GVariantIter *iter;
+            const gchar *metric;
+            guint64 count, total, minimum, maximum;
+            GVariant *buckets;
+
+            /* Only report counts, the durations vary between runs */
+            g_variant_get (result, "(v)", &value);
+            g_variant_get (value, "a{s(ttttat)}", &iter);
+            while (g_variant_iter_loop (iter, "{&s(tttt@at)}", &metric, &count, &total, &minimum, &maximum, &buckets))
+                g_string_append_printf (status, " %s=%" G_GUINT64_FORMAT, metric, count);
+            g_variant_iter_free (iter);
+            g_variant_unref (value);
+            g_variant_unref (result);
+        }
+        else
+        {
+            if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN))
+                g_string_append_printf (status, " ERROR=SERVICE_UNKNOWN");
+            else
+                g_string_append_printf (status, " ERROR=%s", error->message);
+            g_clear_error (&error);
+        }
+
+        check_status (status->str);
+        g_string_free (status, TRUE);
+    }
+    else if (strcmp (name, "GET-TRACE") == 0)
+    {
+        GVariant *result;
+        GString *status;
+        GError *error = NULL;
+
+        result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                              "org.freedesktop.DisplayManager",
+                                              "/org/freedesktop/DisplayManager",
+                                              "org.freedesktop.DisplayManager",
+                                              "GetTrace",
+                                              g_variant_new ("()"),
+                                              G_VARIANT_TYPE ("(s)"),
+                                              G_DBUS_CALL_FLAGS_NONE,
+                                              G_MAXINT,
+                                              NULL,
+                                              &error);
+
+        status = g_string_new ("RUNNER GET-TRACE");
+        if (result)
+        {
+            const gchar *trace;
+            const gchar *spans[] = { "seat", "display-server", "session", "authenticate", "connected", "process", NULL };
+            int i;
+
+            /* Only report which spans were seen, timestamps and ids vary between runs */
+            g_variant_get (result, "(&s)", &trace);
+            for (i = 0; spans[i]; i++)
+            {
+                gchar *pattern = g_strdup_printf ("\"name\":\"%s\"", spans[i]);
+                g_string_append_printf (status, " %s=%s", spans[i], strstr (trace, pattern) ? "TRUE" : "FALSE");
+                g_free (pattern);
+            }
+            g_variant_unref (result);
+        }
+        else
+        {
+            if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED))
+                g_string_append_printf (status, " ERROR=NOT_SUPPORTED");
+            else
+                g_string_append_printf (status, " ERROR=%s", error->message);
+            g_clear_error (&error);
+        }
+
+        check_status (status->str);
+        g_string_free (status, TRUE);
+    }
+    else if (strcmp (name, "SET-CONFIG") == 0)
+    {
+        GKeyFile *key_file;
+        gchar *path;
+        GError *error = NULL;
+
+        /* Change the configuration the daemon was started with, it is only used once reloaded */
+        path = g_build_filename (temp_dir, "etc", "lightdm", "lightdm.conf", NULL);
+        key_file = g_key_file_new ();
+        g_key_file_load_from_file (key_file, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+        g_key_file_set_string (key_file, g_hash_table_lookup (params, "SECTION"), g_hash_table_lookup (params, "KEY"), g_hash_table_lookup (params, "VALUE"));
+        if (!g_key_file_save_to_file (key_file, path, &error))
+            g_warning ("Failed to write configuration: %s", error->message);
+        g_clear_error (&error);
+        g_key_file_free (key_file);
+        g_free (path);
+    }
+    else if (strcmp (name, "RELOAD-CONFIG") == 0)
+    {
+        GVariant *result;
+        GString *status;
+        GError *error = NULL;
+
+        result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                              "org.freedesktop.DisplayManager",
+                                              "/org/freedesktop/DisplayManager",
+                                              "org.freedesktop.DisplayManager",
+                                              "ReloadConfig",
+                                              g_variant_new ("()"),
+                                              G_VARIANT_TYPE ("()"),
+                                              G_DBUS_CALL_FLAGS_NONE,
+                                              G_MAXINT,
+                                              NULL,
+                                              &error);
+
+        status = g_string_new ("RUNNER RELOAD-CONFIG");
+        if (result)
+            g_variant_unref (result);
+        else
+        {
+            g_string_append_printf (status, " ERROR=%s", error->message);
+            g_clear_error (&error);
+        }
+
+        check_status (status->str);
+        g_string_free (status, TRUE);
+    }
+    else if (strcmp (name, "CHECK-LOG") == 0)
+    {
+        gchar *path, *log = NULL;
+        gboolean found;
+
+        /* Look for a line in the daemon log, only complete once the daemon has stopped */
+        path = g_build_filename (temp_dir, "var", "log", "lightdm", "lightdm.log", NULL);
+        g_file_get_contents (path, &log, NULL, NULL);
+        found = log && g_regex_match_simple (g_hash_table_lookup (params, "PATTERN"), log, G_REGEX_MULTILINE, 0);
+        g_free (log);
+        g_free (path);
+
+        check_status (found ? "RUNNER CHECK-LOG FOUND=TRUE" : "RUNNER CHECK-LOG FOUND=FALSE");
+    }
+    else if (strcmp (name, "SIGNAL-DAEMON") == 0)
+    {
+        const gchar *v;
+
+        v = g_hash_table_lookup (params, "SIGNAL");
+        if (lightdm_process)
+            kill (lightdm_process->pid, v ? atoi (v) : SIGHUP);
+    }
     else if (strcmp (name, "SEAT-CAN-SWITCH") == 0)
     {
         GVariant *result, *value;
@@ -769,6 +932,44 @@ handle_command (const gchar *command)
         check_status (status->str);
         g_string_free (status, TRUE);
     }
+    else if (strcmp (name, "SEAT-SPARE-GREETER-READY") == 0)
+    {
+        GVariant *result, *value;
+        GString *status;
+        GError *error = NULL;
+
+        result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                              "org.freedesktop.DisplayManager",
+                                              "/org/freedesktop/DisplayManager/Seat0",
+                                              "org.freedesktop.DBus.Properties",
+                                              "Get",
+                                              g_variant_new ("(ss)", "org.freedesktop.DisplayManager.Seat", "SpareGreeterReady"),
+                                              G_VARIANT_TYPE ("(v)"),
+                                              G_DBUS_CALL_FLAGS_NONE,
+                                              G_MAXINT,
+                                              NULL,
+                                              &error);
+
+        status = g_string_new ("RUNNER SEAT-SPARE-GREETER-READY");
+        if (result)
+        {
+            g_variant_get (result, "(v)", &value);
+            g_string_append_printf (status, " READY=%s", g_variant_get_boolean (value) ? "TRUE" : "FALSE");
+            g_variant_unref (value);
+            g_variant_unref (result);
+        }
+        else
+        {
+            if (g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN))
+                g_string_append_printf (status, " ERROR=SERVICE_UNKNOWN");
+            else
+                g_string_append_printf (status, " ERROR=%s", error->message);
+            g_clear_error (&error);
+        }
+
+        check_status (status->str);
+        g_string_free (status, TRUE);
+    }
     else if (strcmp (name, "SEAT-HAS-GUEST-ACCOUNT") == 0)
     {
         GVariant *result, *value;
@@ -2936,6 +3137,8 @@ main (int argc, char **argv)
         {"corrupt-xauth",    "password",  "Corrupt Xauthority", 1032},
         /* User to test properties */
         {"prop-user",        "",          "TEST",               1033},
+        /* This account has an image in their home directory */
+        {"have-image",       "",          "Image User",         1034},
         {NULL,               NULL,        NULL,                    0}
     };
     passwd_data = g_string_new ("");
@@ -2990,6 +3193,14 @@ main (int argc, char **argv)
 
         g_key_file_free (dmrc_file);
 
+        /* Write image file */
+        if (strcmp (users[i].user_name, "have-image") == 0)
+        {
+            path = g_build_filename (home_dir, users[i].user_name, ".face", NULL);
+            g_file_set_contents (path, "", -1, NULL);
+            g_free (path);
+        }
+
         /* Write corrupt X authority file */
         if (strcmp (users[i].user_name, "corrupt-xauth") == 0)
         {
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib-object.h>
 
@@ -22,7 +23,7 @@ main (int argc, char **argv)
 
     if (argc < 2)
     {
-        g_printerr ("Usage: %s text [return-value]\n", argv[0]);
+        g_printerr ("Usage: %s text [return-value] [delay]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -33,6 +34,10 @@ main (int argc, char **argv)
     status_notify ("%s", status_text->str);
     g_string_free (status_text, TRUE);
 
+    /* Simulate a slow script */
+    if (argc > 3)
+        sleep (atoi (argv[3]));
+
     if (argc > 2)
         return atoi (argv[2]);
     else